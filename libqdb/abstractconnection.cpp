@@ -37,7 +37,9 @@ AbstractConnection::AbstractConnection(QdbTransport *transport, QObject *parent)
       m_streams{},
       m_nextStreamId{1} // Start from 1 since stream IDs of 0 have special meaning
 {
-
+    // Parent the transport so that it follows the connection to other threads
+    if (m_transport)
+        m_transport->setParent(this);
 }
 
 AbstractConnection::~AbstractConnection()
@@ -0,0 +1,52 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Debug Bridge.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+#ifndef BOOTSTRAPCOMMON_H
+#define BOOTSTRAPCOMMON_H
+
+#include "networkconfigurationcommon.h"
+
+#include <cstdint>
+
+// The bootstrap service brings a device up with a single stream. The host
+// puts its subnet proposal into the Open of the stream after the service tag:
+//   uint32 version, QString subnet
+// so that the device can answer without waiting for a Write.
+const uint32_t bootstrapVersion = 1;
+
+enum class BootstrapMessage : uint32_t {
+    // Sent right away, lets the host tell old devices from slow ones
+    Accepted = 1,
+    // uint32 ConfigurationResult, QString subnet, QString serial,
+    // QString host MAC, QString IP address, bool update follows
+    Configured,
+    // QString IP address, sent once the device has one
+    AddressReady,
+};
+
+#endif // BOOTSTRAPCOMMON_H
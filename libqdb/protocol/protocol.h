@@ -39,6 +39,25 @@ const int qdbMessageSize = 16*1024;
 const int qdbMaxPayloadSize = qdbMessageSize - qdbHeaderSize;
 const uint32_t qdbProtocolVersion = 1;
 
+// Optional features, negotiated in Connect after the session token. The host
+// sends the capabilities it supports and its heartbeat interval in ms, and
+// the device answers with the capabilities both support and its resume grace
+// period in ms. Older peers ignore the extra fields and never see the
+// messages or services of the features.
+//
+// The resume grace period is how long the device keeps its session token and
+// network configuration after losing the USB link. That is all a resumed
+// session keeps: streams end with the connection, so clients have to open
+// them again after the device comes back.
+enum ProtocolCapability : uint32_t
+{
+    HeartbeatCapability = 1 << 0, // Ping and Pong
+    NotificationCapability = 1 << 1, // Streams with NotificationTag
+};
+const uint32_t qdbCapabilities = HeartbeatCapability | NotificationCapability;
+// Heartbeats that may go unanswered before the link is considered dead
+const int qdbMissedHeartbeatLimit = 3;
+
 enum class RefuseReason : uint32_t
 {
     Invalid = 0, // Never used except for deserialization failure
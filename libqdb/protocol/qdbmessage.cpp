@@ -132,6 +132,10 @@ QdbMessage::CommandType toCommandType(uint32_t command)
         return QdbMessage::Close;
     case static_cast<uint32_t>(QdbMessage::Ok):
         return QdbMessage::Ok;
+    case static_cast<uint32_t>(QdbMessage::Ping):
+        return QdbMessage::Ping;
+    case static_cast<uint32_t>(QdbMessage::Pong):
+        return QdbMessage::Pong;
     }
     return QdbMessage::Invalid;
 }
@@ -192,6 +196,12 @@ QDebug &operator<<(QDebug &stream, ::QdbMessage::CommandType command)
     case QdbMessage::Ok:
         stream << "Ok";
         break;
+    case QdbMessage::Ping:
+        stream << "Ping";
+        break;
+    case QdbMessage::Pong:
+        stream << "Pong";
+        break;
     }
     return stream;
 }
@@ -55,6 +55,10 @@ public:
         Write = 0x57525445, // WRTE
         Close = 0x434c5345, // CLSE
         Ok = 0x4f4b4159, // OKAY
+        // Not acknowledged and sent even while waiting for an Ok. Pong
+        // returns the data of the Ping. Only with HeartbeatCapability.
+        Ping = 0x50494e47, // PING
+        Pong = 0x504f4e47, // PONG
     };
 
     QdbMessage();
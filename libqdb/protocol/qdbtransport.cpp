@@ -29,6 +29,7 @@
 #include "qdbtransport.h"
 
 #include "libqdb/protocol/protocol.h"
+#include "libqdb/tracering.h"
 
 #include <QtCore/qdatastream.h>
 #include <QtCore/qdebug.h>
@@ -40,7 +41,9 @@ Q_LOGGING_CATEGORY(transportC, "qdb.transport");
 QdbTransport::QdbTransport(QIODevice *io)
     : m_io{io}
 {
-
+    // Parent the device so that it follows the transport to other threads
+    if (m_io)
+        m_io->setParent(this);
 }
 
 QdbTransport::~QdbTransport()
@@ -67,6 +70,8 @@ bool QdbTransport::send(const QdbMessage &message)
         return false;
     }
 
+    TraceRing::record(TraceEvent::MessageSent, this, message.command(), message.hostStream(),
+                      message.deviceStream(), message.data().size());
     qCDebug(transportC) << "TX:" << message;
     return true;
 }
@@ -82,6 +87,8 @@ QdbMessage QdbTransport::receive()
     QDataStream stream{buf};
     QdbMessage message;
     stream >> message;
+    TraceRing::record(TraceEvent::MessageReceived, this, message.command(), message.hostStream(),
+                      message.deviceStream(), message.data().size());
     qCDebug(transportC) << "RX:" << message;
 
     return message;
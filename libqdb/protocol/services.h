@@ -40,6 +40,8 @@ enum ServiceTag : uint32_t
     EchoTag = 1,
     HandshakeTag,
     NetworkConfigurationTag,
+    BootstrapTag,
+    NotificationTag,
 };
 
 inline
@@ -0,0 +1,366 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Debug Bridge.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+#include "rtnetlink.h"
+
+#include <QtCore/qbytearray.h>
+#include <QtCore/qdebug.h>
+#include <QtCore/qendian.h>
+#include <QtCore/qloggingcategory.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <net/if.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+Q_LOGGING_CATEGORY(netlinkC, "qdb.netlink");
+
+namespace {
+
+const int receiveBufferSize = 32 * 1024;
+
+bool appendAttribute(nlmsghdr *header, size_t capacity, unsigned short type,
+                     const void *data, size_t length)
+{
+    const size_t attributeLength = RTA_LENGTH(length);
+    if (NLMSG_ALIGN(header->nlmsg_len) + RTA_ALIGN(attributeLength) > capacity)
+        return false;
+
+    auto *attribute = reinterpret_cast<rtattr *>(reinterpret_cast<char *>(header)
+                                                 + NLMSG_ALIGN(header->nlmsg_len));
+    attribute->rta_type = type;
+    attribute->rta_len = static_cast<unsigned short>(attributeLength);
+    memcpy(RTA_DATA(attribute), data, length);
+    header->nlmsg_len = NLMSG_ALIGN(header->nlmsg_len) + RTA_ALIGN(attributeLength);
+    return true;
+}
+
+uint32_t toNetworkOrder(const QHostAddress &address)
+{
+    return qToBigEndian(address.toIPv4Address());
+}
+
+} // anonymous namespace
+
+RtNetlinkSocket::RtNetlinkSocket()
+    : m_socket{-1},
+      m_sequence{0}
+{
+
+}
+
+RtNetlinkSocket::~RtNetlinkSocket()
+{
+    if (m_socket != -1)
+        ::close(m_socket);
+}
+
+bool RtNetlinkSocket::open()
+{
+    return openSocket(0, 0);
+}
+
+bool RtNetlinkSocket::openAddressMonitor()
+{
+    return openSocket(SOCK_NONBLOCK, RTMGRP_IPV4_IFADDR);
+}
+
+bool RtNetlinkSocket::isOpen() const
+{
+    return m_socket != -1;
+}
+
+int RtNetlinkSocket::descriptor() const
+{
+    return m_socket;
+}
+
+bool RtNetlinkSocket::addAddress(int interfaceIndex, const QHostAddress &address, int prefixLength)
+{
+    return changeAddress(RTM_NEWADDR, interfaceIndex, address, prefixLength);
+}
+
+bool RtNetlinkSocket::removeAddress(int interfaceIndex, const QHostAddress &address,
+                                    int prefixLength)
+{
+    return changeAddress(RTM_DELADDR, interfaceIndex, address, prefixLength);
+}
+
+bool RtNetlinkSocket::flushAddresses(int interfaceIndex)
+{
+    std::vector<InterfaceAddress> addresses;
+    if (!dumpAddresses(&addresses))
+        return false;
+
+    for (const auto &entry : addresses) {
+        if (entry.interfaceIndex != interfaceIndex)
+            continue;
+        if (!removeAddress(interfaceIndex, entry.address, entry.prefixLength))
+            return false;
+    }
+    return true;
+}
+
+bool RtNetlinkSocket::setLinkUp(int interfaceIndex, bool up)
+{
+    struct {
+        nlmsghdr header;
+        ifinfomsg message;
+    } request;
+    memset(&request, 0, sizeof(request));
+    request.header.nlmsg_len = NLMSG_LENGTH(sizeof(ifinfomsg));
+    request.header.nlmsg_type = RTM_NEWLINK;
+    request.header.nlmsg_flags = NLM_F_REQUEST;
+    request.message.ifi_family = AF_UNSPEC;
+    request.message.ifi_index = interfaceIndex;
+    request.message.ifi_flags = up ? IFF_UP : 0;
+    request.message.ifi_change = IFF_UP;
+
+    return transact(&request.header);
+}
+
+bool RtNetlinkSocket::dumpAddresses(std::vector<InterfaceAddress> *addresses)
+{
+    struct {
+        nlmsghdr header;
+        ifaddrmsg message;
+    } request;
+    memset(&request, 0, sizeof(request));
+    request.header.nlmsg_len = NLMSG_LENGTH(sizeof(ifaddrmsg));
+    request.header.nlmsg_type = RTM_GETADDR;
+    request.header.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    request.message.ifa_family = AF_INET;
+
+    if (!send(&request.header))
+        return false;
+
+    QByteArray buffer{receiveBufferSize, '\0'};
+    for (;;) {
+        const ssize_t length = ::recv(m_socket, buffer.data(), buffer.size(), 0);
+        if (length < 0) {
+            if (errno == EINTR)
+                continue;
+            qCWarning(netlinkC) << "Could not receive address dump:" << strerror(errno);
+            return false;
+        }
+
+        int remaining = static_cast<int>(length);
+        for (auto *header = reinterpret_cast<nlmsghdr *>(buffer.data()); NLMSG_OK(header, remaining);
+             header = NLMSG_NEXT(header, remaining)) {
+            if (header->nlmsg_seq != m_sequence)
+                continue;
+            if (header->nlmsg_type == NLMSG_DONE)
+                return true;
+            if (header->nlmsg_type == NLMSG_ERROR) {
+                const auto *error = static_cast<const nlmsgerr *>(NLMSG_DATA(header));
+                qCWarning(netlinkC) << "Address dump failed:" << strerror(-error->error);
+                return false;
+            }
+
+            InterfaceAddress address;
+            if (parseAddressMessage(header, &address))
+                addresses->push_back(address);
+        }
+    }
+}
+
+bool RtNetlinkSocket::readAddressChanges(std::vector<InterfaceAddressChange> *changes)
+{
+    QByteArray buffer{receiveBufferSize, '\0'};
+    for (;;) {
+        const ssize_t length = ::recv(m_socket, buffer.data(), buffer.size(), MSG_DONTWAIT);
+        if (length < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return true;
+            // ENOBUFS means the kernel dropped notifications, the caller
+            // needs to dump the addresses again to get back in sync.
+            qCWarning(netlinkC) << "Could not receive address notifications:" << strerror(errno);
+            return false;
+        }
+
+        int remaining = static_cast<int>(length);
+        for (auto *header = reinterpret_cast<nlmsghdr *>(buffer.data()); NLMSG_OK(header, remaining);
+             header = NLMSG_NEXT(header, remaining)) {
+            InterfaceAddressChange change;
+            if (!parseAddressMessage(header, &change.address))
+                continue;
+            change.added = header->nlmsg_type == RTM_NEWADDR;
+            changes->push_back(change);
+        }
+    }
+}
+
+int RtNetlinkSocket::interfaceIndex(const QString &interfaceName)
+{
+    return static_cast<int>(if_nametoindex(interfaceName.toLocal8Bit().constData()));
+}
+
+bool RtNetlinkSocket::parseAddressMessage(const nlmsghdr *header, InterfaceAddress *address)
+{
+    if (header->nlmsg_type != RTM_NEWADDR && header->nlmsg_type != RTM_DELADDR)
+        return false;
+
+    const auto *message = static_cast<const ifaddrmsg *>(NLMSG_DATA(header));
+    if (message->ifa_family != AF_INET)
+        return false;
+
+    QHostAddress local;
+    QHostAddress peer;
+    int attributesLength = static_cast<int>(IFA_PAYLOAD(header));
+    for (const rtattr *attribute = IFA_RTA(message); RTA_OK(attribute, attributesLength);
+         attribute = RTA_NEXT(attribute, attributesLength)) {
+        if (RTA_PAYLOAD(attribute) != sizeof(uint32_t))
+            continue;
+        const auto value = qFromBigEndian<uint32_t>(RTA_DATA(attribute));
+        if (attribute->rta_type == IFA_LOCAL)
+            local = QHostAddress{value};
+        else if (attribute->rta_type == IFA_ADDRESS)
+            peer = QHostAddress{value};
+    }
+
+    // For IPv4 IFA_LOCAL is the address of the interface, IFA_ADDRESS only
+    // differs from it on point-to-point links.
+    address->interfaceIndex = static_cast<int>(message->ifa_index);
+    address->address = local.isNull() ? peer : local;
+    address->prefixLength = message->ifa_prefixlen;
+    return !address->address.isNull();
+}
+
+bool RtNetlinkSocket::openSocket(int flags, uint32_t groups)
+{
+    Q_ASSERT(m_socket == -1);
+
+    m_socket = ::socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC | flags, NETLINK_ROUTE);
+    if (m_socket == -1) {
+        qCWarning(netlinkC) << "Could not open rtnetlink socket:" << strerror(errno);
+        return false;
+    }
+
+    sockaddr_nl address;
+    memset(&address, 0, sizeof(address));
+    address.nl_family = AF_NETLINK;
+    address.nl_groups = groups;
+    if (::bind(m_socket, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == -1) {
+        qCWarning(netlinkC) << "Could not bind rtnetlink socket:" << strerror(errno);
+        ::close(m_socket);
+        m_socket = -1;
+        return false;
+    }
+    return true;
+}
+
+bool RtNetlinkSocket::changeAddress(uint16_t type, int interfaceIndex,
+                                    const QHostAddress &address, int prefixLength)
+{
+    struct {
+        nlmsghdr header;
+        ifaddrmsg message;
+        char attributes[64];
+    } request;
+    memset(&request, 0, sizeof(request));
+    request.header.nlmsg_len = NLMSG_LENGTH(sizeof(ifaddrmsg));
+    request.header.nlmsg_type = type;
+    request.header.nlmsg_flags = NLM_F_REQUEST;
+    if (type == RTM_NEWADDR)
+        request.header.nlmsg_flags |= NLM_F_CREATE | NLM_F_REPLACE;
+    request.message.ifa_family = AF_INET;
+    request.message.ifa_prefixlen = static_cast<unsigned char>(prefixLength);
+    request.message.ifa_scope = RT_SCOPE_UNIVERSE;
+    request.message.ifa_index = static_cast<unsigned int>(interfaceIndex);
+
+    const uint32_t local = toNetworkOrder(address);
+    const uint32_t mask = prefixLength == 0 ? 0 : ~uint32_t{0} << (32 - prefixLength);
+    const uint32_t broadcast = qToBigEndian(address.toIPv4Address() | ~mask);
+    if (!appendAttribute(&request.header, sizeof(request), IFA_LOCAL, &local, sizeof(local))
+            || !appendAttribute(&request.header, sizeof(request), IFA_ADDRESS, &local, sizeof(local))
+            || !appendAttribute(&request.header, sizeof(request), IFA_BROADCAST, &broadcast,
+                                sizeof(broadcast))) {
+        qCCritical(netlinkC) << "Address request does not fit into its buffer";
+        return false;
+    }
+
+    return transact(&request.header);
+}
+
+bool RtNetlinkSocket::send(nlmsghdr *request)
+{
+    if (m_socket == -1) {
+        qCWarning(netlinkC) << "Tried to send through a closed rtnetlink socket";
+        return false;
+    }
+
+    request->nlmsg_seq = ++m_sequence;
+
+    sockaddr_nl kernel;
+    memset(&kernel, 0, sizeof(kernel));
+    kernel.nl_family = AF_NETLINK;
+    if (::sendto(m_socket, request, request->nlmsg_len, 0,
+                 reinterpret_cast<sockaddr *>(&kernel), sizeof(kernel)) < 0) {
+        qCWarning(netlinkC) << "Could not send rtnetlink request:" << strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+bool RtNetlinkSocket::transact(nlmsghdr *request)
+{
+    request->nlmsg_flags |= NLM_F_ACK;
+    if (!send(request))
+        return false;
+
+    QByteArray buffer{receiveBufferSize, '\0'};
+    for (;;) {
+        const ssize_t length = ::recv(m_socket, buffer.data(), buffer.size(), 0);
+        if (length < 0) {
+            if (errno == EINTR)
+                continue;
+            qCWarning(netlinkC) << "Could not receive rtnetlink acknowledgement:" << strerror(errno);
+            return false;
+        }
+
+        int remaining = static_cast<int>(length);
+        for (auto *header = reinterpret_cast<nlmsghdr *>(buffer.data()); NLMSG_OK(header, remaining);
+             header = NLMSG_NEXT(header, remaining)) {
+            if (header->nlmsg_seq != m_sequence || header->nlmsg_type != NLMSG_ERROR)
+                continue;
+
+            const auto *error = static_cast<const nlmsgerr *>(NLMSG_DATA(header));
+            if (error->error == 0)
+                return true;
+            qCWarning(netlinkC) << "rtnetlink request" << request->nlmsg_type << "failed:"
+                                << strerror(-error->error);
+            return false;
+        }
+    }
+}
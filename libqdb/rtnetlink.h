@@ -0,0 +1,91 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Debug Bridge.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+#ifndef RTNETLINK_H
+#define RTNETLINK_H
+
+#include <QtNetwork/qhostaddress.h>
+
+#include <cstdint>
+#include <vector>
+
+struct nlmsghdr;
+
+struct InterfaceAddress
+{
+    int interfaceIndex;
+    QHostAddress address;
+    int prefixLength;
+};
+
+struct InterfaceAddressChange
+{
+    bool added;
+    InterfaceAddress address;
+};
+
+// Minimal synchronous client for the IPv4 parts of the Linux rtnetlink
+// interface. Used instead of ip(8) or scripts to avoid forking processes.
+class RtNetlinkSocket
+{
+public:
+    RtNetlinkSocket();
+    ~RtNetlinkSocket();
+
+    bool open();
+    //! Open a non-blocking socket receiving IPv4 address change notifications
+    bool openAddressMonitor();
+    bool isOpen() const;
+    int descriptor() const;
+
+    bool addAddress(int interfaceIndex, const QHostAddress &address, int prefixLength);
+    bool removeAddress(int interfaceIndex, const QHostAddress &address, int prefixLength);
+    bool flushAddresses(int interfaceIndex);
+    bool setLinkUp(int interfaceIndex, bool up);
+    bool dumpAddresses(std::vector<InterfaceAddress> *addresses);
+    //! Read all pending notifications. Returns false if some were lost.
+    bool readAddressChanges(std::vector<InterfaceAddressChange> *changes);
+
+    static int interfaceIndex(const QString &interfaceName);
+    static bool parseAddressMessage(const nlmsghdr *header, InterfaceAddress *address);
+
+    RtNetlinkSocket(const RtNetlinkSocket &) = delete;
+    RtNetlinkSocket &operator=(const RtNetlinkSocket &) = delete;
+
+private:
+    bool openSocket(int flags, uint32_t groups);
+    bool changeAddress(uint16_t type, int interfaceIndex, const QHostAddress &address,
+                       int prefixLength);
+    bool send(nlmsghdr *request);
+    bool transact(nlmsghdr *request);
+
+    int m_socket;
+    uint32_t m_sequence;
+};
+
+#endif // RTNETLINK_H
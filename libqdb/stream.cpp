@@ -45,6 +45,8 @@ Stream::Stream(AbstractConnection *connection, StreamId hostId, StreamId deviceI
     : m_connection{connection},
       m_hostId{hostId},
       m_deviceId{deviceId},
+      m_bytesPending{0},
+      m_paused{false},
       m_partlyReceived{false},
       m_incomingSize{0},
       m_incomingData{}
@@ -56,6 +58,7 @@ bool Stream::write(const StreamPacket &packet)
 {
     Q_ASSERT(packet.size() > 0); // writing nothing to the stream does not make sense
     QByteArray data = wrapPacket(packet);
+    m_bytesPending += data.size();
     while (data.size() > 0) {
         const int splitSize = qMin(data.size(), qdbMaxPayloadSize);
         m_connection->enqueueMessage(QdbMessage{QdbMessage::Write, m_hostId, m_deviceId,
@@ -75,6 +78,30 @@ StreamId Stream::deviceId() const
     return m_deviceId;
 }
 
+qint64 Stream::bytesPending() const
+{
+    return m_bytesPending;
+}
+
+void Stream::pause()
+{
+    m_paused = true;
+}
+
+void Stream::resume()
+{
+    if (!m_paused)
+        return;
+
+    m_paused = false;
+    emit resumed();
+}
+
+bool Stream::isPaused() const
+{
+    return m_paused;
+}
+
 void Stream::requestClose()
 {
     m_connection->enqueueMessage(QdbMessage{QdbMessage::Close, m_hostId, m_deviceId});
@@ -85,6 +112,12 @@ void Stream::close()
     emit closed();
 }
 
+void Stream::acknowledgeWrite(qint64 bytes)
+{
+    m_bytesPending = qMax(Q_INT64_C(0), m_bytesPending - bytes);
+    emit bytesWritten(bytes);
+}
+
 void Stream::receiveMessage(const QdbMessage &message)
 {
     Q_ASSERT(message.command() == QdbMessage::Write);
@@ -46,11 +46,23 @@ public:
     StreamId hostId() const;
     StreamId deviceId() const;
 
+    //! Amount of written bytes the other side has not acknowledged yet
+    qint64 bytesPending() const;
+    // Pausing asks the connection to hold back acknowledging incoming data,
+    // which stops the other side from sending more.
+    void pause();
+    void resume();
+    bool isPaused() const;
+
     void requestClose();
     // Should only be called by AbstractConnection, use requestClose() instead elsewhere
     void close();
+    // Should only be called by AbstractConnection
+    void acknowledgeWrite(qint64 bytes);
 signals:
     void packetAvailable(StreamPacket data);
+    void bytesWritten(qint64 bytes);
+    void resumed();
     void closed();
 
 public slots:
@@ -60,6 +72,8 @@ private:
     AbstractConnection *m_connection;
     StreamId m_hostId;
     StreamId m_deviceId;
+    qint64 m_bytesPending;
+    bool m_paused;
     bool m_partlyReceived;
     int m_incomingSize;
     QByteArray m_incomingData;
@@ -0,0 +1,186 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Debug Bridge.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+#include "tracering.h"
+
+#include <QtCore/qcoreapplication.h>
+#include <QtCore/qfile.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+
+namespace {
+
+const char traceMagic[8] = {'Q', 'D', 'B', 'T', 'R', 'A', 'C', 'E'};
+const quint32 traceFormatVersion = 1;
+// A power of two, so that the slot of a sequence number is a mask away
+const quint32 traceCapacity = 1 << 16;
+
+struct TraceHeader
+{
+    char magic[8];
+    quint32 version;
+    quint32 recordSize;
+    quint32 capacity;
+    quint32 reserved;
+    quint64 nextSequence;
+    char padding[32];
+};
+
+static_assert(sizeof(TraceHeader) == 64, "Trace header layout changed");
+static_assert(sizeof(TraceRecord) == 48, "Trace record layout changed");
+static_assert(sizeof(std::atomic<quint64>) == sizeof(quint64)
+              && alignof(std::atomic<quint64>) == alignof(quint64),
+              "Trace sequence numbers are updated in place as atomics");
+
+const qint64 traceFileSize = sizeof(TraceHeader) + qint64{traceCapacity} * sizeof(TraceRecord);
+
+std::atomic<quint64> &atomicSequence(quint64 &sequence)
+{
+    return *reinterpret_cast<std::atomic<quint64> *>(&sequence);
+}
+
+struct MappedRing
+{
+    QFile file;
+    TraceHeader *header;
+    TraceRecord *records;
+};
+
+// The mapping is never removed, since any thread may be recording into it
+std::atomic<MappedRing *> mappedRing{nullptr};
+
+bool isValidHeader(const TraceHeader &header)
+{
+    return std::memcmp(header.magic, traceMagic, sizeof(traceMagic)) == 0
+            && header.version == traceFormatVersion
+            && header.recordSize == sizeof(TraceRecord)
+            && header.capacity == traceCapacity;
+}
+
+} // anonymous namespace
+
+bool TraceRing::open(const QString &fileName)
+{
+    if (isOpen())
+        return true;
+
+    auto *ring = new MappedRing{};
+    ring->file.setFileName(fileName);
+    if (!ring->file.open(QIODevice::ReadWrite) || !ring->file.resize(traceFileSize)) {
+        delete ring;
+        return false;
+    }
+    uchar *memory = ring->file.map(0, traceFileSize);
+    if (!memory) {
+        delete ring;
+        return false;
+    }
+    ring->header = reinterpret_cast<TraceHeader *>(memory);
+    ring->records = reinterpret_cast<TraceRecord *>(memory + sizeof(TraceHeader));
+
+    if (!isValidHeader(*ring->header)) {
+        std::memset(memory, 0, traceFileSize);
+        std::memcpy(ring->header->magic, traceMagic, sizeof(traceMagic));
+        ring->header->version = traceFormatVersion;
+        ring->header->recordSize = sizeof(TraceRecord);
+        ring->header->capacity = traceCapacity;
+    }
+
+    mappedRing.store(ring, std::memory_order_release);
+    record(TraceEvent::Started, ring, static_cast<quint32>(QCoreApplication::applicationPid()));
+    return true;
+}
+
+bool TraceRing::isOpen()
+{
+    return mappedRing.load(std::memory_order_acquire) != nullptr;
+}
+
+void TraceRing::record(TraceEvent event, const void *source, quint32 argument0,
+                       quint32 argument1, quint32 argument2, quint32 argument3)
+{
+    MappedRing *ring = mappedRing.load(std::memory_order_acquire);
+    if (!ring)
+        return;
+
+    const quint64 sequence = atomicSequence(ring->header->nextSequence).fetch_add(1, std::memory_order_relaxed) + 1;
+    TraceRecord &record = ring->records[sequence & (traceCapacity - 1)];
+
+    // Readers skip the record while its sequence number is zero
+    atomicSequence(record.sequence).store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    const auto now = std::chrono::system_clock::now().time_since_epoch();
+    record.timestamp = std::chrono::duration_cast<std::chrono::microseconds>(now).count();
+    record.source = reinterpret_cast<quintptr>(source);
+    record.event = static_cast<quint32>(event);
+    record.arguments[0] = argument0;
+    record.arguments[1] = argument1;
+    record.arguments[2] = argument2;
+    record.arguments[3] = argument3;
+
+    atomicSequence(record.sequence).store(sequence, std::memory_order_release);
+}
+
+bool TraceRing::read(const QString &fileName, std::vector<TraceRecord> *records,
+                     QString *errorString)
+{
+    QFile file{fileName};
+    if (!file.open(QIODevice::ReadOnly)) {
+        *errorString = file.errorString();
+        return false;
+    }
+    const QByteArray contents = file.readAll();
+    if (contents.size() != traceFileSize) {
+        *errorString = QString{"Unexpected size %1 of trace file"}.arg(contents.size());
+        return false;
+    }
+
+    TraceHeader header;
+    std::memcpy(&header, contents.constData(), sizeof(header));
+    if (!isValidHeader(header)) {
+        *errorString = "Not a trace file of a supported version";
+        return false;
+    }
+
+    records->clear();
+    for (quint32 i = 0; i < traceCapacity; ++i) {
+        TraceRecord record;
+        std::memcpy(&record, contents.constData() + sizeof(TraceHeader) + i * sizeof(TraceRecord),
+                    sizeof(record));
+        if (record.sequence != 0)
+            records->push_back(record);
+    }
+    std::sort(records->begin(), records->end(), [](const TraceRecord &lhs, const TraceRecord &rhs) {
+        return lhs.sequence < rhs.sequence;
+    });
+    return true;
+}
@@ -0,0 +1,74 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Debug Bridge.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+#ifndef TRACERING_H
+#define TRACERING_H
+
+#include <QtCore/qglobal.h>
+#include <QtCore/qstring.h>
+
+#include <vector>
+
+enum class TraceEvent : quint32
+{
+    Invalid = 0,
+    Started,         // process id
+    MessageSent,     // command, host stream, device stream, data size
+    MessageReceived, // command, host stream, device stream, data size
+    StateChanged,    // old state, new state
+    Acknowledged,    // host stream, device stream, microseconds waited for the Ok
+};
+
+struct TraceRecord
+{
+    quint64 sequence; // 0 until the record is completely written
+    qint64 timestamp; // microseconds since the epoch
+    quint64 source; // address of the object that recorded the event
+    quint32 event;
+    quint32 arguments[4];
+    quint32 reserved;
+};
+
+// Fixed-size ring of binary trace records in a memory-mapped file. Records
+// survive the process, so they can be decoded after a crash or a hang. Any
+// thread can record without locking, and recording is a single check while
+// no ring is open.
+class TraceRing
+{
+public:
+    //! Maps the ring for recording, keeping the records of earlier processes
+    static bool open(const QString &fileName);
+    static bool isOpen();
+    static void record(TraceEvent event, const void *source, quint32 argument0 = 0,
+                       quint32 argument1 = 0, quint32 argument2 = 0, quint32 argument3 = 0);
+    //! Reads the complete records of a ring file in the order they were recorded
+    static bool read(const QString &fileName, std::vector<TraceRecord> *records,
+                     QString *errorString);
+};
+
+#endif // TRACERING_H
@@ -0,0 +1,106 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Debug Bridge.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+#include "workerthreadpool.h"
+
+#include "libqdb/make_unique.h"
+
+#include <QtCore/qcoreapplication.h>
+#include <QtCore/qdebug.h>
+#include <QtCore/qthread.h>
+
+#include <algorithm>
+
+WorkerThreadPool::WorkerThreadPool(const QString &name, int maxThreadCount)
+    : m_name{name},
+      m_maxThreadCount{qMax(1, maxThreadCount)},
+      m_workers{}
+{
+
+}
+
+WorkerThreadPool::~WorkerThreadPool()
+{
+    for (auto &worker : m_workers) {
+        // Quitting right away would drop the events still queued in the
+        // thread, such as the calls that close and deleteLater() objects.
+        // Posted events are handled in order, so after this call everything
+        // posted before it has run and the objects are deleted.
+        QMetaObject::invokeMethod(worker.context.get(), []() {
+            QCoreApplication::sendPostedEvents(nullptr, QEvent::DeferredDelete);
+        }, Qt::BlockingQueuedConnection);
+        worker.thread->quit();
+        worker.thread->wait();
+    }
+}
+
+int WorkerThreadPool::maxThreadCount() const
+{
+    return m_maxThreadCount;
+}
+
+int WorkerThreadPool::threadCount() const
+{
+    return static_cast<int>(m_workers.size());
+}
+
+QThread *WorkerThreadPool::acquire()
+{
+    auto leastLoaded = std::min_element(m_workers.begin(), m_workers.end(),
+                                        [](const Worker &lhs, const Worker &rhs) {
+                                            return lhs.load < rhs.load;
+                                        });
+
+    // Prefer starting a new thread over sharing a busy one while below the limit
+    if (leastLoaded == m_workers.end()
+            || (leastLoaded->load > 0 && threadCount() < m_maxThreadCount)) {
+        Worker worker{make_unique<QThread>(), make_unique<QObject>(), 0};
+        worker.thread->setObjectName(QString{"%1-%2"}.arg(m_name).arg(m_workers.size()));
+        worker.context->moveToThread(worker.thread.get());
+        worker.thread->start();
+        m_workers.push_back(std::move(worker));
+        leastLoaded = m_workers.end() - 1;
+    }
+
+    ++leastLoaded->load;
+    return leastLoaded->thread.get();
+}
+
+void WorkerThreadPool::release(QThread *thread)
+{
+    auto iter = std::find_if(m_workers.begin(), m_workers.end(),
+                             [=](const Worker &worker) {
+                                 return worker.thread.get() == thread;
+                             });
+    if (iter == m_workers.end()) {
+        qWarning() << "Tried to release thread" << thread << "not belonging to pool" << m_name;
+        return;
+    }
+    Q_ASSERT(iter->load > 0);
+    --iter->load;
+}
@@ -0,0 +1,73 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Debug Bridge.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+#ifndef WORKERTHREADPOOL_H
+#define WORKERTHREADPOOL_H
+
+#include <QtCore/qstring.h>
+QT_BEGIN_NAMESPACE
+class QObject;
+class QThread;
+QT_END_NAMESPACE
+
+#include <memory>
+#include <vector>
+
+// Bounded set of threads running their own event loops. QObjects are moved to
+// the thread returned by acquire() and the thread is given back with release()
+// once they are gone. Threads are started lazily up to the maximum count.
+// Destroying the pool handles the events already posted to the threads,
+// including deleteLater(), before joining them.
+// Not thread-safe, acquire() and release() must be called from a single thread.
+class WorkerThreadPool
+{
+public:
+    WorkerThreadPool(const QString &name, int maxThreadCount);
+    ~WorkerThreadPool();
+
+    int maxThreadCount() const;
+    int threadCount() const;
+
+    QThread *acquire();
+    void release(QThread *thread);
+
+private:
+    struct Worker
+    {
+        std::unique_ptr<QThread> thread;
+        // Lives in the thread, for calls into it
+        std::unique_ptr<QObject> context;
+        int load;
+    };
+
+    QString m_name;
+    int m_maxThreadCount;
+    std::vector<Worker> m_workers;
+};
+
+#endif // WORKERTHREADPOOL_H
@@ -28,7 +28,6 @@
 ****************************************************************************/
 #include "client.h"
 
-#include "hostmessages.h"
 #include "libqdb/make_unique.h"
 #include "libqdb/qdbconstants.h"
 
@@ -40,9 +39,14 @@
 #include <QtCore/qtimer.h>
 #include <QtNetwork/qlocalsocket.h>
 
+#include <algorithm>
 #include <iostream>
 
-const int startupDelay = 500; // time in ms to wait for host server startup before retrying
+// The host server listens right after it has started, so poll for it often
+// at first and less often later
+const int initialRetryDelay = 10; // in ms
+const int maxRetryDelay = 200; // in ms
+const int startupTimeout = 10000; // in ms
 
 void forkHostServer()
 {
@@ -57,6 +61,22 @@ int execClient(const QCoreApplication &app, const QString &command, const QComma
     Client client;
     client.ignoreErrors(parser.isSet("force"));
 
+    QJsonObject messageFilter;
+    if (parser.isSet("since"))
+        messageFilter["since"] = parser.value("since").toLongLong();
+    if (parser.isSet("level")) {
+        const QString level = parser.value("level");
+        if (level != "warning" && level != "critical" && level != "fatal") {
+            std::cerr << "Invalid message level " << qUtf8Printable(level)
+                      << ", expected warning, critical or fatal\n";
+            return 1;
+        }
+        messageFilter["level"] = level;
+    }
+    if (parser.isSet("category"))
+        messageFilter["category"] = parser.value("category");
+    client.setMessageFilter(messageFilter);
+
     if (command == "devices")
         client.askDevices();
     else if (command == "start-server")
@@ -78,8 +98,12 @@ int execClient(const QCoreApplication &app, const QString &command, const QComma
 
 Client::Client()
     : m_socket{nullptr},
+      m_framing{HostMessageFraming::JsonLines},
       m_triedToStart{false},
-      m_ignoreErrors{false}
+      m_retryDelay{initialRetryDelay},
+      m_startTimer{},
+      m_ignoreErrors{false},
+      m_messageFilter{}
 {
 
 }
@@ -89,6 +113,11 @@ void Client::ignoreErrors(bool ignoreErrors)
     m_ignoreErrors = ignoreErrors;
 }
 
+void Client::setMessageFilter(const QJsonObject &filter)
+{
+    m_messageFilter = filter;
+}
+
 void Client::askDevices()
 {
     setupSocketAndConnect(&Client::handleDevicesConnection, std::bind(&Client::handleErrorWithRetry, this, std::placeholders::_1, &Client::askDevices));
@@ -127,7 +156,7 @@ void Client::askMessagesAndClear()
 
 void Client::handleMessagesConnection()
 {
-    m_socket->write(createRequest(RequestType::Messages));
+    m_socket->write(createRequest(RequestType::Messages, m_messageFilter));
     if (!m_socket->waitForReadyRead()) {
         std::cerr << "Could not read response from QDB host server\n";
         shutdown(1);
@@ -171,15 +200,21 @@ void Client::handleErrorWithRetry(QLocalSocket::LocalSocketError error, Connecte
         return;
     }
 
-    if (m_triedToStart) {
+    if (!m_triedToStart) {
+        std::cout << "Starting QDB host server\n";
+        m_triedToStart = true;
+        m_startTimer.start();
+        forkHostServer();
+    } else if (m_startTimer.hasExpired(startupTimeout)) {
         std::cerr << "Could not connect QDB host server even after trying to start it\n";
         shutdown(1);
         return;
     }
-    std::cout << "Starting QDB host server\n";
-    m_triedToStart = true;
-    forkHostServer();
-    QTimer::singleShot(startupDelay, this, repeatFunction);
+
+    // Once connected, the server answers as soon as it has brought up the
+    // devices that are plugged in
+    QTimer::singleShot(m_retryDelay, this, repeatFunction);
+    m_retryDelay = std::min(m_retryDelay * 2, maxRetryDelay);
 }
 
 void Client::handleStopConnection()
@@ -215,25 +250,40 @@ void Client::handleStopError(QLocalSocket::LocalSocketError error)
 void Client::handleWatchConnection()
 {
     connect(m_socket.get(), &QIODevice::readyRead, this, &Client::handleWatchMessage);
-    m_socket->write(createRequest(RequestType::WatchDevices));
+    sendWatchRequest(RequestType::WatchDevices, QJsonObject{});
 }
 
 void Client::handleWatchMessage()
 {
-    while (m_socket->bytesAvailable() > 0) {
-        const auto responseBytes = m_socket->readLine();
-        const auto document = QJsonDocument::fromJson(responseBytes);
+    QJsonObject response;
+    while (readMessage(m_socket.get(), m_framing, &response)) {
+        const auto type = responseType(response);
+        if (type == ResponseType::FramingChanged) {
+            m_framing = requestedFraming(response);
+            continue;
+        }
+
+        const QJsonDocument document{response};
 
         std::cout << document.toJson().data() << std::endl;
 
-        const auto type = responseType(document.object());
         if (type != ResponseType::NewDevice && type != ResponseType::DisconnectedDevice) {
-            std::cerr << "Shutting down due to unexpected response:" << responseBytes.data();
+            std::cerr << "Shutting down due to unexpected response:"
+                      << document.toJson(QJsonDocument::Compact).data() << std::endl;
             shutdown(1);
+            return;
         }
     }
 }
 
+void Client::sendWatchRequest(RequestType type, QJsonObject arguments)
+{
+    // Watching results in a stream of events, which are cheaper to pass as CBOR.
+    // Replies stay JSON lines until the server confirms, which older ones do not.
+    setRequestedFraming(arguments, HostMessageFraming::Cbor);
+    m_socket->write(createRequest(type, arguments));
+}
+
 void Client::setupSocketAndConnect(Client::ConnectedSlot handleConnection, Client::ErrorSlot handleError)
 {
     m_socket = make_unique<QLocalSocket>();
@@ -254,7 +304,7 @@ void Client::shutdown(int exitCode)
 
 void Client::handleMessagesAndClearConnection()
 {
-    m_socket->write(createRequest(RequestType::MessagesAndClear));
+    m_socket->write(createRequest(RequestType::MessagesAndClear, m_messageFilter));
     if (!m_socket->waitForReadyRead()) {
         std::cerr << "Could not read response from QDB host server\n";
         shutdown(1);
@@ -272,21 +322,28 @@ void Client::handleMessagesAndClearConnection()
 void Client::handleWatchMessagesConnection()
 {
     connect(m_socket.get(), &QIODevice::readyRead, this, &Client::handleMessagesMessage);
-    m_socket->write(createRequest(RequestType::WatchMessages));
+    sendWatchRequest(RequestType::WatchMessages, m_messageFilter);
 }
 
 void Client::handleMessagesMessage()
 {
-    while (m_socket->bytesAvailable() > 0) {
-        const auto responseBytes = m_socket->readLine();
-        const auto document = QJsonDocument::fromJson(responseBytes);
+    QJsonObject response;
+    while (readMessage(m_socket.get(), m_framing, &response)) {
+        const auto type = responseType(response);
+        if (type == ResponseType::FramingChanged) {
+            m_framing = requestedFraming(response);
+            continue;
+        }
+
+        const QJsonDocument document{response};
 
         std::cout << document.toJson().data() << std::endl;
 
-        const auto type = responseType(document.object());
         if (type != ResponseType::Messages) {
-            std::cerr << "Shutting down due to unexpected response:" << responseBytes.data();
+            std::cerr << "Shutting down due to unexpected response:"
+                      << document.toJson(QJsonDocument::Compact).data() << std::endl;
             shutdown(1);
+            return;
         }
     }
 }
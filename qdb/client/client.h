@@ -29,6 +29,9 @@
 #ifndef CLIENT_H
 #define CLIENT_H
 
+#include "hostmessages.h"
+
+#include <QtCore/qelapsedtimer.h>
 #include <QtNetwork/qlocalsocket.h>
 QT_BEGIN_NAMESPACE
 class QCommandLineParser;
@@ -47,6 +50,8 @@ public:
     Client();
 
     void ignoreErrors(bool ignoreErrors);
+    //! Arguments "since", "level" and "category" of requests for messages
+    void setMessageFilter(const QJsonObject &filter);
 
 public slots:
     void askDevices();
@@ -71,12 +76,17 @@ private:
     void handleMessagesAndClearConnection();
     void handleWatchMessagesConnection();
     void handleMessagesMessage();
+    void sendWatchRequest(RequestType type, QJsonObject arguments);
     void setupSocketAndConnect(ConnectedSlot handleConnection, ErrorSlot handleError);
     void shutdown(int exitCode);
 
     std::unique_ptr<QLocalSocket> m_socket;
+    HostMessageFraming m_framing;
     bool m_triedToStart;
+    int m_retryDelay;
+    QElapsedTimer m_startTimer;
     bool m_ignoreErrors;
+    QJsonObject m_messageFilter;
 };
 
 #endif // CLIENT_H
@@ -28,23 +28,135 @@
 ****************************************************************************/
 #include "hostmessages.h"
 
+#include <QtCore/qcbormap.h>
+#include <QtCore/qcborvalue.h>
+#include <QtCore/qendian.h>
+#include <QtCore/qiodevice.h>
+
 const QString responseField = "response";
 const QString requestField = "request";
 const QString versionField = "_version";
+const QString framingField = "framing";
+const QString idField = "id";
+const QString keepAliveField = "keep-alive";
+const QString cborFramingName = "cbor";
+const int framePrefixSize = sizeof(quint32);
+// Guards against reading garbage as a frame length
+const quint32 maxFrameSize = 16 * 1024 * 1024;
 
 void setVersionField(QJsonObject &obj)
 {
     obj[versionField] = qdbHostMessageVersion;
 }
 
+void setVersionField(QCborMap &map)
+{
+    map[versionField] = qdbHostMessageVersion;
+}
+
 bool checkHostMessageVersion(const QJsonObject &obj)
 {
     return obj[versionField].toInt() == qdbHostMessageVersion;
 }
 
+HostMessageFraming requestedFraming(const QJsonObject &request)
+{
+    if (request[framingField].toString() == cborFramingName)
+        return HostMessageFraming::Cbor;
+    return HostMessageFraming::JsonLines;
+}
+
+void setRequestedFraming(QJsonObject &request, HostMessageFraming framing)
+{
+    if (framing == HostMessageFraming::Cbor)
+        request[framingField] = cborFramingName;
+    else
+        request.remove(framingField);
+}
+
+QByteArray serialiseMessage(const QJsonObject &obj, HostMessageFraming framing)
+{
+    if (framing == HostMessageFraming::JsonLines)
+        return QJsonDocument{obj}.toJson(QJsonDocument::Compact).append('\n');
+
+    return serialiseMessage(QCborMap::fromJsonObject(obj), framing);
+}
+
+QByteArray serialiseMessage(const QCborMap &map, HostMessageFraming framing)
+{
+    if (framing == HostMessageFraming::JsonLines)
+        return serialiseMessage(map.toJsonObject(), framing);
+
+    const QByteArray payload = map.toCborValue().toCbor();
+    QByteArray frame{framePrefixSize, Qt::Uninitialized};
+    qToBigEndian<quint32>(payload.size(), frame.data());
+    frame.append(payload);
+    return frame;
+}
+
+bool readMessage(QIODevice *device, HostMessageFraming framing, QJsonObject *message)
+{
+    if (framing == HostMessageFraming::JsonLines) {
+        if (!device->canReadLine())
+            return false;
+        *message = QJsonDocument::fromJson(device->readLine()).object();
+        return true;
+    }
+
+    if (device->bytesAvailable() < framePrefixSize)
+        return false;
+    const QByteArray prefix = device->peek(framePrefixSize);
+    const quint32 size = qFromBigEndian<quint32>(prefix.constData());
+    if (size > maxFrameSize) {
+        // Not a frame of ours, consume everything so that the caller sees an
+        // invalid message instead of waiting forever
+        device->readAll();
+        *message = QJsonObject{};
+        return true;
+    }
+    if (device->bytesAvailable() < framePrefixSize + static_cast<qint64>(size))
+        return false;
+
+    device->skip(framePrefixSize);
+    const QByteArray payload = device->read(size);
+    *message = QCborValue::fromCbor(payload).toMap().toJsonObject();
+    return true;
+}
+
+QJsonValue requestId(const QJsonObject &request)
+{
+    return request[idField];
+}
+
+void setRequestId(QJsonObject &obj, const QJsonValue &id)
+{
+    if (id.isUndefined() || id.isNull())
+        obj.remove(idField);
+    else
+        obj[idField] = id;
+}
+
+void setRequestId(QCborMap &map, const QJsonValue &id)
+{
+    if (id.isUndefined() || id.isNull())
+        map.remove(idField);
+    else
+        map[idField] = QCborValue::fromJsonValue(id);
+}
+
+bool requestsKeepAlive(const QJsonObject &request)
+{
+    return request[keepAliveField].toBool();
+}
+
 QByteArray createRequest(const RequestType &type)
 {
-    QJsonObject obj;
+    return createRequest(type, QJsonObject{});
+}
+
+QByteArray createRequest(const RequestType &type, const QJsonObject &arguments)
+{
+    QJsonObject obj = arguments;
     setVersionField(obj);
     obj[requestField] = requestTypeString(type);
     return QJsonDocument{obj}.toJson(QJsonDocument::Compact).append('\n');
@@ -65,6 +177,12 @@ RequestType requestType(const QJsonObject &obj)
         return RequestType::WatchMessages;
     if (fieldValue == requestTypeString(RequestType::MessagesAndClear))
         return RequestType::MessagesAndClear;
+    if (fieldValue == requestTypeString(RequestType::OpenStream))
+        return RequestType::OpenStream;
+    if (fieldValue == requestTypeString(RequestType::SetQos))
+        return RequestType::SetQos;
+    if (fieldValue == requestTypeString(RequestType::Statistics))
+        return RequestType::Statistics;
 
     return RequestType::Unknown;
 }
@@ -84,23 +202,20 @@ QString requestTypeString(const RequestType &type)
         return "watch-messages";
     case RequestType::MessagesAndClear:
         return "messages-and-clear";
+    case RequestType::OpenStream:
+        return "open-stream";
+    case RequestType::SetQos:
+        return "set-qos";
+    case RequestType::Statistics:
+        return "statistics";
     case RequestType::Unknown:
         break;
     }
     qFatal("Tried to use unknown request type as a value in requestTypeString");
 }
 
-QJsonObject initializeResponse(const ResponseType &type)
-{
-    QJsonObject obj;
-    setVersionField(obj);
-    obj[responseField] = responseTypeString(type);
-    return obj;
-}
-
-ResponseType responseType(const QJsonObject &obj)
+static ResponseType responseTypeFromString(const QString &fieldValue)
 {
-    const auto fieldValue = obj[responseField];
     if (fieldValue == responseTypeString(ResponseType::Devices))
         return ResponseType::Devices;
     if (fieldValue == responseTypeString(ResponseType::NewDevice))
@@ -111,14 +226,50 @@ ResponseType responseType(const QJsonObject &obj)
         return ResponseType::Stopping;
     if (fieldValue == responseTypeString(ResponseType::Messages))
         return ResponseType::Messages;
+    if (fieldValue == responseTypeString(ResponseType::StreamOpened))
+        return ResponseType::StreamOpened;
+    if (fieldValue == responseTypeString(ResponseType::StreamFailed))
+        return ResponseType::StreamFailed;
+    if (fieldValue == responseTypeString(ResponseType::QosSet))
+        return ResponseType::QosSet;
+    if (fieldValue == responseTypeString(ResponseType::Statistics))
+        return ResponseType::Statistics;
     if (fieldValue == responseTypeString(ResponseType::InvalidRequest))
         return ResponseType::InvalidRequest;
     if (fieldValue == responseTypeString(ResponseType::UnsupportedVersion))
         return ResponseType::UnsupportedVersion;
+    if (fieldValue == responseTypeString(ResponseType::FramingChanged))
+        return ResponseType::FramingChanged;
 
     return ResponseType::Unknown;
 }
 
+QCborMap initializeResponse(const ResponseType &type)
+{
+    QCborMap map;
+    setVersionField(map);
+    map[responseField] = responseTypeString(type);
+    return map;
+}
+
+ResponseType responseType(const QJsonObject &obj)
+{
+    return responseTypeFromString(obj[responseField].toString());
+}
+
+ResponseType responseType(const QCborMap &map)
+{
+    return responseTypeFromString(map[responseField].toString());
+}
+
+QByteArray framingChangedResponse(HostMessageFraming framing)
+{
+    QCborMap response = initializeResponse(ResponseType::FramingChanged);
+    if (framing == HostMessageFraming::Cbor)
+        response[framingField] = cborFramingName;
+    return serialiseMessage(response, HostMessageFraming::JsonLines);
+}
+
 QString responseTypeString(const ResponseType &type)
 {
     switch (type) {
@@ -132,10 +283,20 @@ QString responseTypeString(const ResponseType &type)
         return "stopping";
     case ResponseType::Messages:
         return "messages";
+    case ResponseType::StreamOpened:
+        return "stream-opened";
+    case ResponseType::StreamFailed:
+        return "stream-failed";
+    case ResponseType::QosSet:
+        return "qos-set";
+    case ResponseType::Statistics:
+        return "statistics";
     case ResponseType::InvalidRequest:
         return "invalid-request";
     case ResponseType::UnsupportedVersion:
         return "unsupported-version";
+    case ResponseType::FramingChanged:
+        return "framing-changed";
     case ResponseType::Unknown:
         break;
     }
@@ -144,5 +305,5 @@ QString responseTypeString(const ResponseType &type)
 
 QByteArray serialiseResponse(const QJsonObject &obj)
 {
-    return QJsonDocument{obj}.toJson(QJsonDocument::Compact).append('\n');
+    return serialiseMessage(obj, HostMessageFraming::JsonLines);
 }
@@ -30,12 +30,35 @@
 #define HOSTMESSAGES_H
 
 #include <QtCore/qbytearray.h>
+#include <QtCore/qcbormap.h>
 #include <QtCore/qjsondocument.h>
 #include <QtCore/qjsonobject.h>
 
+QT_BEGIN_NAMESPACE
+class QIODevice;
+QT_END_NAMESPACE
+
 const int qdbHostMessageVersion = 1;
 bool checkHostMessageVersion(const QJsonObject &obj);
 
+// Requests always start out as JSON lines. A request may ask for CBOR framing,
+// which a server that supports it confirms with a framing-changed response as
+// a JSON line. Every later message in either direction, including the response
+// to that request, is then a CBOR map prefixed by its length as a 32-bit
+// big-endian integer. Older servers ignore the request and keep to JSON lines.
+enum class HostMessageFraming
+{
+    JsonLines,
+    Cbor,
+};
+
+HostMessageFraming requestedFraming(const QJsonObject &request);
+void setRequestedFraming(QJsonObject &request, HostMessageFraming framing);
+QByteArray serialiseMessage(const QJsonObject &obj, HostMessageFraming framing);
+QByteArray serialiseMessage(const QCborMap &map, HostMessageFraming framing);
+//! Reads one complete message from device, returns false if there is none yet
+bool readMessage(QIODevice *device, HostMessageFraming framing, QJsonObject *message);
+
 enum class RequestType
 {
     Unknown = 0,
@@ -45,9 +68,22 @@ enum class RequestType
     WatchMessages,
     Messages,
     MessagesAndClear,
+    OpenStream,
+    SetQos,
+    Statistics,
 };
 
+// A request may carry an "id" of any JSON type, which is then echoed in all
+// responses to it, including the events of watch requests. A request with
+// "keep-alive" set to true makes the session persistent, so that the socket
+// stays open for more requests after one-shot replies.
+QJsonValue requestId(const QJsonObject &request);
+void setRequestId(QJsonObject &obj, const QJsonValue &id);
+void setRequestId(QCborMap &map, const QJsonValue &id);
+bool requestsKeepAlive(const QJsonObject &request);
+
 QByteArray createRequest(const RequestType &type);
+QByteArray createRequest(const RequestType &type, const QJsonObject &arguments);
 RequestType requestType(const QJsonObject &obj);
 QString requestTypeString(const RequestType &type);
 
@@ -61,10 +97,20 @@ enum class ResponseType
     InvalidRequest,
     UnsupportedVersion,
     Messages,
+    StreamOpened,
+    StreamFailed,
+    QosSet,
+    Statistics,
+    FramingChanged,
 };
 
-QJsonObject initializeResponse(const ResponseType &type);
+// Responses are built as CBOR maps, which are converted to JSON only for
+// clients that did not ask for CBOR framing
+QCborMap initializeResponse(const ResponseType &type);
 ResponseType responseType(const QJsonObject &obj);
+ResponseType responseType(const QCborMap &map);
+//! Confirms the switch to the framing, always sent as a JSON line
+QByteArray framingChangedResponse(HostMessageFraming framing);
 QString responseTypeString(const ResponseType &type);
 QByteArray serialiseResponse(const QJsonObject &obj);
 
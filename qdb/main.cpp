@@ -29,6 +29,7 @@
 #include "client/client.h"
 #include "libqdb/interruptsignalhandler.h"
 #include "server/hostserver.h"
+#include "tracedump.h"
 
 #include <QtCore/qcommandlineparser.h>
 #include <QtCore/qcoreapplication.h>
@@ -48,8 +49,15 @@ int main(int argc, char *argv[])
     parser.addOption({"debug-transport", "Print each message that is sent. (Only server process)"});
     parser.addOption({"debug-connection", "Show enqueued messages. (Only server process)"});
     parser.addOption({{"f", "force"}, "Ignore errors"});
+    parser.addOption({"heartbeat-interval", "Check that devices are alive and measure their round trip time every <ms>, 0 disables it. (Only server process)", "ms"});
+    parser.addOption({"connection-idle-timeout", "Close device connections that have not been used for <seconds>, 0 keeps them open while the device is attached. Devices that push notifications keep their connection open anyway. (Only server process)", "seconds"});
+    parser.addOption({"max-parallel-bringups", "Configure at most <count> devices at the same time. (Only server process)", "count"});
+    parser.addOption({"subnet-range", "Carve device networks out of <range>, e.g. 172.16.0.0/16. Can be given several times. (Only server process)", "range"});
+    parser.addOption({"since", "Only messages after the sequence number <sequence>.", "sequence"});
+    parser.addOption({"level", "Only messages of at least <level>: warning, critical or fatal. The server does not keep debug and info messages.", "level"});
+    parser.addOption({"category", "Only messages in logging categories starting with <category>.", "category"});
     auto commandList = clientCommands;
-    commandList << "server";
+    commandList << "server" << "trace";
     std::sort(commandList.begin(), commandList.end());
     parser.addPositionalArgument("command",
                                  "Subcommand of qdb to run. Possible commands are: "
@@ -63,6 +71,13 @@ int main(int argc, char *argv[])
 
     if (command == "server") {
         return execHostServer(app, parser);
+    } else if (command == "trace") {
+        // Reads the trace file directly, so it works while the server hangs or after it crashed
+        if (arguments.size() < 2 || arguments[1] != "dump") {
+            std::cerr << "Usage: trace dump" << std::endl;
+            return 1;
+        }
+        return dumpTrace();
     } else if (clientCommands.contains(command)) {
         return execClient(app, command, parser);
     } else {
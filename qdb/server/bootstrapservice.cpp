@@ -0,0 +1,124 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Debug Bridge.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+#include "bootstrapservice.h"
+
+#include "connection.h"
+#include "libqdb/bootstrapcommon.h"
+#include "libqdb/protocol/services.h"
+#include "libqdb/stream.h"
+
+#include <QtCore/qdatastream.h>
+#include <QtCore/qdebug.h>
+#include <QtCore/qloggingcategory.h>
+
+Q_LOGGING_CATEGORY(bootstrapC, "qdb.services.bootstrap");
+
+BootstrapService::BootstrapService(Connection *connection, const QString &proposedSubnet)
+    : m_connection{connection},
+      m_proposedSubnet{proposedSubnet},
+      m_configured{false},
+      m_updateExpected{false},
+      m_failed{false}
+{
+
+}
+
+BootstrapService::~BootstrapService()
+{
+    if (m_stream)
+        m_stream->requestClose();
+}
+
+void BootstrapService::initialize()
+{
+    connect(m_connection, &Connection::disconnected, this, &BootstrapService::handleDisconnected);
+
+    // The proposal travels in the Open, so the device answers without a Write
+    QByteArray openTag = tagBuffer(BootstrapTag);
+    QDataStream tagStream{&openTag, QIODevice::WriteOnly | QIODevice::Append};
+    tagStream << bootstrapVersion << m_proposedSubnet;
+
+    m_connection->createStream(openTag, [=](Stream *stream) {
+        this->streamCreated(stream);
+    });
+}
+
+void BootstrapService::receive(StreamPacket packet)
+{
+    uint32_t type = 0;
+    packet >> type;
+
+    switch (static_cast<BootstrapMessage>(type)) {
+    case BootstrapMessage::Accepted:
+        emit accepted();
+        return;
+    case BootstrapMessage::Configured: {
+        uint32_t result = 0;
+        QString subnet;
+        QString serial;
+        QString hostMac;
+        QString ipAddress;
+        bool updateFollows = false;
+        packet >> result >> subnet >> serial >> hostMac >> ipAddress >> updateFollows;
+
+        m_configured = true;
+        m_updateExpected = updateFollows;
+        emit configured(static_cast<ConfigurationResult>(result), subnet, serial, hostMac,
+                        ipAddress, updateFollows);
+        return;
+    }
+    case BootstrapMessage::AddressReady: {
+        QString ipAddress;
+        packet >> ipAddress;
+        m_updateExpected = false;
+        emit addressReady(ipAddress);
+        return;
+    }
+    }
+    qCWarning(bootstrapC) << "Unknown bootstrap message" << type << "received from device";
+}
+
+void BootstrapService::onStreamClosed()
+{
+    Service::onStreamClosed();
+    fail();
+}
+
+void BootstrapService::handleDisconnected()
+{
+    fail();
+}
+
+void BootstrapService::fail()
+{
+    if (m_failed || (m_configured && !m_updateExpected))
+        return;
+    m_failed = true;
+    emit failed();
+}
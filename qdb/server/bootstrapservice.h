@@ -0,0 +1,75 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Debug Bridge.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+#ifndef BOOTSTRAPSERVICE_H
+#define BOOTSTRAPSERVICE_H
+
+#include "libqdb/networkconfigurationcommon.h"
+#include "service.h"
+
+#include <QtCore/qstring.h>
+
+class Connection;
+class Stream;
+class StreamPacket;
+
+class BootstrapService : public Service
+{
+    Q_OBJECT
+public:
+    BootstrapService(Connection *connection, const QString &proposedSubnet);
+    ~BootstrapService();
+
+    void initialize() override;
+
+signals:
+    void accepted();
+    void configured(ConfigurationResult result, QString subnet, QString serial,
+                    QString hostMac, QString ipAddress, bool updateFollows);
+    void addressReady(QString ipAddress);
+    //! The stream closed before the device was configured or sent its address
+    void failed();
+
+public slots:
+    void receive(StreamPacket packet) override;
+
+protected slots:
+    void onStreamClosed() override;
+
+private:
+    void handleDisconnected();
+    void fail();
+
+    Connection *m_connection;
+    QString m_proposedSubnet;
+    bool m_configured;
+    bool m_updateExpected;
+    bool m_failed;
+};
+
+#endif // BOOTSTRAPSERVICE_H
@@ -0,0 +1,154 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Debug Bridge.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+#include "bringupscheduler.h"
+
+#include <QtCore/qdebug.h>
+#include <QtCore/qloggingcategory.h>
+
+#include <algorithm>
+
+Q_LOGGING_CATEGORY(bringUpC, "qdb.devices.bringup");
+
+BringUpScheduler::BringUpScheduler(BringUpStarter starter)
+    : m_starter{starter},
+      m_maxParallel{defaultMaxParallel},
+      m_active{0},
+      m_queue{},
+      m_bringUps{},
+      m_burstTimer{},
+      m_burstSize{0}
+{
+
+}
+
+int BringUpScheduler::maxParallel() const
+{
+    return m_maxParallel;
+}
+
+void BringUpScheduler::setMaxParallel(int maxParallel)
+{
+    m_maxParallel = std::max(maxParallel, 1);
+    startQueued();
+}
+
+void BringUpScheduler::schedule(const UsbDevice &device)
+{
+    // A replugged device starts over
+    cancel(device.serial);
+
+    if (m_bringUps.isEmpty()) {
+        m_burstTimer.start();
+        m_burstSize = 0;
+    }
+    ++m_burstSize;
+
+    BringUp &bringUp = m_bringUps[device.serial];
+    bringUp.timer.start();
+    m_queue.enqueue(device);
+    startQueued();
+}
+
+void BringUpScheduler::markConfigured(const QString &serial)
+{
+    auto iter = m_bringUps.find(serial);
+    if (iter == m_bringUps.end() || iter->configured >= 0)
+        return;
+
+    iter->configured = iter->timer.elapsed() - iter->queued;
+    releaseSlot(*iter);
+    startQueued();
+}
+
+void BringUpScheduler::finish(const QString &serial, bool success)
+{
+    auto iter = m_bringUps.find(serial);
+    if (iter == m_bringUps.end())
+        return;
+
+    const qint64 total = iter->timer.elapsed();
+    const qint64 started = std::max<qint64>(iter->queued, 0);
+    const qint64 configured = iter->configured >= 0 ? iter->configured : total - started;
+    const qint64 address = total - started - configured;
+    if (success) {
+        qCDebug(bringUpC) << "Brought up" << serial << "in" << total << "ms: queued" << started
+                          << "ms, configuring" << configured << "ms, waiting for address"
+                          << address << "ms";
+    } else {
+        qCDebug(bringUpC) << "Bringing up" << serial << "failed after" << total << "ms";
+    }
+
+    releaseSlot(*iter);
+    m_bringUps.erase(iter);
+    if (m_bringUps.isEmpty()) {
+        qCDebug(bringUpC) << "Brought up" << m_burstSize << "devices in" << m_burstTimer.elapsed()
+                          << "ms with at most" << m_maxParallel << "at a time";
+    }
+    startQueued();
+}
+
+void BringUpScheduler::cancel(const QString &serial)
+{
+    auto iter = m_bringUps.find(serial);
+    if (iter == m_bringUps.end())
+        return;
+
+    releaseSlot(*iter);
+    m_bringUps.erase(iter);
+    m_queue.erase(std::remove_if(m_queue.begin(), m_queue.end(),
+                                 [&serial](const UsbDevice &device) {
+                                     return device.serial == serial;
+                                 }),
+                  m_queue.end());
+    --m_burstSize;
+    startQueued();
+}
+
+void BringUpScheduler::startQueued()
+{
+    while (m_active < m_maxParallel && !m_queue.isEmpty()) {
+        const UsbDevice device = m_queue.dequeue();
+        BringUp &bringUp = m_bringUps[device.serial];
+        bringUp.queued = bringUp.timer.elapsed();
+        bringUp.holdsSlot = true;
+        ++m_active;
+        if (!m_queue.isEmpty() || m_active == m_maxParallel)
+            qCDebug(bringUpC) << "Bringing up" << device.serial << "with" << m_queue.size()
+                              << "devices waiting";
+        m_starter(device);
+    }
+}
+
+void BringUpScheduler::releaseSlot(BringUp &bringUp)
+{
+    if (!bringUp.holdsSlot)
+        return;
+    bringUp.holdsSlot = false;
+    --m_active;
+}
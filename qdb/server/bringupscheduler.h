@@ -0,0 +1,87 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Debug Bridge.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+#ifndef BRINGUPSCHEDULER_H
+#define BRINGUPSCHEDULER_H
+
+#include "usb-host/usbdevice.h"
+
+#include <QtCore/qelapsedtimer.h>
+#include <QtCore/qhash.h>
+#include <QtCore/qqueue.h>
+#include <QtCore/qstring.h>
+
+#include <functional>
+
+using BringUpStarter = std::function<void(const UsbDevice &)>;
+
+// Limits how many devices are brought up at the same time and measures how
+// long each phase of a bring-up takes. A bring-up holds its slot until the
+// device is configured; waiting for the device's IP address does not count
+// against the limit.
+class BringUpScheduler
+{
+public:
+    static const int defaultMaxParallel = 16;
+
+    explicit BringUpScheduler(BringUpStarter starter);
+
+    int maxParallel() const;
+    void setMaxParallel(int maxParallel);
+
+    //! Start the bring-up of the device now or once a slot is free
+    void schedule(const UsbDevice &device);
+    //! The device has been configured and only its IP address is missing
+    void markConfigured(const QString &serial);
+    void finish(const QString &serial, bool success);
+    //! Drop the device, e.g. because it was unplugged
+    void cancel(const QString &serial);
+
+private:
+    struct BringUp
+    {
+        QElapsedTimer timer;
+        qint64 queued = -1;     // ms waiting for a slot
+        qint64 configured = -1; // ms from the start until configured
+        bool holdsSlot = false;
+    };
+
+    void startQueued();
+    void releaseSlot(BringUp &bringUp);
+
+    BringUpStarter m_starter;
+    int m_maxParallel;
+    int m_active;
+    QQueue<UsbDevice> m_queue;
+    QHash<QString, BringUp> m_bringUps;
+    // Time of the current burst of bring-ups, e.g. a powered on hub
+    QElapsedTimer m_burstTimer;
+    int m_burstSize;
+};
+
+#endif // BRINGUPSCHEDULER_H
@@ -31,13 +31,31 @@
 #include "libqdb/make_unique.h"
 #include "libqdb/protocol/protocol.h"
 #include "libqdb/protocol/qdbtransport.h"
+#include "libqdb/tracering.h"
 #include "service.h"
 
 #include <QtCore/qdebug.h>
 #include <QtCore/qloggingcategory.h>
+#include <QtCore/qtimer.h>
+
+#include <algorithm>
+#include <limits>
 
 Q_LOGGING_CATEGORY(connectionC, "qdb.connection");
 
+namespace {
+
+const int defaultHeartbeatInterval = 1000; // in ms
+
+qint64 monotonicMsecs()
+{
+    QElapsedTimer timer;
+    timer.start();
+    return timer.msecsSinceReference();
+}
+
+} // anonymous namespace
+
 RefuseReason toRefuseReason(uint32_t data)
 {
     switch (data) {
@@ -52,10 +70,25 @@ RefuseReason toRefuseReason(uint32_t data)
 Connection::Connection(QdbTransport *transport, QObject *parent)
     : AbstractConnection{transport, parent},
       m_state{ConnectionState::Disconnected},
+      m_sessionToken{0},
+      m_unacknowledgedBytes{0},
+      m_waitTimer{},
+      m_lastActivity{monotonicMsecs()},
+      m_capabilities{0},
+      m_resumeGracePeriod{-1},
+      m_heartbeatInterval{defaultHeartbeatInterval},
+      m_heartbeatTimer{this},
+      m_heartbeatClock{},
+      m_rtt{},
+      m_deferredHostStream{0},
+      m_deferredDeviceStream{0},
       m_streamRequests{},
+      m_scheduler{},
+      m_retryScheduled{false},
       m_closing{false}
 {
-
+    m_heartbeatClock.start();
+    QObject::connect(&m_heartbeatTimer, &QTimer::timeout, this, &Connection::sendHeartbeat);
 }
 
 Connection::~Connection()
@@ -69,26 +102,40 @@ void Connection::connect()
 
     QByteArray versionBuffer{};
     QDataStream dataStream{&versionBuffer, QIODevice::WriteOnly};
-    dataStream << qdbProtocolVersion;
+    // Devices that do not support resuming sessions ignore the token, and
+    // older devices ignore the capabilities
+    dataStream << qdbProtocolVersion << m_sessionToken << qdbCapabilities
+               << static_cast<uint32_t>(m_heartbeatInterval);
 
     enqueueMessage(QdbMessage{QdbMessage::Connect, 0, 0, versionBuffer});
 }
 
+void Connection::start()
+{
+    if (!initialize()) {
+        qCCritical(connectionC) << "Could not initialize connection";
+        emit disconnected();
+        return;
+    }
+    connect();
+}
+
 void Connection::close()
 {
     if (m_state == ConnectionState::Disconnected)
         return;
 
     if (m_state == ConnectionState::WaitingForConnection) {
-        m_state = ConnectionState::Disconnected;
+        setState(ConnectionState::Disconnected);
         return;
     }
 
     // No need to wait for 'Ok's just to send the final Closes
     if (m_state == ConnectionState::Waiting)
-        m_state = ConnectionState::Connected;
+        setState(ConnectionState::Connected);
 
     m_outgoingMessages.clear();
+    m_scheduler.clear();
     m_streamRequests.clear();
 
     while (!m_streams.empty()) {
@@ -97,7 +144,21 @@ void Connection::close()
         // Processing of the Close message erased the stream from m_streams
     }
 
-    m_state = ConnectionState::Disconnected;
+    setState(ConnectionState::Disconnected);
+}
+
+void Connection::reset()
+{
+    if (m_state != ConnectionState::Disconnected)
+        resetConnection(false);
+}
+
+void Connection::setState(ConnectionState state)
+{
+    const ConnectionState oldState = m_state.exchange(state);
+    if (oldState != state)
+        TraceRing::record(TraceEvent::StateChanged, this, static_cast<quint32>(oldState),
+                          static_cast<quint32>(state));
 }
 
 ConnectionState Connection::state() const
@@ -105,6 +166,26 @@ ConnectionState Connection::state() const
     return m_state;
 }
 
+uint32_t Connection::sessionToken() const
+{
+    return m_sessionToken;
+}
+
+int Connection::resumeGracePeriod() const
+{
+    return m_resumeGracePeriod;
+}
+
+void Connection::setSessionToken(uint32_t token)
+{
+    m_sessionToken = token;
+}
+
+void Connection::setHeartbeatInterval(int interval)
+{
+    m_heartbeatInterval = interval;
+}
+
 void Connection::createStream(const QByteArray &openTag, StreamCreatedCallback streamCreatedCallback)
 {
     StreamId id = m_nextStreamId++;
@@ -112,17 +193,70 @@ void Connection::createStream(const QByteArray &openTag, StreamCreatedCallback s
     enqueueMessage(QdbMessage{QdbMessage::Open, id, 0, openTag});
 }
 
+void Connection::setStreamTrafficClass(StreamId hostId, const QString &client,
+                                       const TrafficClass &trafficClass, quint32 streamWeight)
+{
+    if (m_streams.find(hostId) == m_streams.end())
+        return;
+    m_scheduler.setTrafficClass(hostId, client, trafficClass);
+    m_scheduler.setStreamWeight(hostId, streamWeight);
+    processQueue();
+}
+
+void Connection::setClientTrafficClass(const QString &client, const TrafficClass &trafficClass)
+{
+    m_scheduler.setClientTrafficClass(client, trafficClass);
+    QMetaObject::invokeMethod(this, [this]() { processQueue(); }, Qt::QueuedConnection);
+}
+
+std::vector<StreamStatistics> Connection::statistics() const
+{
+    return m_scheduler.statistics();
+}
+
+qint64 Connection::idleTime() const
+{
+    return monotonicMsecs() - m_lastActivity;
+}
+
+RoundTripTimes Connection::roundTripTimes() const
+{
+    return m_rtt.roundTripTimes();
+}
+
+bool Connection::hasCapability(ProtocolCapability capability) const
+{
+    return (m_capabilities & capability) != 0;
+}
+
+bool Connection::sendsHeartbeats() const
+{
+    // The interval is only set before the connection is started
+    return m_heartbeatInterval > 0 && hasCapability(HeartbeatCapability);
+}
+
 void Connection::enqueueMessage(const QdbMessage &message)
 {
     Q_ASSERT(message.command() != QdbMessage::Invalid);
     qCDebug(connectionC) << "Connection enqueue: " << message;
-    m_outgoingMessages.enqueue(message);
+    if (isScheduledMessage(message))
+        m_scheduler.enqueue(message);
+    else
+        m_outgoingMessages.enqueue(message);
     processQueue();
 }
 
+bool Connection::isScheduledMessage(const QdbMessage &message) const
+{
+    // Closes are scheduled with the Writes of the stream to keep their order
+    return (message.command() == QdbMessage::Write || message.command() == QdbMessage::Close)
+            && m_streams.find(message.hostStream()) != m_streams.end();
+}
+
 void Connection::handleMessage()
 {
     QdbMessage message = m_transport->receive();
+    m_lastActivity = monotonicMsecs();
 
     if (message.command() == QdbMessage::Open)
         qFatal("Connection received QdbMessage::Open, which is not supported!");
@@ -134,6 +268,12 @@ void Connection::handleMessage()
         return;
     }
 
+    // Heartbeats do not take part in the acknowledgements
+    if (message.command() == QdbMessage::Ping || message.command() == QdbMessage::Pong) {
+        handleHeartbeat(message);
+        return;
+    }
+
     switch (m_state) {
     case ConnectionState::Disconnected:
         qCWarning(connectionC) << "Connection got a message in Disconnected state";
@@ -147,10 +287,12 @@ void Connection::handleMessage()
         }
 
         if (message.command() == QdbMessage::Connect) {
-            if (checkVersion(message))
-                m_state = ConnectionState::Connected;
-            else
-                m_state = ConnectionState::Disconnected;
+            if (checkVersion(message)) {
+                setState(ConnectionState::Connected);
+                handleConnect(message.data());
+            } else {
+                setState(ConnectionState::Disconnected);
+            }
         } else if (message.command() == QdbMessage::Refuse) {
             handleRefuse(message.data());
         }
@@ -175,6 +317,10 @@ void Connection::handleMessage()
             break;
         case QdbMessage::Open:
             //[[fallthrough]]
+        case QdbMessage::Ping:
+            //[[fallthrough]]
+        case QdbMessage::Pong:
+            //[[fallthrough]]
         case QdbMessage::Invalid:
             Q_UNREACHABLE();
             break;
@@ -196,14 +342,22 @@ void Connection::handleMessage()
             closeStream(message.hostStream());
             break;
         case QdbMessage::Ok:
-            m_state = ConnectionState::Connected;
+            setState(ConnectionState::Connected);
+            TraceRing::record(TraceEvent::Acknowledged, this, message.hostStream(), message.deviceStream(),
+                              static_cast<quint32>(m_waitTimer.nsecsElapsed() / 1000));
             if (m_streamRequests.contains(message.hostStream())) {
                 // This message is a response to Open
                 finishCreateStream(message.hostStream(), message.deviceStream());
+            } else {
+                handleWriteAcknowledged(message.hostStream());
             }
             break;
         case QdbMessage::Open:
             //[[fallthrough]]
+        case QdbMessage::Ping:
+            //[[fallthrough]]
+        case QdbMessage::Pong:
+            //[[fallthrough]]
         case QdbMessage::Invalid:
             Q_UNREACHABLE();
             break;
@@ -226,9 +380,28 @@ void Connection::acknowledge(StreamId hostId, StreamId deviceId)
     }
 }
 
+void Connection::acknowledgeDeferred(StreamId hostId)
+{
+    if (m_deferredHostStream == 0 || m_deferredHostStream != hostId)
+        return;
+
+    const StreamId deviceId = m_deferredDeviceStream;
+    m_deferredHostStream = 0;
+    m_deferredDeviceStream = 0;
+    if (m_state == ConnectionState::Connected || m_state == ConnectionState::Waiting)
+        acknowledge(hostId, deviceId);
+}
+
+void Connection::handleWriteAcknowledged(StreamId hostId)
+{
+    const auto iter = m_streams.find(hostId);
+    if (iter != m_streams.end())
+        iter->second->acknowledgeWrite(m_unacknowledgedBytes);
+}
+
 void Connection::processQueue()
 {
-    if (m_outgoingMessages.isEmpty()) {
+    if (m_outgoingMessages.isEmpty() && m_scheduler.isEmpty()) {
         return;
     }
 
@@ -242,7 +415,23 @@ void Connection::processQueue()
         return;
     }
 
-    auto message = m_outgoingMessages.dequeue();
+    QdbMessage message;
+    if (!m_outgoingMessages.isEmpty()) {
+        message = m_outgoingMessages.dequeue();
+    } else {
+        int retryAfter = -1;
+        if (!m_scheduler.dequeue(&message, &retryAfter)) {
+            // Every stream with queued messages is over its byte rate
+            if (retryAfter >= 0 && !m_retryScheduled) {
+                m_retryScheduled = true;
+                QTimer::singleShot(retryAfter, this, [this]() {
+                    m_retryScheduled = false;
+                    processQueue();
+                });
+            }
+            return;
+        }
+    }
 
     Q_ASSERT_X(message.command() != QdbMessage::Invalid, "Connection::processQueue()",
                "Tried to send invalid message");
@@ -258,16 +447,19 @@ void Connection::processQueue()
     switch (message.command()) {
     case QdbMessage::Connect:
         Q_ASSERT(m_state == ConnectionState::Disconnected);
-        m_state = ConnectionState::WaitingForConnection;
+        setState(ConnectionState::WaitingForConnection);
         break;
         // Need to wait for Ok after Open and Write
     case QdbMessage::Open:
         Q_ASSERT(m_state == ConnectionState::Connected);
-        m_state = ConnectionState::Waiting;
+        setState(ConnectionState::Waiting);
+        m_waitTimer.start();
         break;
     case QdbMessage::Write:
         Q_ASSERT(m_state == ConnectionState::Connected);
-        m_state = ConnectionState::Waiting;
+        setState(ConnectionState::Waiting);
+        m_waitTimer.start();
+        m_unacknowledgedBytes = message.data().size();
         break;
         // Close is not acknowledged so no need to transition to ConnectionState::Waiting
     case QdbMessage::Close:
@@ -277,6 +469,11 @@ void Connection::processQueue()
     case QdbMessage::Ok:
         // 'Ok's are sent via acknowledge()
         //[[fallthrough]]
+    case QdbMessage::Ping:
+        //[[fallthrough]]
+    case QdbMessage::Pong:
+        // Heartbeats are sent directly too
+        //[[fallthrough]]
     case QdbMessage::Refuse:
         //[[fallthrough]]
     case QdbMessage::Invalid:
@@ -288,7 +485,16 @@ void Connection::processQueue()
 void Connection::resetConnection(bool reconnect)
 {
     m_outgoingMessages.clear();
-    m_state = ConnectionState::Disconnected;
+    m_scheduler.clear();
+    setState(ConnectionState::Disconnected);
+    m_heartbeatTimer.stop();
+    m_capabilities = 0;
+    // The next connection may go over another link
+    m_rtt.reset();
+    // The streams of the session are closed here, so it must not be resumed
+    m_sessionToken = 0;
+    m_deferredHostStream = 0;
+    m_deferredDeviceStream = 0;
     m_streamRequests.clear();
     for (const auto &pair : m_streams) {
         const auto &stream = pair.second;
@@ -307,8 +513,13 @@ void Connection::closeStream(StreamId id)
     if (m_streams.find(id) == m_streams.end())
         return;
 
+    // The device would otherwise keep waiting for the acknowledgement
+    acknowledgeDeferred(id);
+    if (m_streams.find(id) == m_streams.end())
+        return; // Sending the acknowledgement failed and reset the connection
     m_streams[id]->close();
     m_streams.erase(id);
+    m_scheduler.removeStream(id);
 
     auto messageInStream = [&id](const QdbMessage &message) {
         return message.hostStream() == id;
@@ -322,6 +533,9 @@ void Connection::closeStream(StreamId id)
 void Connection::finishCreateStream(StreamId hostId, StreamId deviceId)
 {
     m_streams[hostId] = make_unique<Stream>(this, hostId, deviceId);
+    QObject::connect(m_streams[hostId].get(), &Stream::resumed, this, [=]() {
+        acknowledgeDeferred(hostId);
+    });
     StreamCreatedCallback callback = m_streamRequests.take(hostId);
     callback(m_streams[hostId].get());
 }
@@ -359,14 +573,26 @@ void Connection::handleWrite(const QdbMessage &message)
         enqueueMessage(QdbMessage{QdbMessage::Close, message.hostStream(), message.deviceStream()});
         return;
     }
-    acknowledge(message.hostStream(), message.deviceStream());
-    m_streams[message.hostStream()]->receiveMessage(message);
+    Stream *stream = m_streams[message.hostStream()].get();
+    m_scheduler.recordReceived(message.hostStream(), message.data().size());
+    // Delivered first, so that a reader that can't keep up with this data
+    // already holds back its acknowledgement
+    stream->receiveMessage(message);
+    if (stream->isPaused()) {
+        // Acknowledged once the stream is resumed. Since the device waits for
+        // the Ok, there can't be more than one deferred acknowledgement.
+        m_deferredHostStream = message.hostStream();
+        m_deferredDeviceStream = message.deviceStream();
+    } else {
+        acknowledge(message.hostStream(), message.deviceStream());
+    }
 }
 
 bool Connection::checkVersion(const QdbMessage &message)
 {
     Q_ASSERT(message.command() == QdbMessage::Connect);
-    Q_ASSERT(message.data().size() == sizeof(qdbProtocolVersion));
+    // A session token may follow the version
+    Q_ASSERT(message.data().size() >= static_cast<int>(sizeof(qdbProtocolVersion)));
 
     QDataStream dataStream{message.data()};
     uint32_t protocolVersion;
@@ -379,3 +605,98 @@ bool Connection::checkVersion(const QdbMessage &message)
     }
     return true;
 }
+
+void Connection::handleConnect(const QByteArray &payload)
+{
+    QDataStream dataStream{payload};
+    uint32_t protocolVersion = 0;
+    uint32_t token = 0; // Older devices do not send a session token
+    uint32_t capabilities = 0; // nor the capabilities
+    uint32_t resumeGracePeriod = 0; // nor how long they keep a session
+    dataStream >> protocolVersion;
+    if (static_cast<size_t>(payload.size()) >= sizeof(protocolVersion) + sizeof(token))
+        dataStream >> token;
+    if (static_cast<size_t>(payload.size())
+            >= sizeof(protocolVersion) + sizeof(token) + sizeof(capabilities))
+        dataStream >> capabilities;
+    const bool hasResumeGracePeriod = static_cast<size_t>(payload.size())
+            >= sizeof(protocolVersion) + sizeof(token) + sizeof(capabilities)
+               + sizeof(resumeGracePeriod);
+    if (hasResumeGracePeriod) {
+        dataStream >> resumeGracePeriod;
+        m_resumeGracePeriod = static_cast<int>(std::min<uint32_t>(resumeGracePeriod,
+                                                                  std::numeric_limits<int>::max()));
+    }
+
+    const bool sessionResumed = m_sessionToken != 0 && token == m_sessionToken;
+    m_sessionToken = token;
+    m_capabilities = capabilities & qdbCapabilities;
+
+    if (sendsHeartbeats()) {
+        qCDebug(connectionC) << "Sending heartbeats every" << m_heartbeatInterval << "ms";
+        m_heartbeatTimer.start(m_heartbeatInterval);
+    }
+
+    if (sessionResumed) {
+        qCDebug(connectionC) << "Resumed session" << token;
+        emit resumed();
+    } else {
+        emit connected();
+    }
+}
+
+void Connection::handleHeartbeat(const QdbMessage &message)
+{
+    if (m_state != ConnectionState::Connected && m_state != ConnectionState::Waiting)
+        return;
+
+    if (message.command() == QdbMessage::Ping) {
+        if (!m_transport->send(QdbMessage{QdbMessage::Pong, 0, 0, message.data()})) {
+            qCCritical(connectionC) << "Connection could not answer heartbeat";
+            resetConnection(false);
+        }
+        return;
+    }
+
+    QDataStream dataStream{message.data()};
+    qint64 sentAt = 0;
+    dataStream >> sentAt;
+    if (dataStream.status() != QDataStream::Ok) {
+        qCWarning(connectionC) << "Connection received invalid heartbeat answer";
+        return;
+    }
+    m_rtt.addSample((m_heartbeatClock.nsecsElapsed() - sentAt) / 1000);
+}
+
+void Connection::sendHeartbeat()
+{
+    if (m_state != ConnectionState::Connected && m_state != ConnectionState::Waiting) {
+        m_heartbeatTimer.stop();
+        return;
+    }
+
+    // Anything from the device proves the link is alive, not only Pongs
+    const qint64 silence = idleTime();
+    if (silence > deadLinkTimeout()) {
+        qCWarning(connectionC) << "Device has not answered for" << silence << "ms, dropping the connection";
+        resetConnection(false);
+        return;
+    }
+
+    QByteArray payload;
+    QDataStream dataStream{&payload, QIODevice::WriteOnly};
+    dataStream << static_cast<qint64>(m_heartbeatClock.nsecsElapsed());
+    if (!m_transport->send(QdbMessage{QdbMessage::Ping, 0, 0, payload})) {
+        qCCritical(connectionC) << "Connection could not send heartbeat";
+        resetConnection(false);
+    }
+}
+
+qint64 Connection::deadLinkTimeout() const
+{
+    // A slow link gets at least the retransmission timeout of its round trip
+    // times on top of the interval before the last Ping counts as missed
+    const qint64 missed = static_cast<qint64>(qdbMissedHeartbeatLimit) * m_heartbeatInterval;
+    const qint64 overdue = m_heartbeatInterval + m_rtt.timeout() / 1000;
+    return std::max(missed, overdue);
+}
@@ -30,12 +30,18 @@
 #define CONNECTION_H
 
 #include "libqdb/abstractconnection.h"
+#include "libqdb/protocol/protocol.h"
+#include "rttestimator.h"
+#include "trafficscheduler.h"
 class Service;
 class QdbMessage;
 class QdbTransport;
 
+#include <QtCore/qelapsedtimer.h>
 #include <QtCore/qhash.h>
+#include <QtCore/qtimer.h>
 
+#include <atomic>
 #include <functional>
 #include <memory>
 #include <unordered_map>
@@ -59,30 +65,93 @@ public:
     ~Connection();
 
     void connect();
+    //! Thread-safe
     ConnectionState state() const;
+    uint32_t sessionToken() const;
+    //! Token of an earlier session to resume with the next connect()
+    void setSessionToken(uint32_t token);
+    //! Thread-safe, ms the device keeps its session token and network configuration after
+    //! losing the link, -1 if it did not tell
+    int resumeGracePeriod() const;
+    //! Interval of heartbeats in ms from the next connect() on, 0 disables them
+    void setHeartbeatInterval(int interval);
     void createStream(const QByteArray &openTag, StreamCreatedCallback streamCreatedCallback);
+    //! Schedules the stream as part of the traffic of the client, with the weight within the client
+    void setStreamTrafficClass(StreamId hostId, const QString &client, const TrafficClass &trafficClass,
+                               quint32 streamWeight);
+    //! Thread-safe
+    void setClientTrafficClass(const QString &client, const TrafficClass &trafficClass);
+    //! Thread-safe
+    std::vector<StreamStatistics> statistics() const;
+    //! Thread-safe, milliseconds since the last message from the device
+    qint64 idleTime() const;
+    //! Thread-safe, measured with heartbeats if the device supports them
+    RoundTripTimes roundTripTimes() const;
+    //! Thread-safe, whether both sides support the feature in the current connection
+    bool hasCapability(ProtocolCapability capability) const;
+    //! Thread-safe, whether heartbeats watch the link in the current connection
+    bool sendsHeartbeats() const;
 
     void enqueueMessage(const QdbMessage &message) override;
 
 signals:
+    void connected();
+    //! Connected and the device still had the session of the session token. Only
+    //! the network configuration of the device is kept, streams have to be reopened.
+    void resumed();
     void disconnected();
 
 public slots:
+    //! Initialize and connect, for use once the connection is in its own thread
+    void start();
     void close();
+    //! Drop the connection without waiting for the device, which stopped responding
+    void reset();
     void handleMessage() override;
 
 private:
+    void setState(ConnectionState state);
     void acknowledge(StreamId hostId, StreamId deviceId);
+    void acknowledgeDeferred(StreamId hostId);
+    void handleWriteAcknowledged(StreamId hostId);
     void processQueue();
+    bool isScheduledMessage(const QdbMessage &message) const;
     void resetConnection(bool reconnect);
     void closeStream(StreamId id);
     void finishCreateStream(StreamId hostId, StreamId deviceId);
     void handleRefuse(const QByteArray &payload);
     void handleWrite(const QdbMessage &message);
     bool checkVersion(const QdbMessage &message);
+    void handleConnect(const QByteArray &payload);
+    void handleHeartbeat(const QdbMessage &message);
+    void sendHeartbeat();
+    qint64 deadLinkTimeout() const;
 
-    ConnectionState m_state;
+    // Atomic since the state is checked from outside the thread of the connection
+    std::atomic<ConnectionState> m_state;
+    uint32_t m_sessionToken;
+    // Size of the sent Write that is waiting for Ok in ConnectionState::Waiting
+    int m_unacknowledgedBytes;
+    // Time since entering ConnectionState::Waiting, for tracing
+    QElapsedTimer m_waitTimer;
+    // Monotonic time of the last message from the device in ms, read from other threads
+    std::atomic<qint64> m_lastActivity;
+    // Capabilities supported by both sides in the current connection, read from other threads
+    std::atomic<uint32_t> m_capabilities;
+    // Read from the thread of the DeviceManager when the device is unplugged
+    std::atomic<int> m_resumeGracePeriod;
+    int m_heartbeatInterval;
+    QTimer m_heartbeatTimer;
+    // Send times of Pings, which the device returns in the Pongs
+    QElapsedTimer m_heartbeatClock;
+    RttEstimator m_rtt;
+    // Write from the device that is not acknowledged while its stream is paused
+    StreamId m_deferredHostStream;
+    StreamId m_deferredDeviceStream;
     QHash<StreamId, StreamCreatedCallback> m_streamRequests;
+    // Writes and Closes of open streams, other messages go to m_outgoingMessages
+    TrafficScheduler m_scheduler;
+    bool m_retryScheduled;
     bool m_closing;
 };
 
@@ -29,37 +29,196 @@
 #include "connectionpool.h"
 
 #include "connection.h"
+#include "connectionprobe.h"
 #include "libqdb/protocol/qdbtransport.h"
 #include "usb-host/usbconnection.h"
 #include "usb-host/usbdevice.h"
 
 #include <QtCore/qloggingcategory.h>
+#include <QtCore/qthread.h>
 
 Q_LOGGING_CATEGORY(connectionPoolC, "qdb.connectionpool")
 
-std::shared_ptr<Connection> ConnectionPool::connect(const UsbDevice &device)
+namespace {
+
+const int defaultIdleTimeout = 60000; // in ms
+const int defaultHeartbeatInterval = 1000; // in ms
+// Connections without traffic or heartbeats for this long are probed
+const int probeInterval = 15000; // in ms
+const int sweepInterval = 1000; // in ms
+
+} // anonymous namespace
+
+ConnectionPool::ConnectionPool(QObject *parent)
+    : QObject{parent},
+      m_threads{QString{"Connection"}, QThread::idealThreadCount()},
+      m_connections{},
+      m_sessionTokens{std::make_shared<SessionTokens>()},
+      m_sweepTimer{},
+      m_idleTimeout{defaultIdleTimeout},
+      m_heartbeatInterval{defaultHeartbeatInterval},
+      m_transportFactory{}
+{
+    m_sweepTimer.setInterval(sweepInterval);
+    QObject::connect(&m_sweepTimer, &QTimer::timeout, this, &ConnectionPool::sweep);
+    m_sweepTimer.start();
+}
+
+ConnectionPool::~ConnectionPool()
+{
+    // WorkerThreadPool joins the threads, which runs the pending deleteLater()s
+    // of the connections that are already gone.
+}
+
+std::shared_ptr<Connection> ConnectionPool::connect(const UsbDevice &device, ConnectionSetup setup)
 {
     if (m_connections.contains(device.serial)) {
-        std::shared_ptr<Connection> existingConnection = m_connections[device.serial].lock();
-        if (existingConnection) {
+        PooledConnection &existing = m_connections[device.serial];
+        // A disconnected connection has lost its transport, so it can't be reused
+        if (existing.connection->state() != ConnectionState::Disconnected) {
             qDebug(connectionPoolC) << "Using existing connection to" << device.serial;
-            return existingConnection;
+            existing.unusedTime.invalidate();
+            return existing.connection;
         } else {
             qDebug(connectionPoolC) << "Existing connection to" << device.serial << "expired, creating new one";
             m_connections.remove(device.serial);
         }
     }
 
-    auto connection = std::make_shared<Connection>(new QdbTransport{new UsbConnection{device}});
-    m_connections[device.serial] = std::weak_ptr<Connection>(connection);
+    QdbTransport *transport = m_transportFactory ? m_transportFactory(device)
+                                                 : new QdbTransport{new UsbConnection{device}};
+    // The connection is deleted in its own thread, whichever thread drops the last reference
+    auto connection = std::shared_ptr<Connection>(
+                new Connection{transport},
+                [](Connection *connection) { connection->deleteLater(); });
+    m_connections.insert(device.serial, PooledConnection{connection, QElapsedTimer{}, false});
+    connection->setHeartbeatInterval(m_heartbeatInterval);
 
-    if (!connection->initialize()) {
-        qCCritical(connectionPoolC) << "Could not initialize connection to" << device.serial;
-        return std::shared_ptr<Connection>(nullptr);
+    {
+        QMutexLocker locker{&m_sessionTokens->lock};
+        connection->setSessionToken(m_sessionTokens->tokens.value(device.serial));
     }
+    const auto sessionTokens = m_sessionTokens;
+    const QString serial = device.serial;
+    Connection *rawConnection = connection.get();
+    auto rememberToken = [=]() {
+        QMutexLocker locker{&sessionTokens->lock};
+        sessionTokens->tokens.insert(serial, rawConnection->sessionToken());
+    };
+    QObject::connect(rawConnection, &Connection::connected, rawConnection, rememberToken);
+    QObject::connect(rawConnection, &Connection::resumed, rawConnection, rememberToken);
 
-    connection->connect();
-    qCDebug(connectionPoolC) << "Initialized connection to" << device.serial;
+    if (setup)
+        setup(rawConnection);
+
+    QThread *thread = m_threads.acquire();
+    // The thread is given back once the connection is gone, however it went
+    QObject::connect(rawConnection, &QObject::destroyed, this, [this, thread]() {
+        m_threads.release(thread);
+    });
+    connection->moveToThread(thread);
+    QMetaObject::invokeMethod(rawConnection, &Connection::start, Qt::QueuedConnection);
+    qCDebug(connectionPoolC) << "Starting connection to" << device.serial << "in" << thread->objectName();
 
     return connection;
 }
+
+void ConnectionPool::release(const QString &serial)
+{
+    if (m_connections.remove(serial))
+        qCDebug(connectionPoolC) << "Released connection to" << serial;
+}
+
+void ConnectionPool::forgetSession(const QString &serial)
+{
+    QMutexLocker locker{&m_sessionTokens->lock};
+    m_sessionTokens->tokens.remove(serial);
+}
+
+void ConnectionPool::setIdleTimeout(int timeout)
+{
+    qCDebug(connectionPoolC) << "Closing connections after" << timeout << "ms of idle time";
+    m_idleTimeout = timeout;
+}
+
+void ConnectionPool::setHeartbeatInterval(int interval)
+{
+    qCDebug(connectionPoolC) << "Sending heartbeats every" << interval << "ms";
+    m_heartbeatInterval = interval;
+}
+
+void ConnectionPool::setTransportFactory(TransportFactory factory)
+{
+    m_transportFactory = std::move(factory);
+}
+
+void ConnectionPool::sweep()
+{
+    auto iter = m_connections.begin();
+    while (iter != m_connections.end()) {
+        PooledConnection &pooled = iter.value();
+        const auto &connection = pooled.connection;
+        // A running probe holds a reference too
+        const bool used = connection.use_count() > (pooled.probing ? 2 : 1);
+        if (used) {
+            pooled.unusedTime.invalidate();
+        } else if (!pooled.unusedTime.isValid()) {
+            pooled.unusedTime.start();
+        }
+
+        if (!used && connection->state() == ConnectionState::Disconnected) {
+            qCDebug(connectionPoolC) << "Dropping closed connection to" << iter.key();
+            forgetSession(iter.key());
+            iter = m_connections.erase(iter);
+            continue;
+        }
+        if (!used && m_idleTimeout > 0 && pooled.unusedTime.hasExpired(m_idleTimeout)) {
+            qCDebug(connectionPoolC) << "Closing connection to" << iter.key() << "after"
+                                     << pooled.unusedTime.elapsed() << "ms of idle time";
+            // Closing the connection closes the streams of its session
+            forgetSession(iter.key());
+            iter = m_connections.erase(iter);
+            continue;
+        }
+        // Heartbeats already find out when such a link is dead
+        if (!pooled.probing && connection->state() == ConnectionState::Connected
+                && !connection->sendsHeartbeats() && connection->idleTime() >= probeInterval) {
+            probe(iter.key(), pooled);
+        }
+        ++iter;
+    }
+}
+
+void ConnectionPool::probe(const QString &serial, PooledConnection &pooled)
+{
+    qCDebug(connectionPoolC) << "Probing quiet connection to" << serial;
+    pooled.probing = true;
+    Connection *rawConnection = pooled.connection.get();
+    auto *probe = new ConnectionProbe{pooled.connection};
+    QObject::connect(probe, &ConnectionProbe::finished, probe, &QObject::deleteLater);
+    QObject::connect(probe, &ConnectionProbe::finished, this, [=](bool alive) {
+        handleProbed(serial, rawConnection, alive);
+    });
+
+    // Services of the device run in the thread of its connection
+    probe->moveToThread(rawConnection->thread());
+    QMetaObject::invokeMethod(probe, &ConnectionProbe::probe, Qt::QueuedConnection);
+}
+
+void ConnectionPool::handleProbed(const QString &serial, Connection *connection, bool alive)
+{
+    const auto iter = m_connections.find(serial);
+    // The connection may have been replaced while it was probed
+    if (iter == m_connections.end() || iter->connection.get() != connection)
+        return;
+
+    iter->probing = false;
+    if (alive)
+        return;
+
+    qCWarning(connectionPoolC) << "Device" << serial << "did not answer, dropping its connection";
+    // Lets the users of the connection know that it is gone
+    QMetaObject::invokeMethod(connection, &Connection::reset, Qt::QueuedConnection);
+    forgetSession(serial);
+    m_connections.erase(iter);
+}
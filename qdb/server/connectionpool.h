@@ -30,21 +30,91 @@
 #define CONNECTIONPOOL_H
 
 class Connection;
+class QdbTransport;
 struct UsbDevice;
+#include "libqdb/workerthreadpool.h"
 
+#include <QtCore/qelapsedtimer.h>
 #include <QtCore/qhash.h>
+#include <QtCore/qmutex.h>
+#include <QtCore/qobject.h>
+#include <QtCore/qtimer.h>
 
+#include <functional>
 #include <memory>
 
-class ConnectionPool
+using ConnectionSetup = std::function<void(Connection *)>;
+using TransportFactory = std::function<QdbTransport *(const UsbDevice &)>;
+
+// Connections to devices, each living in a thread picked from a worker pool
+// so that a busy device does not slow down the others. Connections must only
+// be used from their own thread, except for the methods that Connection marks
+// thread-safe: state(), resumeGracePeriod(), setClientTrafficClass(),
+// statistics(), idleTime(), roundTripTimes(), hasCapability() and
+// sendsHeartbeats().
+//
+// The pool keeps the connections of attached devices open between
+// operations. Quiet connections to devices without heartbeats are probed,
+// and those that nobody else uses are closed once they have been idle for
+// the idle timeout. The DeviceWatcher of a device that pushes notifications
+// uses its connection for as long as the device is attached, so only
+// connections to devices without notifications are ever closed for being
+// idle.
+class ConnectionPool : public QObject
 {
+    Q_OBJECT
 public:
-    ConnectionPool() = default;
+    explicit ConnectionPool(QObject *parent = nullptr);
+    ~ConnectionPool();
+
+    /*!
+     * Returns the connection to the device, creating one if there is none.
+     * A new connection is passed to setup before it is started in its
+     * thread, which allows connecting to its signals without missing any.
+     */
+    std::shared_ptr<Connection> connect(const UsbDevice &device,
+                                        ConnectionSetup setup = ConnectionSetup{});
+    //! Stop keeping the connection to a device that is no longer attached
+    void release(const QString &serial);
+    //! Make the next connection to the device start a new session
+    void forgetSession(const QString &serial);
+    //! Idle time in ms after which unused connections are closed, 0 keeps them open.
+    //! Does not apply to devices that have a DeviceWatcher.
+    void setIdleTimeout(int timeout);
+    //! Heartbeat interval in ms of the connections created from now on, 0 disables them
+    void setHeartbeatInterval(int interval);
+    //! Creates the transports of new connections instead of opening the USB device
+    void setTransportFactory(TransportFactory factory);
 
-    std::shared_ptr<Connection> connect(const UsbDevice &device);
+private slots:
+    void sweep();
 
 private:
-    QHash<QString, std::weak_ptr<Connection>> m_connections;
+    struct SessionTokens
+    {
+        QMutex lock;
+        QHash<QString, uint32_t> tokens;
+    };
+
+    struct PooledConnection
+    {
+        std::shared_ptr<Connection> connection;
+        // Time since only the pool has referred to the connection
+        QElapsedTimer unusedTime;
+        bool probing;
+    };
+
+    void probe(const QString &serial, PooledConnection &pooled);
+    void handleProbed(const QString &serial, Connection *connection, bool alive);
+
+    WorkerThreadPool m_threads;
+    QHash<QString, PooledConnection> m_connections;
+    // Last session token of each device, shared with the connections that update it
+    std::shared_ptr<SessionTokens> m_sessionTokens;
+    QTimer m_sweepTimer;
+    int m_idleTimeout;
+    int m_heartbeatInterval;
+    TransportFactory m_transportFactory;
 };
 
 #endif // CONNECTIONPOOL_H
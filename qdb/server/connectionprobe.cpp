@@ -0,0 +1,103 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Debug Bridge.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+#include "connectionprobe.h"
+
+#include "connection.h"
+#include "echoservice.h"
+
+#include <QtCore/qdebug.h>
+#include <QtCore/qloggingcategory.h>
+
+Q_LOGGING_CATEGORY(probeC, "qdb.connectionpool.probe");
+
+namespace {
+
+const int probeTimeout = 3000; // in ms
+
+} // anonymous namespace
+
+ConnectionProbe::ConnectionProbe(std::shared_ptr<Connection> connection)
+    : m_connection{connection},
+      m_service{nullptr},
+      m_timer{this},
+      m_finished{false}
+{
+    m_timer.setSingleShot(true);
+    m_timer.setInterval(probeTimeout);
+    connect(&m_timer, &QTimer::timeout, this, &ConnectionProbe::handleTimeout);
+}
+
+void ConnectionProbe::probe()
+{
+    if (!m_connection || m_connection->state() == ConnectionState::Disconnected) {
+        finish(false);
+        return;
+    }
+
+    m_service = new EchoService{m_connection.get()};
+    connect(m_service, &EchoService::initialized, this, &ConnectionProbe::handleInitialized);
+    connect(m_service, &EchoService::echo, this, &ConnectionProbe::handleEcho);
+    connect(m_connection.get(), &Connection::disconnected, this, [this]() { finish(false); });
+
+    m_timer.start();
+    m_service->initialize();
+}
+
+void ConnectionProbe::handleInitialized()
+{
+    m_service->send("probe");
+}
+
+void ConnectionProbe::handleEcho()
+{
+    finish(true);
+}
+
+void ConnectionProbe::handleTimeout()
+{
+    qCDebug(probeC) << "Connection did not answer the probe in time";
+    finish(false);
+}
+
+void ConnectionProbe::finish(bool alive)
+{
+    if (m_finished)
+        return;
+    m_finished = true;
+
+    m_timer.stop();
+    if (m_connection)
+        QObject::disconnect(m_connection.get(), nullptr, this, nullptr);
+    if (m_service) {
+        QObject::disconnect(m_service, nullptr, this, nullptr);
+        m_service->deleteLater();
+        m_service = nullptr;
+    }
+    emit finished(alive);
+}
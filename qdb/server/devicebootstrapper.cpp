@@ -0,0 +1,180 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Debug Bridge.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+#include "devicebootstrapper.h"
+
+#include "bootstrapservice.h"
+#include "connection.h"
+#include "networkconfigurator.h"
+#include "subnetcache.h"
+
+#include <QtCore/qdebug.h>
+#include <QtCore/qloggingcategory.h>
+
+Q_LOGGING_CATEGORY(bootstrapperC, "qdb.devices.bootstrap");
+
+namespace {
+
+// Devices accept the bootstrap before configuring their network, so only
+// devices without the service take this long
+const int acceptTimeout = 2000; // in ms
+
+} // anonymous namespace
+
+DeviceBootstrapper::DeviceBootstrapper(std::shared_ptr<Connection> connection, UsbDevice device)
+    : m_connection{connection},
+      m_device(device), // uniform initialization with {} fails in MSVC 2013 with error C2797
+      m_info{"", "", "", false},
+      m_service{nullptr},
+      m_acceptTimer{this},
+      m_configured{false}
+{
+    m_acceptTimer.setSingleShot(true);
+    m_acceptTimer.setInterval(acceptTimeout);
+    connect(&m_acceptTimer, &QTimer::timeout, this, &DeviceBootstrapper::handleTimeout);
+}
+
+void DeviceBootstrapper::bootstrap()
+{
+    if (!m_connection || m_connection->state() == ConnectionState::Disconnected) {
+        qCWarning(bootstrapperC) << "Could not bootstrap device" << m_device.serial
+                                 << "due to no connection";
+        fail();
+        return;
+    }
+
+    m_device.reservation = NetworkConfigurator::reserveSubnet(m_device.serial);
+    if (!m_device.reservation) {
+        fail();
+        return;
+    }
+
+    const QString proposal = NetworkConfigurator::subnetString(m_device.reservation->subnet());
+    m_service = new BootstrapService{m_connection.get(), proposal};
+
+    connect(m_service, &BootstrapService::accepted, this, &DeviceBootstrapper::handleAccepted);
+    connect(m_service, &BootstrapService::configured, this, &DeviceBootstrapper::handleConfigured);
+    connect(m_service, &BootstrapService::addressReady, this, &DeviceBootstrapper::handleAddressReady);
+    connect(m_service, &BootstrapService::failed, this, &DeviceBootstrapper::handleFailed);
+
+    m_acceptTimer.start();
+    m_service->initialize();
+}
+
+void DeviceBootstrapper::handleAccepted()
+{
+    m_acceptTimer.stop();
+}
+
+void DeviceBootstrapper::handleConfigured(ConfigurationResult result, QString subnet,
+                                          QString serial, QString hostMac, QString ipAddress,
+                                          bool updateFollows)
+{
+    m_acceptTimer.stop();
+    m_configured = true;
+
+    if (result == ConfigurationResult::AlreadySet) {
+        SubnetReservation reservation = NetworkConfigurator::adoptSubnet(m_device.serial, subnet,
+                                                                         m_device.reservation);
+        if (!reservation) {
+            fail();
+            return;
+        }
+        m_device.reservation = reservation;
+    } else if (result != ConfigurationResult::Success) {
+        qCWarning(bootstrapperC) << "Device" << m_device.serial << "could not configure subnet"
+                                 << subnet;
+        fail();
+        return;
+    }
+    SubnetCache::instance()->remember(m_device.serial, m_device.reservation->subnet());
+
+    qCDebug(bootstrapperC) << "Bootstrapped device" << serial << "with subnet" << subnet
+                           << "host-side MAC" << hostMac << "and IP address" << ipAddress;
+    m_info = DeviceInformationFetcher::Info{serial, hostMac, ipAddress,
+                                            updateFollows && !hostMac.isEmpty()};
+    emit fetched(m_device, m_info);
+
+    // Keep the stream open for the IP address the device pushes
+    if (!m_info.updateFollows)
+        finish();
+}
+
+void DeviceBootstrapper::handleAddressReady(QString ipAddress)
+{
+    qCDebug(bootstrapperC) << "Device" << m_info.serial << "has IP address" << ipAddress;
+    m_info.ipAddress = ipAddress;
+    m_info.updateFollows = false;
+    emit fetched(m_device, m_info);
+    finish();
+}
+
+void DeviceBootstrapper::handleFailed()
+{
+    m_acceptTimer.stop();
+    if (!m_configured) {
+        qCWarning(bootstrapperC) << "Bootstrap stream of device" << m_device.serial
+                                 << "closed before it was configured";
+        fail();
+        return;
+    }
+
+    qCDebug(bootstrapperC) << "Device" << m_info.serial << "closed the bootstrap before sending its IP address";
+    m_info.updateFollows = false;
+    emit fetched(m_device, m_info);
+    finish();
+}
+
+void DeviceBootstrapper::handleTimeout()
+{
+    qCDebug(bootstrapperC) << "Device" << m_device.serial
+                           << "does not support bootstrapping, configuring it step by step";
+    // Released so that the step by step configuration can offer it again
+    m_device.reservation.reset();
+    emit unsupported(m_device);
+    finish();
+}
+
+void DeviceBootstrapper::fail()
+{
+    m_device.reservation.reset();
+    emit failed(m_device);
+    finish();
+}
+
+void DeviceBootstrapper::finish()
+{
+    m_acceptTimer.stop();
+    if (m_service) {
+        // Closes the stream, after which the service must not report anything
+        QObject::disconnect(m_service, nullptr, this, nullptr);
+        m_service->deleteLater();
+        m_service = nullptr;
+    }
+    emit finished();
+}
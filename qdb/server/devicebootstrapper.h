@@ -0,0 +1,84 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Debug Bridge.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+#ifndef DEVICEBOOTSTRAPPER_H
+#define DEVICEBOOTSTRAPPER_H
+
+#include "deviceinformationfetcher.h"
+#include "libqdb/networkconfigurationcommon.h"
+#include "usb-host/usbdevice.h"
+
+#include <QtCore/qobject.h>
+#include <QtCore/qtimer.h>
+
+#include <memory>
+
+class BootstrapService;
+class Connection;
+
+// Brings a device up through the bootstrap service: configures its network
+// and fetches its information in one exchange, replacing the separate
+// NetworkConfigurator and DeviceInformationFetcher steps.
+class DeviceBootstrapper : public QObject
+{
+    Q_OBJECT
+public:
+    DeviceBootstrapper(std::shared_ptr<Connection> connection, UsbDevice device);
+
+signals:
+    //! Emitted again once the IP address arrives if info.updateFollows is set
+    void fetched(UsbDevice device, DeviceInformationFetcher::Info info);
+    void failed(UsbDevice device);
+    //! The device does not know the bootstrap service, configure it step by step
+    void unsupported(UsbDevice device);
+    void finished();
+
+public slots:
+    void bootstrap();
+
+private slots:
+    void handleAccepted();
+    void handleConfigured(ConfigurationResult result, QString subnet, QString serial,
+                          QString hostMac, QString ipAddress, bool updateFollows);
+    void handleAddressReady(QString ipAddress);
+    void handleFailed();
+    void handleTimeout();
+
+private:
+    void fail();
+    void finish();
+
+    std::shared_ptr<Connection> m_connection;
+    UsbDevice m_device;
+    DeviceInformationFetcher::Info m_info;
+    BootstrapService *m_service;
+    QTimer m_acceptTimer;
+    bool m_configured;
+};
+
+#endif // DEVICEBOOTSTRAPPER_H
@@ -41,7 +41,8 @@ Q_LOGGING_CATEGORY(deviceInfoC, "qdb.devices.info");
 DeviceInformationFetcher::DeviceInformationFetcher(std::shared_ptr<Connection> connection,
                                                    UsbDevice device)
     : m_connection{connection},
-      m_device(device) // uniform initialization with {} fails in MSVC 2013 with error C2797
+      m_device(device), // uniform initialization with {} fails in MSVC 2013 with error C2797
+      m_info{"", "", "", false}
 {
 
 }
@@ -50,13 +51,14 @@ void DeviceInformationFetcher::fetch()
 {
     if (!m_connection || m_connection->state() == ConnectionState::Disconnected) {
         qCWarning(deviceInfoC) << "Not fetching device information due to no connection";
-        emit fetched(m_device, Info{"", "", ""});
+        emit fetched(m_device, m_info);
+        emit finished();
         return;
     }
 
     auto *service = new HandshakeService{m_connection.get()};
 
-    connect(this, &DeviceInformationFetcher::fetched,
+    connect(this, &DeviceInformationFetcher::finished,
             service, &QObject::deleteLater);
     connect(service, &HandshakeService::response,
             this, &DeviceInformationFetcher::handshakeResponse);
@@ -67,11 +69,15 @@ void DeviceInformationFetcher::fetch()
     service->initialize();
 }
 
-void DeviceInformationFetcher::handshakeResponse(QString serial, QString hostMac, QString ipAddress)
+void DeviceInformationFetcher::handshakeResponse(QString serial, QString hostMac,
+                                                 QString ipAddress)
 {
     qCDebug(deviceInfoC) << "Fetched device information:";
     qCDebug(deviceInfoC) << "    Device serial:" << serial;
     qCDebug(deviceInfoC) << "    Host-side MAC address:" << hostMac;
     qCDebug(deviceInfoC) << "    Device IP address:" << ipAddress;
-    emit fetched(m_device, Info{serial, hostMac, ipAddress});
+    // Later changes of the address arrive on the notification stream
+    m_info = Info{serial, hostMac, ipAddress, false};
+    emit fetched(m_device, m_info);
+    emit finished();
 }
@@ -43,12 +43,14 @@ public:
         QString serial;
         QString hostMac;
         QString ipAddress;
+        bool updateFollows; // The device will send the IP address on the bootstrap stream
     };
 
     DeviceInformationFetcher(std::shared_ptr<Connection> connection, UsbDevice device);
 
 signals:
     void fetched(UsbDevice device, Info deviceInfo);
+    void finished();
 
 public slots:
     void fetch();
@@ -59,6 +61,8 @@ private slots:
 private:
     std::shared_ptr<Connection> m_connection;
     UsbDevice m_device;
+    Info m_info;
 };
+Q_DECLARE_METATYPE(DeviceInformationFetcher::Info)
 
 #endif // DEVICEINFORMATIONFETCHER_H
@@ -28,7 +28,11 @@
 ****************************************************************************/
 #include "devicemanager.h"
 
+#include "devicebootstrapper.h"
+#include "devicewatcher.h"
+#include "libqdb/make_unique.h"
 #include "networkconfigurator.h"
+#include "usb-host/usbdeviceenumerator.h"
 
 #include <QtCore/qdebug.h>
 #include <QtCore/qloggingcategory.h>
@@ -36,25 +40,134 @@
 
 Q_LOGGING_CATEGORY(devicesC, "qdb.devices");
 
+namespace {
+
+// Grace period of devices that do not tell how long they keep their session,
+// the default of qdbd
+const int defaultResumeGracePeriod = 5000;
+// Longest time to wait for the devices present at startup before serving clients
+const int startupTimeout = 5000;
+// Interval for polling devices that can not push their IP address
+const int incompletePollInterval = 1000;
+
+} // anonymous namespace
+
 DeviceManager::DeviceManager(QObject *parent)
     : QObject{parent},
-      m_deviceEnumerator{},
-      m_incompleteDevices{},
-      m_deviceInfos{}
+      m_addressMonitor{},
+      m_deviceEnumerator{make_unique<UsbDeviceEnumerator>()},
+      m_devices{},
+      m_trafficClasses{},
+      m_bringUps{[this](const UsbDevice &device) { startBringUp(device); }},
+      m_nextWatcherId{1},
+      m_startingDevices{},
+      m_starting{false},
+      m_ready{false}
+{
+
+}
+
+DeviceSnapshotPtr DeviceManager::snapshot() const
+{
+    return m_devices.snapshot();
+}
+
+std::shared_ptr<Connection> DeviceManager::connectToDevice(const QString &serial)
+{
+    DeviceRecord *record = m_devices.find(serial);
+    if (!record || !record->pluggedIn)
+        return std::shared_ptr<Connection>{};
+    return deviceConnection(record->usbDevice);
+}
+
+TrafficClass DeviceManager::trafficClass(const QString &client) const
+{
+    return m_trafficClasses.value(client);
+}
+
+void DeviceManager::setTrafficClass(const QString &client, const TrafficClass &trafficClass)
+{
+    qCDebug(devicesC) << "Traffic of" << client << "has weight" << trafficClass.weight
+                      << "and rate limit" << trafficClass.bytesPerSecond;
+    m_trafficClasses[client] = trafficClass;
+    m_devices.forEach([&](DeviceRecord &record) {
+        const auto connection = record.connection.lock();
+        if (connection)
+            connection->setClientTrafficClass(client, trafficClass);
+    });
+}
+
+QHash<QString, std::vector<StreamStatistics>> DeviceManager::trafficStatistics() const
+{
+    QHash<QString, std::vector<StreamStatistics>> result;
+    m_devices.forEach([&](const DeviceRecord &record) {
+        const auto connection = record.connection.lock();
+        if (connection)
+            result.insert(record.serial, connection->statistics());
+    });
+    return result;
+}
+
+QHash<QString, RoundTripTimes> DeviceManager::roundTripTimes() const
 {
+    QHash<QString, RoundTripTimes> result;
+    m_devices.forEach([&](const DeviceRecord &record) {
+        const auto connection = record.connection.lock();
+        if (connection)
+            result.insert(record.serial, connection->roundTripTimes());
+    });
+    return result;
+}
 
+bool DeviceManager::isReady() const
+{
+    return m_ready;
 }
 
-std::vector<DeviceInformation> DeviceManager::listDevices()
+void DeviceManager::setMaxParallelBringUps(int maxParallel)
 {
-    return m_deviceInfos;
+    m_bringUps.setMaxParallel(maxParallel);
+}
+
+void DeviceManager::setConnectionIdleTimeout(int timeout)
+{
+    m_pool.setIdleTimeout(timeout);
+}
+
+void DeviceManager::setHeartbeatInterval(int interval)
+{
+    m_pool.setHeartbeatInterval(interval);
+}
+
+void DeviceManager::setDeviceEnumerator(std::unique_ptr<DeviceEnumerator> enumerator)
+{
+    m_deviceEnumerator = std::move(enumerator);
+}
+
+void DeviceManager::setTransportFactory(TransportFactory factory)
+{
+    m_pool.setTransportFactory(std::move(factory));
 }
 
 void DeviceManager::start()
 {
-    connect(&m_deviceEnumerator, &UsbDeviceEnumerator::devicePluggedIn, this, &DeviceManager::handlePluggedInDevice);
-    connect(&m_deviceEnumerator, &UsbDeviceEnumerator::deviceUnplugged, this, &DeviceManager::handleUnpluggedDevice);
-    m_deviceEnumerator.startMonitoring();
+    connect(m_deviceEnumerator.get(), &DeviceEnumerator::devicePluggedIn, this, &DeviceManager::handlePluggedInDevice);
+    connect(m_deviceEnumerator.get(), &DeviceEnumerator::deviceUnplugged, this, &DeviceManager::handleUnpluggedDevice);
+
+    // Before the enumeration, which starts configuring the devices
+    m_addressMonitor.start();
+
+    // The first enumeration is synchronous, so the devices that are already
+    // plugged in are known when it returns
+    m_starting = true;
+    m_deviceEnumerator->startMonitoring();
+    m_starting = false;
+
+    qCDebug(devicesC) << "Found" << m_startingDevices.size() << "devices at startup";
+    if (m_startingDevices.isEmpty())
+        finishStartup();
+    else
+        QTimer::singleShot(startupTimeout, this, &DeviceManager::finishStartup);
 }
 
 void DeviceManager::handleDeviceConfigured(UsbDevice device, bool success)
@@ -64,103 +177,353 @@ void DeviceManager::handleDeviceConfigured(UsbDevice device, bool success)
         fetchDeviceInformation(device);
     } else {
         qCWarning(devicesC) << "Failed to configure device" << device.serial;
+        m_bringUps.finish(device.serial, false);
+        finishDeviceStartup(device.serial);
         // Discard the device
     }
 }
 
 void DeviceManager::handleDeviceInformation(UsbDevice device, DeviceInformationFetcher::Info info)
 {
+    finishDeviceStartup(device.serial);
+
+    DeviceRecord *record = m_devices.find(device.serial);
+    if (!record || !record->pluggedIn) {
+        qCDebug(devicesC) << "Ignoring information of unplugged device" << device.serial;
+        // Unplugging cancelled the bring-up already, unless the record was lost
+        m_bringUps.finish(device.serial, false);
+        return;
+    }
+
     if (info.hostMac.isEmpty()) {
         qCWarning(devicesC) << "Could not fetch device information from" << device.serial;
+        m_bringUps.finish(device.serial, false);
         return; // Discard the device
     }
 
-    if (info.ipAddress.isEmpty()) {
+    // The notifications of the device are newer than any fetched address
+    if (record->addressPushed && record->published)
+        info.ipAddress = record->info.ipAddress;
+
+    if (info.updateFollows)
+        m_bringUps.markConfigured(device.serial);
+    else
+        m_bringUps.finish(device.serial, true);
+
+    if (info.ipAddress.isEmpty() && info.updateFollows) {
+        qCDebug(devicesC) << "Waiting for" << info.serial << "to send its IP address";
+        record->state = DeviceState::BringingUp;
+    } else if (info.ipAddress.isEmpty()) {
+        // Older devices do not send updates, so ask them again later
         qCDebug(devicesC) << "Incomplete information received for" << info.serial;
-        m_incompleteDevices.enqueue(device);
-        QTimer::singleShot(1000, this, &DeviceManager::fetchIncomplete);
+        record->state = DeviceState::Incomplete;
+        if (!record->addressPushed)
+            pollIncomplete(device.serial);
     } else {
         qCDebug(devicesC) << "Complete info received for" << info.serial;
+        record->state = DeviceState::Ready;
     }
 
-    auto iter = std::find_if(m_deviceInfos.begin(), m_deviceInfos.end(),
-                             [&](const DeviceInformation &oldInfo) {
-                                 return info.serial == oldInfo.serial;
-                             });
-    if (iter == m_deviceInfos.end()) {
+    // Refetched information comes without the reservation made by the configuration
+    if (device.reservation)
+        record->info.reservation = device.reservation;
+    record->info.usbAddress = device.address;
+
+    if (!record->published) {
         qCDebug(devicesC) << "Added new info for" << info.serial;
-        DeviceInformation newInfo{info.serial, info.hostMac, info.ipAddress, device.address,
-                                  device.reservation};
-        m_deviceInfos.push_back(newInfo);
-        emit newDeviceInfo(newInfo);
-    } else if (iter->hostMac != info.hostMac || iter->ipAddress != info.ipAddress) {
-        // Serial is the same, since we found iter based on it
-        iter->hostMac = info.hostMac;
-        iter->ipAddress = info.ipAddress;
+        record->info.serial = info.serial;
+        record->info.hostMac = info.hostMac;
+        record->info.ipAddress = info.ipAddress;
+        m_devices.setPublished(record, true);
+        emit newDeviceInfo(record->info);
+    } else if (record->info.hostMac != info.hostMac || record->info.ipAddress != info.ipAddress) {
+        record->info.hostMac = info.hostMac;
+        record->info.ipAddress = info.ipAddress;
         qCDebug(devicesC) << "Replaced old info for" << info.serial;
-        emit newDeviceInfo(*iter);
+        m_devices.publish();
+        emit newDeviceInfo(record->info);
     }
+
+    if (record->watcherId == 0)
+        watchDevice(record);
+}
+
+void DeviceManager::handleAddressChanged(QString serial, quint32 watcherId, QString ipAddress,
+                                         bool follows)
+{
+    DeviceRecord *record = m_devices.find(serial);
+    if (!record || !record->pluggedIn || record->watcherId != watcherId)
+        return;
+
+    record->addressPushed = follows;
+    if (!record->published || record->info.ipAddress == ipAddress)
+        return;
+
+    qCDebug(devicesC) << "Device" << serial << "changed its IP address to" << ipAddress;
+    record->info.ipAddress = ipAddress;
+    record->state = ipAddress.isEmpty() ? DeviceState::BringingUp : DeviceState::Ready;
+    m_devices.publish();
+    emit newDeviceInfo(record->info);
+}
+
+void DeviceManager::handleWatcherFinished(QString serial, quint32 watcherId)
+{
+    DeviceRecord *record = m_devices.find(serial);
+    if (!record || record->watcherId != watcherId)
+        return;
+
+    record->watcherId = 0;
+    const bool wasPushed = record->addressPushed;
+    record->addressPushed = false;
+    // Polling stopped while the device pushed its address
+    if (wasPushed && record->pluggedIn && record->state == DeviceState::Incomplete)
+        pollIncomplete(serial);
 }
 
 void DeviceManager::handlePluggedInDevice(UsbDevice device)
 {
     qCDebug(devicesC) << "Device" << device.serial << "plugged in at" << device.address.busNumber << ":" << device.address.deviceAddress;
-    configureDevice(device);
+    DeviceRecord &record = m_devices.plugIn(device);
+    if (record.state != DeviceState::Suspended)
+        record.state = DeviceState::BringingUp;
+    if (m_starting)
+        m_startingDevices.insert(device.serial);
+    m_bringUps.schedule(device);
+}
+
+void DeviceManager::startBringUp(const UsbDevice &device)
+{
+    const DeviceRecord *record = m_devices.find(device.serial);
+    if (record && record->state == DeviceState::Suspended)
+        resumeDevice(device);
+    else
+        bootstrapDevice(device);
 }
 
 void DeviceManager::handleUnpluggedDevice(UsbAddress address)
 {
     qCDebug(devicesC) << "Device unplugged from" << address.busNumber << ":" << address.deviceAddress;
 
-    auto deviceAddressMatches = [&](const UsbDevice &device) {
-        return device.address == address;
-    };
+    DeviceRecord *record = m_devices.findByAddress(address);
+    if (!record)
+        return;
+
+    const QString serial = record->serial;
+    const auto connection = record->connection.lock();
+    const int devicePeriod = connection ? connection->resumeGracePeriod() : -1;
+    record->resumeGracePeriod = devicePeriod >= 0 ? devicePeriod : defaultResumeGracePeriod;
+    m_bringUps.cancel(serial);
+    finishDeviceStartup(serial);
+    m_pool.release(serial);
+
+    const bool wasPublished = record->published;
+    if (record->info.ipAddress.isEmpty()) {
+        m_devices.remove(serial);
+    } else {
+        // Keeps the subnet reserved in case the device comes back soon
+        record->state = DeviceState::Suspended;
+        record->watcherId = 0;
+        record->addressPushed = false;
+        m_devices.unplug(record);
+        m_devices.setPublished(record, false);
+        QTimer::singleShot(record->resumeGracePeriod, Qt::PreciseTimer, this, [this, serial]() {
+            expireSuspendedDevice(serial);
+        });
+    }
+
+    if (wasPublished)
+        emit disconnectedDevice(serial);
+}
+
+void DeviceManager::expireSuspendedDevice(const QString &serial)
+{
+    const DeviceRecord *record = m_devices.find(serial);
+    // A replugged device stays suspended while its bring-up waits for a slot,
+    // and one that was replugged and unplugged again has a later timer
+    if (!record || record->pluggedIn || record->state != DeviceState::Suspended
+            || record->unpluggedTime.elapsed() < record->resumeGracePeriod)
+        return;
 
-    const auto incompleteIter = std::find_if(m_incompleteDevices.begin(), m_incompleteDevices.end(),
-                                             deviceAddressMatches);
-    if (incompleteIter != m_incompleteDevices.end()) {
-        m_incompleteDevices.erase(incompleteIter);
-        // Incomplete devices already have information stored about them, so continue.
+    qCDebug(devicesC) << "Device" << serial << "did not come back in time to resume";
+    m_pool.forgetSession(serial);
+    m_devices.remove(serial);
+}
+
+void DeviceManager::resumeDevice(UsbDevice device)
+{
+    qCDebug(devicesC) << "Trying to resume the session of device" << device.serial;
+    DeviceRecord *record = m_devices.find(device.serial);
+    if (!record) {
+        qCWarning(devicesC) << "Device" << device.serial << "to resume is no longer known";
+        m_bringUps.finish(device.serial, false);
+        finishDeviceStartup(device.serial);
+        return;
     }
 
-    const auto infoIter = std::find_if(m_deviceInfos.begin(), m_deviceInfos.end(),
-                                       [&](const DeviceInformation &info) {
-                                           return info.usbAddress == address;
-                                       });
-    if (infoIter != m_deviceInfos.end()) {
-        emit disconnectedDevice(infoIter->serial);
-        m_deviceInfos.erase(infoIter);
+    bool created = false;
+    auto connection = deviceConnection(device, [&](Connection *newConnection) {
+        created = true;
+        connect(newConnection, &Connection::resumed, this, [=]() {
+            finishResume(device, true);
+        });
+        connect(newConnection, &Connection::connected, this, [=]() {
+            finishResume(device, false);
+        });
+        connect(newConnection, &Connection::disconnected, this, [=]() {
+            finishResume(device, false);
+        });
+    });
+
+    if (!created) {
+        // An existing connection won't report a resumed session
+        record->info = DeviceInformation{};
+        record->state = DeviceState::BringingUp;
+        bootstrapDevice(device);
+        return;
     }
+    record->state = DeviceState::Resuming;
+    record->resumingConnection = connection;
+}
+
+void DeviceManager::finishResume(UsbDevice device, bool resumed)
+{
+    DeviceRecord *record = m_devices.find(device.serial);
+    if (!record || !record->resumingConnection)
+        return; // Another notification from the connection was already handled
+    const auto connection = std::move(record->resumingConnection);
+    QObject::disconnect(connection.get(), nullptr, this, nullptr);
+
+    if (!record->pluggedIn)
+        return; // Unplugged again while resuming, the bring-up was cancelled
+
+    if (!resumed) {
+        qCDebug(devicesC) << "Could not resume the session of device" << device.serial;
+        record->info = DeviceInformation{}; // Release the subnet for the configuration
+        record->state = DeviceState::BringingUp;
+        bootstrapDevice(device);
+        return;
+    }
+
+    qCDebug(devicesC) << "Resumed the session of device" << device.serial;
+    m_bringUps.finish(device.serial, true);
+    record->state = DeviceState::Ready;
+    record->info.usbAddress = device.address;
+    m_devices.setPublished(record, true);
+    emit newDeviceInfo(record->info);
+    watchDevice(record);
+}
+
+void DeviceManager::bootstrapDevice(UsbDevice device)
+{
+    qCDebug(devicesC) << "Bootstrapping device" << device.serial;
+    const auto connection = deviceConnection(device);
+    auto *bootstrapper = new DeviceBootstrapper{connection, device};
+    connect(bootstrapper, &DeviceBootstrapper::finished, bootstrapper, &QObject::deleteLater);
+    connect(bootstrapper, &DeviceBootstrapper::fetched, this, &DeviceManager::handleDeviceInformation);
+    connect(bootstrapper, &DeviceBootstrapper::failed, this, [this](UsbDevice failedDevice) {
+        handleDeviceConfigured(failedDevice, false);
+    });
+    connect(bootstrapper, &DeviceBootstrapper::unsupported, this, &DeviceManager::configureDevice);
+
+    // Services of the device run in the thread of its connection
+    if (connection)
+        bootstrapper->moveToThread(connection->thread());
+    QMetaObject::invokeMethod(bootstrapper, &DeviceBootstrapper::bootstrap, Qt::QueuedConnection);
 }
 
 void DeviceManager::configureDevice(UsbDevice device)
 {
     qCDebug(devicesC) << "Configuring device" << device.serial;
-    auto *configurator = new NetworkConfigurator{&m_pool, device};
+    const auto connection = deviceConnection(device);
+    auto *configurator = new NetworkConfigurator{connection, device};
     connect(configurator, &NetworkConfigurator::configured, configurator, &QObject::deleteLater);
     connect(configurator, &NetworkConfigurator::configured,
             this, &DeviceManager::handleDeviceConfigured);
 
-    configurator->configure();
+    // Services of the device run in the thread of its connection
+    if (connection)
+        configurator->moveToThread(connection->thread());
+    QMetaObject::invokeMethod(configurator, &NetworkConfigurator::configure, Qt::QueuedConnection);
 }
 
 void DeviceManager::fetchDeviceInformation(UsbDevice device)
 {
     qCDebug(devicesC) << "Fetching device information for" << device.serial;
-    auto *fetcher = new DeviceInformationFetcher{m_pool.connect(device), device};
-    connect(fetcher, &DeviceInformationFetcher::fetched, fetcher, &QObject::deleteLater);
+    const auto connection = deviceConnection(device);
+    auto *fetcher = new DeviceInformationFetcher{connection, device};
+    connect(fetcher, &DeviceInformationFetcher::finished, fetcher, &QObject::deleteLater);
     connect(fetcher, &DeviceInformationFetcher::fetched, this, &DeviceManager::handleDeviceInformation);
 
-    fetcher->fetch();
+    if (connection)
+        fetcher->moveToThread(connection->thread());
+    QMetaObject::invokeMethod(fetcher, &DeviceInformationFetcher::fetch, Qt::QueuedConnection);
 }
 
-void DeviceManager::fetchIncomplete()
+void DeviceManager::pollIncomplete(const QString &serial)
 {
-    if (m_incompleteDevices.empty())
+    QTimer::singleShot(incompletePollInterval, this, [this, serial]() {
+        fetchIncomplete(serial);
+    });
+}
+
+void DeviceManager::fetchIncomplete(const QString &serial)
+{
+    const DeviceRecord *record = m_devices.find(serial);
+    if (!record || !record->pluggedIn || record->state != DeviceState::Incomplete
+            || record->addressPushed)
         return;
 
-    fetchDeviceInformation(m_incompleteDevices.dequeue());
+    fetchDeviceInformation(record->usbDevice);
 }
 
+void DeviceManager::watchDevice(DeviceRecord *record)
+{
+    const auto connection = deviceConnection(record->usbDevice);
+    if (!connection)
+        return;
+    // Older devices do not know the service and would leave the stream hanging
+    if (!connection->hasCapability(NotificationCapability)) {
+        qCDebug(devicesC) << "Device" << record->serial << "does not push notifications";
+        return;
+    }
 
+    record->watcherId = m_nextWatcherId++;
+    auto *watcher = new DeviceWatcher{connection, record->serial, record->watcherId};
+    connect(watcher, &DeviceWatcher::finished, watcher, &QObject::deleteLater);
+    connect(watcher, &DeviceWatcher::addressChanged, this, &DeviceManager::handleAddressChanged);
+    connect(watcher, &DeviceWatcher::finished, this, &DeviceManager::handleWatcherFinished);
 
+    watcher->moveToThread(connection->thread());
+    QMetaObject::invokeMethod(watcher, &DeviceWatcher::watch, Qt::QueuedConnection);
+}
+
+std::shared_ptr<Connection> DeviceManager::deviceConnection(const UsbDevice &device,
+                                                            ConnectionSetup setup)
+{
+    auto connection = m_pool.connect(device, setup);
+    DeviceRecord *record = m_devices.find(device.serial);
+    if (record)
+        record->connection = connection;
+    return connection;
+}
+
+void DeviceManager::finishDeviceStartup(const QString &serial)
+{
+    if (m_startingDevices.remove(serial) && m_startingDevices.isEmpty())
+        finishStartup();
+}
+
+void DeviceManager::finishStartup()
+{
+    if (m_ready)
+        return;
+
+    if (!m_startingDevices.isEmpty()) {
+        qCWarning(devicesC) << "Devices" << m_startingDevices.values()
+                            << "were not brought up in time, continuing without them";
+        m_startingDevices.clear();
+    }
+    qCDebug(devicesC) << "Device manager is ready";
+    m_ready = true;
+    emit ready();
+}
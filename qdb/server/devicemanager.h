@@ -29,21 +29,21 @@
 #ifndef DEVICEMANAGER_H
 #define DEVICEMANAGER_H
 
+#include "bringupscheduler.h"
 #include "connectionpool.h"
+#include "deviceenumerator.h"
 #include "deviceinformationfetcher.h"
-#include "usb-host/usbdeviceenumerator.h"
+#include "deviceregistry.h"
+#include "devicesnapshot.h"
+#include "hostaddressmonitor.h"
+#include "rttestimator.h"
+#include "trafficscheduler.h"
 
+#include <QtCore/qhash.h>
 #include <QtCore/qobject.h>
-#include <QtCore/qqueue.h>
+#include <QtCore/qset.h>
 
-struct DeviceInformation
-{
-    QString serial;
-    QString hostMac;
-    QString ipAddress;
-    UsbAddress usbAddress;
-    SubnetReservation reservation;
-};
+#include <memory>
 
 class DeviceManager : public QObject
 {
@@ -51,10 +51,33 @@ class DeviceManager : public QObject
 public:
     explicit DeviceManager(QObject *parent = nullptr);
 
-    std::vector<DeviceInformation> listDevices();
+    //! The current state of the devices, which can be kept without copying
+    DeviceSnapshotPtr snapshot() const;
+    //! Whether the devices present at startup have been brought up
+    bool isReady() const;
+    //! Connection to a plugged in device, nullptr if there is no such device
+    std::shared_ptr<Connection> connectToDevice(const QString &serial);
+    //! Traffic class of the streams of a client, weight 1 without a rate limit by default
+    TrafficClass trafficClass(const QString &client) const;
+    void setTrafficClass(const QString &client, const TrafficClass &trafficClass);
+    //! Statistics of the streams of each connected device, by serial
+    QHash<QString, std::vector<StreamStatistics>> trafficStatistics() const;
+    //! Round trip times of each connected device, by serial
+    QHash<QString, RoundTripTimes> roundTripTimes() const;
+    //! How many devices are configured at the same time
+    void setMaxParallelBringUps(int maxParallel);
+    //! Idle time in ms after which unused device connections are closed, 0 keeps them open
+    void setConnectionIdleTimeout(int timeout);
+    //! Heartbeat interval in ms of device connections, 0 disables heartbeats
+    void setHeartbeatInterval(int interval);
+    //! Finds the devices instead of enumerating USB, must be set before start()
+    void setDeviceEnumerator(std::unique_ptr<DeviceEnumerator> enumerator);
+    //! Creates the transports of new connections instead of opening the USB device
+    void setTransportFactory(TransportFactory factory);
     void start();
 
 signals:
+    void ready();
     void newDeviceInfo(DeviceInformation info);
     void disconnectedDevice(QString serial);
 
@@ -63,16 +86,39 @@ private slots:
     void handleDeviceInformation(UsbDevice device, DeviceInformationFetcher::Info info);
     void handlePluggedInDevice(UsbDevice device);
     void handleUnpluggedDevice(UsbAddress address);
+    void handleAddressChanged(QString serial, quint32 watcherId, QString ipAddress, bool follows);
+    void handleWatcherFinished(QString serial, quint32 watcherId);
+    void finishStartup();
 
 private:
+    void startBringUp(const UsbDevice &device);
+    void resumeDevice(UsbDevice device);
+    void finishResume(UsbDevice device, bool resumed);
+    void bootstrapDevice(UsbDevice device);
+    //! Configuration for devices without the bootstrap service
     void configureDevice(UsbDevice device);
     void fetchDeviceInformation(UsbDevice device);
-    void fetchIncomplete();
+    void fetchIncomplete(const QString &serial);
+    void pollIncomplete(const QString &serial);
+    //! Open the notification stream of a device that is up
+    void watchDevice(DeviceRecord *record);
+    void expireSuspendedDevice(const QString &serial);
+    //! Connection from the pool, remembered in the record of the device
+    std::shared_ptr<Connection> deviceConnection(const UsbDevice &device,
+                                                 ConnectionSetup setup = ConnectionSetup{});
+    void finishDeviceStartup(const QString &serial);
 
-    UsbDeviceEnumerator m_deviceEnumerator;
-    QQueue<UsbDevice> m_incompleteDevices;
-    std::vector<DeviceInformation> m_deviceInfos;
+    HostAddressMonitor m_addressMonitor;
+    std::unique_ptr<DeviceEnumerator> m_deviceEnumerator;
+    DeviceRegistry m_devices;
     ConnectionPool m_pool;
+    QHash<QString, TrafficClass> m_trafficClasses;
+    BringUpScheduler m_bringUps;
+    quint32 m_nextWatcherId;
+    // Devices found at startup whose bring-up is still in progress
+    QSet<QString> m_startingDevices;
+    bool m_starting;
+    bool m_ready;
 };
 
 #endif // DEVICEMANAGER_H
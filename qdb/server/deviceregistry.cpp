@@ -0,0 +1,152 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Debug Bridge.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+#include "deviceregistry.h"
+
+#include <algorithm>
+
+namespace {
+
+quint16 addressKey(const UsbAddress &address)
+{
+    return static_cast<quint16>(address.busNumber << 8 | address.deviceAddress);
+}
+
+} // anonymous namespace
+
+DeviceRegistry::DeviceRegistry()
+    : m_records{},
+      m_serialsByAddress{},
+      m_nextOrder{0},
+      m_snapshotLock{},
+      m_snapshot{std::make_shared<DeviceSnapshot>()}
+{
+
+}
+
+DeviceRecord *DeviceRegistry::find(const QString &serial)
+{
+    const auto iter = m_records.find(serial);
+    return iter == m_records.end() ? nullptr : &iter->second;
+}
+
+DeviceRecord *DeviceRegistry::findByAddress(const UsbAddress &address)
+{
+    const auto iter = m_serialsByAddress.constFind(addressKey(address));
+    return iter == m_serialsByAddress.constEnd() ? nullptr : find(iter.value());
+}
+
+DeviceRecord &DeviceRegistry::plugIn(const UsbDevice &device)
+{
+    DeviceRecord &record = m_records[device.serial];
+    if (record.pluggedIn)
+        m_serialsByAddress.remove(addressKey(record.usbDevice.address));
+
+    record.serial = device.serial;
+    record.usbDevice = device;
+    record.pluggedIn = true;
+    m_serialsByAddress.insert(addressKey(device.address), device.serial);
+    return record;
+}
+
+void DeviceRegistry::unplug(DeviceRecord *record)
+{
+    if (!record->pluggedIn)
+        return;
+    m_serialsByAddress.remove(addressKey(record->usbDevice.address));
+    record->pluggedIn = false;
+    // The libusb device is released, the serial and address stay for logging
+    record->usbDevice.usbDevice = LibUsbDevice{};
+    record->unpluggedTime.start();
+}
+
+void DeviceRegistry::remove(const QString &serial)
+{
+    const auto iter = m_records.find(serial);
+    if (iter == m_records.end())
+        return;
+
+    unplug(&iter->second);
+    const bool published = iter->second.published;
+    m_records.erase(iter);
+    if (published)
+        publish();
+}
+
+void DeviceRegistry::forEach(const std::function<void(DeviceRecord &)> &function)
+{
+    for (auto &pair : m_records)
+        function(pair.second);
+}
+
+void DeviceRegistry::forEach(const std::function<void(const DeviceRecord &)> &function) const
+{
+    for (const auto &pair : m_records)
+        function(pair.second);
+}
+
+void DeviceRegistry::setPublished(DeviceRecord *record, bool published)
+{
+    if (record->published == published)
+        return;
+    record->published = published;
+    if (published)
+        record->order = m_nextOrder++;
+    publish();
+}
+
+void DeviceRegistry::publish()
+{
+    // Devices are listed in the order they came up
+    std::vector<const DeviceRecord *> records;
+    for (const auto &pair : m_records) {
+        if (pair.second.published)
+            records.push_back(&pair.second);
+    }
+    std::sort(records.begin(), records.end(), [](const DeviceRecord *lhs, const DeviceRecord *rhs) {
+        return lhs->order < rhs->order;
+    });
+
+    std::vector<DeviceInformation> devices;
+    devices.reserve(records.size());
+    for (const DeviceRecord *record : records)
+        devices.push_back(record->info);
+
+    // Only this thread replaces the snapshot, so reading it needs no lock
+    DeviceSnapshotPtr snapshot
+            = std::make_shared<DeviceSnapshot>(m_snapshot->version() + 1, devices);
+    // The previous snapshot is released after unlocking
+    QMutexLocker locker{&m_snapshotLock};
+    m_snapshot.swap(snapshot);
+}
+
+DeviceSnapshotPtr DeviceRegistry::snapshot() const
+{
+    QMutexLocker locker{&m_snapshotLock};
+    return m_snapshot;
+}
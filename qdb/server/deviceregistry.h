@@ -0,0 +1,111 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Debug Bridge.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+#ifndef DEVICEREGISTRY_H
+#define DEVICEREGISTRY_H
+
+#include "devicesnapshot.h"
+#include "usb-host/usbdevice.h"
+
+#include <QtCore/qelapsedtimer.h>
+#include <QtCore/qhash.h>
+#include <QtCore/qmutex.h>
+#include <QtCore/qstring.h>
+
+#include <functional>
+#include <memory>
+#include <unordered_map>
+
+class Connection;
+
+enum class DeviceState
+{
+    BringingUp, // Being configured or waiting for its IP address
+    Incomplete, // Up, but polled for the IP address it does not push
+    Ready,
+    Suspended,  // Unplugged, but its session and subnet are kept for a while
+    Resuming,
+};
+
+// Everything the host server knows about one device
+struct DeviceRecord
+{
+    QString serial;
+    DeviceState state = DeviceState::BringingUp;
+    bool pluggedIn = false;
+    UsbDevice usbDevice;
+    //! Identity and subnet, kept while suspended
+    DeviceInformation info;
+    //! Whether the device is listed in snapshots
+    bool published = false;
+    quint64 order = 0;
+    std::weak_ptr<Connection> connection;
+    std::shared_ptr<Connection> resumingConnection;
+    //! DeviceWatcher following the notifications of the device, 0 if there is none
+    quint32 watcherId = 0;
+    //! Whether the device pushes changes of its IP address, so it is not polled
+    bool addressPushed = false;
+    QElapsedTimer unpluggedTime;
+    //! How long in ms the device keeps its network configuration after being unplugged
+    int resumeGracePeriod = 0;
+};
+
+// The devices of DeviceManager, indexed by serial and by USB address. Only
+// the snapshots may be used outside of the thread of the DeviceManager.
+class DeviceRegistry
+{
+public:
+    DeviceRegistry();
+
+    DeviceRecord *find(const QString &serial);
+    //! Plugged in device at the address, nullptr if there is none
+    DeviceRecord *findByAddress(const UsbAddress &address);
+    //! Record of the device, created if the device is new
+    DeviceRecord &plugIn(const UsbDevice &device);
+    void unplug(DeviceRecord *record);
+    void remove(const QString &serial);
+    void forEach(const std::function<void(DeviceRecord &)> &function);
+    void forEach(const std::function<void(const DeviceRecord &)> &function) const;
+
+    //! List the device in snapshots or stop listing it, and publish a snapshot
+    void setPublished(DeviceRecord *record, bool published);
+    //! Publish a snapshot after changing the information of a published device
+    void publish();
+    //! Safe to call from any thread
+    DeviceSnapshotPtr snapshot() const;
+
+private:
+    std::unordered_map<QString, DeviceRecord> m_records;
+    QHash<quint16, QString> m_serialsByAddress;
+    quint64 m_nextOrder;
+    // Guards only the pointer, which other threads copy while it is replaced
+    mutable QMutex m_snapshotLock;
+    DeviceSnapshotPtr m_snapshot;
+};
+
+#endif // DEVICEREGISTRY_H
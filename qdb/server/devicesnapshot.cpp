@@ -0,0 +1,130 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Debug Bridge.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+#include "devicesnapshot.h"
+
+#include <QtCore/qcborarray.h>
+
+namespace {
+
+QCborMap createDevicesResponse(quint64 version, const std::vector<DeviceInformation> &devices)
+{
+    QCborArray infoArray;
+    for (const auto &deviceInfo : devices)
+        infoArray << deviceInformationToCborMap(deviceInfo);
+
+    QCborMap response = initializeResponse(ResponseType::Devices);
+    response[QStringLiteral("devices")] = infoArray;
+    response[QStringLiteral("version")] = static_cast<qint64>(version);
+    return response;
+}
+
+} // anonymous namespace
+
+QCborMap deviceInformationToCborMap(const DeviceInformation &deviceInfo)
+{
+    QCborMap info;
+    info[QStringLiteral("serial")] = deviceInfo.serial;
+    info[QStringLiteral("hostMac")] = deviceInfo.hostMac;
+    info[QStringLiteral("ipAddress")] = deviceInfo.ipAddress;
+    return info;
+}
+
+QCborMap newDeviceResponse(const DeviceInformation &deviceInfo)
+{
+    QCborMap response = initializeResponse(ResponseType::NewDevice);
+    response[QStringLiteral("device")] = deviceInformationToCborMap(deviceInfo);
+    return response;
+}
+
+QCborMap disconnectedDeviceResponse(const QString &serial)
+{
+    QCborMap response = initializeResponse(ResponseType::DisconnectedDevice);
+    response[QStringLiteral("serial")] = serial;
+    return response;
+}
+
+SerialisedMessage::SerialisedMessage(const QCborMap &message)
+    : m_message{message},
+      m_json{serialiseMessage(message, HostMessageFraming::JsonLines)},
+      m_cbor{serialiseMessage(message, HostMessageFraming::Cbor)}
+{
+
+}
+
+const QCborMap &SerialisedMessage::message() const
+{
+    return m_message;
+}
+
+QByteArray SerialisedMessage::bytes(HostMessageFraming framing, const QJsonValue &requestId) const
+{
+    if (requestId.isUndefined() || requestId.isNull())
+        return framing == HostMessageFraming::Cbor ? m_cbor : m_json;
+
+    QCborMap message = m_message;
+    setRequestId(message, requestId);
+    return serialiseMessage(message, framing);
+}
+
+DeviceSnapshot::DeviceSnapshot()
+    : DeviceSnapshot{0, std::vector<DeviceInformation>{}}
+{
+
+}
+
+DeviceSnapshot::DeviceSnapshot(quint64 version, const std::vector<DeviceInformation> &devices)
+    : m_version{version},
+      m_devices{devices},
+      m_devicesResponse{createDevicesResponse(version, devices)},
+      m_newDeviceEvents{}
+{
+    m_newDeviceEvents.reserve(devices.size());
+    for (const auto &deviceInfo : devices)
+        m_newDeviceEvents.emplace_back(newDeviceResponse(deviceInfo));
+}
+
+quint64 DeviceSnapshot::version() const
+{
+    return m_version;
+}
+
+const std::vector<DeviceInformation> &DeviceSnapshot::devices() const
+{
+    return m_devices;
+}
+
+const SerialisedMessage &DeviceSnapshot::devicesResponse() const
+{
+    return m_devicesResponse;
+}
+
+const std::vector<SerialisedMessage> &DeviceSnapshot::newDeviceEvents() const
+{
+    return m_newDeviceEvents;
+}
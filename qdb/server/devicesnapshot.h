@@ -0,0 +1,97 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Debug Bridge.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+#ifndef DEVICESNAPSHOT_H
+#define DEVICESNAPSHOT_H
+
+#include "hostmessages.h"
+#include "subnet.h"
+#include "usb-host/usbdevice.h"
+
+#include <QtCore/qbytearray.h>
+#include <QtCore/qcbormap.h>
+#include <QtCore/qstring.h>
+
+#include <memory>
+#include <vector>
+
+struct DeviceInformation
+{
+    QString serial;
+    QString hostMac;
+    QString ipAddress;
+    UsbAddress usbAddress;
+    SubnetReservation reservation;
+};
+
+QCborMap deviceInformationToCborMap(const DeviceInformation &deviceInfo);
+QCborMap newDeviceResponse(const DeviceInformation &deviceInfo);
+QCborMap disconnectedDeviceResponse(const QString &serial);
+
+// Host message that is serialised once in every framing, so that it can be
+// written to any number of clients without encoding it again
+class SerialisedMessage
+{
+public:
+    explicit SerialisedMessage(const QCborMap &message);
+
+    const QCborMap &message() const;
+    //! Message tagged with the id of a request, only encoded again if there is an id
+    QByteArray bytes(HostMessageFraming framing, const QJsonValue &requestId) const;
+
+private:
+    QCborMap m_message;
+    QByteArray m_json;
+    QByteArray m_cbor;
+};
+
+// Immutable state of the devices known to the host server. A new snapshot with
+// a higher version is published whenever a device is added, changed or removed.
+class DeviceSnapshot
+{
+public:
+    DeviceSnapshot();
+    DeviceSnapshot(quint64 version, const std::vector<DeviceInformation> &devices);
+
+    quint64 version() const;
+    const std::vector<DeviceInformation> &devices() const;
+    //! Response to a request for the devices
+    const SerialisedMessage &devicesResponse() const;
+    //! An event about each device, for clients that start watching the devices
+    const std::vector<SerialisedMessage> &newDeviceEvents() const;
+
+private:
+    quint64 m_version;
+    std::vector<DeviceInformation> m_devices;
+    SerialisedMessage m_devicesResponse;
+    std::vector<SerialisedMessage> m_newDeviceEvents;
+};
+
+using DeviceSnapshotPtr = std::shared_ptr<const DeviceSnapshot>;
+
+#endif // DEVICESNAPSHOT_H
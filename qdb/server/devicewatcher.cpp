@@ -0,0 +1,78 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Debug Bridge.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+#include "devicewatcher.h"
+
+#include "connection.h"
+#include "notificationservice.h"
+
+#include <QtCore/qdebug.h>
+#include <QtCore/qloggingcategory.h>
+
+Q_LOGGING_CATEGORY(watcherC, "qdb.devices.watcher");
+
+DeviceWatcher::DeviceWatcher(std::shared_ptr<Connection> connection, const QString &serial,
+                             quint32 id)
+    : m_connection{connection},
+      m_serial{serial},
+      m_id{id},
+      m_service{nullptr}
+{
+
+}
+
+void DeviceWatcher::watch()
+{
+    if (!m_connection || m_connection->state() == ConnectionState::Disconnected) {
+        qCDebug(watcherC) << "Could not watch device" << m_serial << "due to no connection";
+        finish();
+        return;
+    }
+
+    m_service = new NotificationService{m_connection.get()};
+    connect(m_service, &NotificationService::addressChanged, this, &DeviceWatcher::handleAddressChanged);
+    connect(m_service, &NotificationService::closed, this, &DeviceWatcher::finish);
+    m_service->initialize();
+}
+
+void DeviceWatcher::handleAddressChanged(QString ipAddress, bool follows)
+{
+    qCDebug(watcherC) << "Device" << m_serial << "notified IP address" << ipAddress;
+    emit addressChanged(m_serial, m_id, ipAddress, follows);
+}
+
+void DeviceWatcher::finish()
+{
+    if (m_service) {
+        QObject::disconnect(m_service, nullptr, this, nullptr);
+        m_service->deleteLater();
+        m_service = nullptr;
+    }
+    qCDebug(watcherC) << "Stopped watching device" << m_serial;
+    emit finished(m_serial, m_id);
+}
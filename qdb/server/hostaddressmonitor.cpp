@@ -0,0 +1,136 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Debug Bridge.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+#include "hostaddressmonitor.h"
+
+#include "libqdb/make_unique.h"
+#include "subnet.h"
+
+#include <QtCore/qdebug.h>
+#include <QtCore/qloggingcategory.h>
+#include <QtCore/qsocketnotifier.h>
+
+#include <algorithm>
+
+Q_LOGGING_CATEGORY(addressMonitorC, "qdb.addressmonitor");
+
+HostAddressMonitor::HostAddressMonitor(QObject *parent)
+    : QObject{parent},
+#ifdef Q_OS_LINUX
+      m_monitor{},
+      m_addresses{},
+#endif
+      m_notifier{},
+      m_synchronized{false}
+{
+
+}
+
+HostAddressMonitor::~HostAddressMonitor()
+{
+    SubnetPool::instance()->clearUsedSubnets();
+}
+
+bool HostAddressMonitor::start()
+{
+#ifdef Q_OS_LINUX
+    // Subscribe before the initial dump so that no change can fall in between
+    if (!m_monitor.openAddressMonitor()) {
+        qCWarning(addressMonitorC) << "Could not follow host addresses, enumerating interfaces instead";
+        return false;
+    }
+    m_notifier = make_unique<QSocketNotifier>(m_monitor.descriptor(), QSocketNotifier::Read);
+    connect(m_notifier.get(), &QSocketNotifier::activated,
+            this, &HostAddressMonitor::handleAddressNotifications);
+
+    refresh();
+    return true;
+#else
+    return false;
+#endif
+}
+
+void HostAddressMonitor::handleAddressNotifications()
+{
+#ifdef Q_OS_LINUX
+    std::vector<InterfaceAddressChange> changes;
+    if (!m_monitor.readAddressChanges(&changes)) {
+        // Notifications were lost, start over from the current addresses
+        refresh();
+        return;
+    }
+    if (changes.empty())
+        return;
+
+    for (const auto &change : changes) {
+        const auto sameAddress = [&change](const InterfaceAddress &address) {
+            return address.interfaceIndex == change.address.interfaceIndex
+                    && address.address == change.address.address
+                    && address.prefixLength == change.address.prefixLength;
+        };
+        const auto iter = std::find_if(m_addresses.begin(), m_addresses.end(), sameAddress);
+        if (change.added && iter == m_addresses.end())
+            m_addresses.push_back(change.address);
+        else if (!change.added && iter != m_addresses.end())
+            m_addresses.erase(iter);
+    }
+    if (m_synchronized)
+        publish();
+#endif
+}
+
+void HostAddressMonitor::refresh()
+{
+#ifdef Q_OS_LINUX
+    RtNetlinkSocket netlink;
+    std::vector<InterfaceAddress> addresses;
+    if (!netlink.open() || !netlink.dumpAddresses(&addresses)) {
+        qCWarning(addressMonitorC) << "Could not query host addresses, enumerating interfaces instead";
+        m_addresses.clear();
+        m_synchronized = false;
+        SubnetPool::instance()->clearUsedSubnets();
+        return;
+    }
+    m_addresses.swap(addresses);
+    m_synchronized = true;
+    publish();
+#endif
+}
+
+void HostAddressMonitor::publish()
+{
+#ifdef Q_OS_LINUX
+    std::vector<Subnet> subnets;
+    subnets.reserve(m_addresses.size());
+    for (const auto &entry : m_addresses)
+        subnets.push_back(Subnet{entry.address, entry.prefixLength});
+
+    qCDebug(addressMonitorC) << "Host uses" << subnets.size() << "IPv4 addresses";
+    SubnetPool::instance()->setUsedSubnets(subnets);
+#endif
+}
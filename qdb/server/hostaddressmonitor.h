@@ -0,0 +1,72 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Debug Bridge.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+#ifndef HOSTADDRESSMONITOR_H
+#define HOSTADDRESSMONITOR_H
+
+#include <QtCore/qobject.h>
+
+#ifdef Q_OS_LINUX
+#include "libqdb/rtnetlink.h"
+#endif
+
+#include <memory>
+#include <vector>
+
+class QSocketNotifier;
+
+// Follows the addresses of the host's interfaces through rtnetlink and
+// publishes the subnets they use to the subnet pool, so that configuring a
+// device does not need to enumerate every interface.
+class HostAddressMonitor : public QObject
+{
+    Q_OBJECT
+public:
+    explicit HostAddressMonitor(QObject *parent = nullptr);
+    ~HostAddressMonitor();
+
+    //! Returns false if address changes can't be followed on this host
+    bool start();
+
+private slots:
+    void handleAddressNotifications();
+
+private:
+    void refresh();
+    void publish();
+
+#ifdef Q_OS_LINUX
+    RtNetlinkSocket m_monitor;
+    std::vector<InterfaceAddress> m_addresses;
+#endif
+    std::unique_ptr<QSocketNotifier> m_notifier;
+    // Whether m_addresses started from a full dump and can be published
+    bool m_synchronized;
+};
+
+#endif // HOSTADDRESSMONITOR_H
@@ -30,14 +30,21 @@
 
 #include "libqdb/interruptsignalhandler.h"
 #include "libqdb/qdbconstants.h"
+#include "libqdb/tracering.h"
 #include "logging.h"
+#include "subnet.h"
+#include "subnetcache.h"
+#include "tracedump.h"
 
 #include <QtCore/qcommandlineparser.h>
 #include <QtCore/qdir.h>
 #include <QtCore/qfile.h>
+#include <QtCore/qfileinfo.h>
 #include <QtCore/qloggingcategory.h>
 #include <QtNetwork/qlocalsocket.h>
 
+#include <limits>
+
 Q_LOGGING_CATEGORY(hostServerC, "qdb.hostserver");
 
 int execHostServer(const QCoreApplication &app, const QCommandLineParser &parser)
@@ -51,8 +58,62 @@ int execHostServer(const QCoreApplication &app, const QCommandLineParser &parser
         filterRules.append("qdb.connection.debug=false\n");
     QLoggingCategory::setFilterRules(filterRules);
 
+    if (parser.isSet("subnet-range")) {
+        std::vector<SubnetRange> ranges;
+        for (const QString &value : parser.values("subnet-range")) {
+            SubnetRange range;
+            if (!parseSubnetRange(value, &range)) {
+                qCCritical(hostServerC) << "Invalid subnet range" << value
+                                        << "expected an IPv4 network from /8 to /30";
+                return 1;
+            }
+            ranges.push_back(range);
+        }
+        if (!SubnetPool::instance()->setRanges(ranges)) {
+            qCCritical(hostServerC) << "Subnet ranges overlap each other:" << parser.values("subnet-range");
+            return 1;
+        }
+    }
+
+    SubnetCache::instance()->load(subnetCacheFilePath());
+
+    const QString tracePath = traceFilePath();
+    QDir{}.mkpath(QFileInfo{tracePath}.path());
+    if (!TraceRing::open(tracePath))
+        qCWarning(hostServerC) << "Could not open trace ring" << tracePath;
+
     InterruptSignalHandler signalHandler;
     HostServer hostServer;
+    if (parser.isSet("max-parallel-bringups")) {
+        bool ok = false;
+        const int maxParallel = parser.value("max-parallel-bringups").toInt(&ok);
+        if (!ok || maxParallel < 1) {
+            qCCritical(hostServerC) << "Invalid number of parallel bring-ups"
+                                    << parser.value("max-parallel-bringups");
+            return 1;
+        }
+        hostServer.setMaxParallelBringUps(maxParallel);
+    }
+    if (parser.isSet("connection-idle-timeout")) {
+        bool ok = false;
+        const int seconds = parser.value("connection-idle-timeout").toInt(&ok);
+        if (!ok || seconds < 0 || seconds > std::numeric_limits<int>::max() / 1000) {
+            qCCritical(hostServerC) << "Invalid connection idle timeout"
+                                    << parser.value("connection-idle-timeout");
+            return 1;
+        }
+        hostServer.setConnectionIdleTimeout(seconds * 1000);
+    }
+    if (parser.isSet("heartbeat-interval")) {
+        bool ok = false;
+        const int interval = parser.value("heartbeat-interval").toInt(&ok);
+        if (!ok || interval < 0) {
+            qCCritical(hostServerC) << "Invalid heartbeat interval"
+                                    << parser.value("heartbeat-interval");
+            return 1;
+        }
+        hostServer.setHeartbeatInterval(interval);
+    }
     QObject::connect(&signalHandler, &InterruptSignalHandler::interrupted, &hostServer, &HostServer::close);
     QObject::connect(&hostServer, &HostServer::closed, &app, &QCoreApplication::quit);
     QTimer::singleShot(0, &hostServer, &HostServer::listen);
@@ -69,6 +130,21 @@ HostServer::HostServer(QObject *parent)
 
 }
 
+void HostServer::setMaxParallelBringUps(int maxParallel)
+{
+    m_deviceManager.setMaxParallelBringUps(maxParallel);
+}
+
+void HostServer::setConnectionIdleTimeout(int timeout)
+{
+    m_deviceManager.setConnectionIdleTimeout(timeout);
+}
+
+void HostServer::setHeartbeatInterval(int interval)
+{
+    m_deviceManager.setHeartbeatInterval(interval);
+}
+
 void HostServer::listen()
 {
 #ifdef Q_OS_UNIX
@@ -85,6 +161,9 @@ void HostServer::listen()
     connect(&m_localServer, &QLocalServer::newConnection, this, &HostServer::handleClient);
     qCDebug(hostServerC) << "Started listening";
 
+    // Clients can connect right away, but they are only served once the
+    // devices that are already plugged in have been brought up
+    connect(&m_deviceManager, &DeviceManager::ready, this, &HostServer::handleClient);
     connect(&m_deviceManager, &DeviceManager::newDeviceInfo, this, &HostServer::handleNewDeviceInfo);
     connect(&m_deviceManager, &DeviceManager::disconnectedDevice, this, &HostServer::handleDisconnectedDevice);
     m_deviceManager.start();
@@ -94,27 +173,42 @@ void HostServer::close()
 {
     qCDebug(hostServerC) << "Shutting down";
     m_localServer.close();
-    while (!m_servlets.empty())
-        m_servlets.front().close(); // closing results in being erased from the list
+    for (auto &servlet : m_servlets)
+        servlet.close();
+    m_servlets.clear();
     emit closed();
 }
 
 void HostServer::handleClient()
 {
-    QLocalSocket *socket = m_localServer.nextPendingConnection();
-    if (!socket) {
-        qCCritical(hostServerC) << "Did not get a connection from client";
-        close();
+    if (!m_deviceManager.isReady()) {
+        qCDebug(hostServerC) << "Client waits for the startup of the device manager";
         return;
     }
-    m_servlets.emplace_back(socket, m_deviceManager);
-    auto servlet = &m_servlets.back();
 
-    connect(socket, &QLocalSocket::disconnected, servlet, &HostServlet::handleDisconnection);
-    connect(socket, &QIODevice::readyRead, servlet, &HostServlet::handleRequest);
-
-    connect(servlet, &HostServlet::done, this, &HostServer::handleDoneClient);
-    connect(servlet, &HostServlet::serverStopRequested, this, &HostServer::close);
+    while (m_localServer.hasPendingConnections()) {
+        QLocalSocket *socket = m_localServer.nextPendingConnection();
+        if (!socket) {
+            qCCritical(hostServerC) << "Did not get a connection from client";
+            close();
+            return;
+        }
+        m_servlets.emplace_back(socket, m_deviceManager);
+        auto servlet = &m_servlets.back();
+
+        connect(socket, &QLocalSocket::disconnected, servlet, &HostServlet::handleDisconnection);
+        connect(socket, &QIODevice::readyRead, servlet, &HostServlet::handleRequest);
+
+        // Servlets finish from within their own slots, so remove them only later
+        connect(servlet, &HostServlet::done, this, &HostServer::handleDoneClient,
+                Qt::QueuedConnection);
+        connect(servlet, &HostServlet::serverStopRequested, this, &HostServer::close,
+                Qt::QueuedConnection);
+
+        // Requests may have arrived while the client was waiting
+        if (socket->bytesAvailable() > 0)
+            servlet->handleRequest();
+    }
 }
 
 void HostServer::handleDoneClient(ServletId servletId)
@@ -132,9 +226,18 @@ void HostServer::handleDoneClient(ServletId servletId)
 void HostServer::handleNewDeviceInfo(DeviceInformation info)
 {
     qCDebug(hostServerC) << "New device information about" << info.serial;
+    broadcastDeviceEvent(SerialisedMessage{newDeviceResponse(info)});
 }
 
 void HostServer::handleDisconnectedDevice(QString serial)
 {
     qCDebug(hostServerC) << "Disconnected" << serial;
+    broadcastDeviceEvent(SerialisedMessage{disconnectedDeviceResponse(serial)});
+}
+
+void HostServer::broadcastDeviceEvent(const SerialisedMessage &event)
+{
+    // The event is encoded once for all watching clients
+    for (auto &servlet : m_servlets)
+        servlet.sendDeviceEvent(event);
 }
@@ -48,6 +48,9 @@ class HostServer : public QObject
 public:
     explicit HostServer(QObject *parent = nullptr);
 
+    void setMaxParallelBringUps(int maxParallel);
+    void setConnectionIdleTimeout(int timeout);
+    void setHeartbeatInterval(int interval);
     void listen();
 
 signals:
@@ -63,6 +66,8 @@ private slots:
     void handleDisconnectedDevice(QString serial);
 
 private:
+    void broadcastDeviceEvent(const SerialisedMessage &event);
+
     QLocalServer m_localServer;
     std::list<HostServlet> m_servlets;
     DeviceManager m_deviceManager;
@@ -28,25 +28,60 @@
 ****************************************************************************/
 #include "hostservlet.h"
 
-#include "hostmessages.h"
+#include "streamproxyservice.h"
 
-#include <QtCore/qjsonarray.h>
+#include <QtCore/qcborarray.h>
+#include <QtCore/qcbormap.h>
+#include <QtCore/qhash.h>
 #include <QtCore/qjsonobject.h>
 #include <QtCore/qloggingcategory.h>
 #include <QtNetwork/qlocalsocket.h>
 #include "logging.h"
 
+#include <algorithm>
+#include <limits>
+
 Q_DECLARE_LOGGING_CATEGORY(hostServerC);
 
-QJsonObject deviceInformationToJsonObject(const DeviceInformation &deviceInfo)
+QCborMap logEntryToCborMap(const LogEntry &entry)
 {
-    QJsonObject info;
-    info["serial"] = deviceInfo.serial;
-    info["hostMac"] = deviceInfo.hostMac;
-    info["ipAddress"] = deviceInfo.ipAddress;
+    QCborMap info;
+    info[QStringLiteral("sequence")] = static_cast<qint64>(entry.sequence);
+    info[QStringLiteral("type")] = entry.type;
+    info[QStringLiteral("category")] = entry.category;
+    info[QStringLiteral("text")] = entry.text;
     return info;
 }
 
+const QHash<QString, QtMsgType> &messageLevels()
+{
+    static const QHash<QString, QtMsgType> levels{{"debug", QtDebugMsg}, {"info", QtInfoMsg},
+                                                  {"warning", QtWarningMsg}, {"critical", QtCriticalMsg},
+                                                  {"fatal", QtFatalMsg}};
+    return levels;
+}
+
+// Debug and info messages are not kept, so filtering for them is refused
+// rather than silently answered with warnings only
+bool hasValidMessageLevel(const QJsonObject &request)
+{
+    if (!request.contains("level"))
+        return true;
+    const QString level = request["level"].toString();
+    return messageLevels().contains(level) && isKeptLogType(messageLevels().value(level));
+}
+
+LogFilter messageFilter(const QJsonObject &request)
+{
+    LogFilter filter;
+    filter.since = static_cast<quint64>(std::max<qint64>(request["since"].toInteger(), 0));
+    const QString level = request["level"].toString();
+    if (messageLevels().contains(level))
+        filter.minimumSeverity = logSeverity(messageLevels().value(level));
+    filter.categoryPrefix = request["category"].toString();
+    return filter;
+}
+
 ServletId newServletId()
 {
     static ServletId nextId = 0;
@@ -56,6 +91,14 @@ ServletId newServletId()
 HostServlet::HostServlet(QLocalSocket *socket, DeviceManager &deviceManager)
     : m_id{newServletId()},
       m_socket{socket},
+      m_framing{HostMessageFraming::JsonLines},
+      m_keepAlive{false},
+      m_acceptsRequests{true},
+      m_watchingDevices{false},
+      m_watchDevicesId{},
+      m_watchMessagesId{},
+      m_messageFilter{},
+      m_proxy{nullptr},
       m_deviceManager(deviceManager) // Can't use uniform initialization with {} due to https://gcc.gnu.org/bugzilla/show_bug.cgi?id=50025
 {
 
@@ -63,11 +106,18 @@ HostServlet::HostServlet(QLocalSocket *socket, DeviceManager &deviceManager)
 
 HostServlet::~HostServlet()
 {
-    m_socket->deleteLater();
+    // A proxy that was not handed the socket yet lives in another thread
+    if (m_proxy)
+        m_proxy->deleteLater();
+    if (m_socket)
+        m_socket->deleteLater();
 }
 
 void HostServlet::close()
 {
+    m_acceptsRequests = false;
+    if (!m_socket)
+        return;
     m_socket->waitForBytesWritten();
     m_socket->disconnectFromServer();
 }
@@ -77,145 +127,351 @@ ServletId HostServlet::id() const
     return m_id;
 }
 
+void HostServlet::sendDeviceEvent(const SerialisedMessage &event)
+{
+    if (m_watchingDevices)
+        sendSerialised(event, m_watchDevicesId);
+}
+
 void HostServlet::handleDisconnection()
 {
     emit done(m_id);
 }
 
 void HostServlet::handleRequest()
+{
+    // Clients may pipeline several requests, so handle everything that is queued
+    QJsonObject request;
+    while (m_acceptsRequests && readMessage(m_socket, m_framing, &request))
+        dispatchRequest(request);
+}
+
+void HostServlet::dispatchRequest(const QJsonObject &request)
 {
     qCDebug(hostServerC) << "Got request from client" << m_id;
-    const auto requestBytes = m_socket->readLine();
-    const auto request = QJsonDocument::fromJson(requestBytes);
-    const auto type = requestType(request.object());
+    const auto type = requestType(request);
+    const QJsonValue id = requestId(request);
 
     // Skip version check for requests to stop the server, to allow mismatching
     // client to still stop the server
-    if (!checkHostMessageVersion(request.object()) && type != RequestType::StopServer) {
+    if (!checkHostMessageVersion(request) && type != RequestType::StopServer) {
         qCWarning(hostServerC) << "Request from client" << m_id << "was of an unsupported version";
-        QJsonObject response = initializeResponse(ResponseType::UnsupportedVersion);
-        response["supported-version"] = qdbHostMessageVersion;
-        m_socket->write(serialiseResponse(response));
+        QCborMap response = initializeResponse(ResponseType::UnsupportedVersion);
+        response[QStringLiteral("supported-version")] = qdbHostMessageVersion;
+        setRequestId(response, id);
+        m_socket->write(serialiseMessage(response, m_framing));
         close();
         return;
     }
 
+    if (m_framing == HostMessageFraming::JsonLines
+            && requestedFraming(request) == HostMessageFraming::Cbor) {
+        // Confirmed as a JSON line, so that the client can tell this server
+        // apart from older ones that ignore the request
+        m_socket->write(framingChangedResponse(HostMessageFraming::Cbor));
+        m_framing = HostMessageFraming::Cbor;
+        qCDebug(hostServerC) << "Client" << m_id << "switched to CBOR framing";
+    }
+    if (!m_keepAlive && requestsKeepAlive(request)) {
+        m_keepAlive = true;
+        qCDebug(hostServerC) << "Client" << m_id << "started a persistent session";
+    }
+
     switch (type) {
     case RequestType::Devices:
-        replyDevices();
+        replyDevices(id);
+        finishRequest();
         break;
     case RequestType::WatchDevices:
-        startWatchingDevices();
+        startWatchingDevices(id);
         break;
     case RequestType::StopServer:
-        stopServer();
+        stopServer(id);
         break;
     case RequestType::Messages:
-        replyMessages();
-        close();
+        if (checkMessageLevel(request, id))
+            replyMessages(id, messageFilter(request));
+        finishRequest();
         break;
     case RequestType::MessagesAndClear:
-        replyMessages();
-        Logging::instance().clearMessages();
-        close();
+        if (checkMessageLevel(request, id)) {
+            replyMessages(id, messageFilter(request));
+            Logging::instance().clearMessages();
+        }
+        finishRequest();
         break;
     case RequestType::WatchMessages:
-        startWatchingMessages();
+        if (checkMessageLevel(request, id))
+            startWatchingMessages(id, messageFilter(request));
+        else
+            finishRequest();
+        break;
+    case RequestType::OpenStream:
+        openStream(request);
+        break;
+    case RequestType::SetQos:
+        setQos(request, id);
+        finishRequest();
+        break;
+    case RequestType::Statistics:
+        replyStatistics(id);
+        finishRequest();
         break;
     case RequestType::Unknown:
-        qCWarning(hostServerC) << "Request from client" << m_id << "is invalid:" << requestBytes;
-        const QJsonObject response = initializeResponse(ResponseType::InvalidRequest);
-        m_socket->write(serialiseResponse(response));
-        close();
+        qCWarning(hostServerC) << "Request from client" << m_id << "is invalid:"
+                               << QJsonDocument{request}.toJson(QJsonDocument::Compact);
+        sendResponse(ResponseType::InvalidRequest, QString(), QCborValue(), id);
+        finishRequest();
         break;
     }
 }
 
-bool HostServlet::sendResponse(ResponseType type, const QString &fieldName, const QJsonValue &value)
+void HostServlet::finishRequest()
+{
+    if (!m_keepAlive)
+        close();
+}
+
+bool HostServlet::sendResponse(ResponseType type, const QString &fieldName, const QCborValue &value,
+                               const QJsonValue &requestId)
 {
-    QJsonObject response = initializeResponse(type);
+    QCborMap response = initializeResponse(type);
 
     if (!fieldName.isEmpty())
         response[fieldName] = value;
+    return sendResponse(response, requestId);
+}
+
+bool HostServlet::sendResponse(QCborMap response, const QJsonValue &requestId)
+{
+    const ResponseType type = responseType(response);
+    setRequestId(response, requestId);
 
     if (!m_socket || !m_socket->isWritable()) {
         qCWarning(hostServerC) << "Could not reply to client" << m_id;
         return false;
     }
-    m_socket->write(serialiseResponse(response));
+    m_socket->write(serialiseMessage(response, m_framing));
     qCDebug(hostServerC) << "Sent" << responseTypeString(type) << "information to client" << m_id;
     return true;
 }
 
-void HostServlet::replyDevices()
+bool HostServlet::sendSerialised(const SerialisedMessage &message, const QJsonValue &requestId)
 {
-    QJsonArray infoArray;
-    const auto deviceInfos = m_deviceManager.listDevices();
-    for (const auto &deviceInfo : deviceInfos)
-        infoArray << deviceInformationToJsonObject(deviceInfo);
+    if (!m_socket || !m_socket->isWritable()) {
+        qCWarning(hostServerC) << "Could not reply to client" << m_id;
+        return false;
+    }
+    m_socket->write(message.bytes(m_framing, requestId));
+    return true;
+}
 
-    if (!sendResponse(ResponseType::Devices, "devices", infoArray))
+void HostServlet::openStream(const QJsonObject &request)
+{
+    // Anything the client sends after the request belongs to the stream, so
+    // the session ends with this request even if it was persistent
+    m_acceptsRequests = false;
+    disconnect(m_socket, &QIODevice::readyRead, this, &HostServlet::handleRequest);
+
+    const QJsonValue id = requestId(request);
+    const QString serial = request["serial"].toString();
+    const int tag = request["tag"].toInt();
+    // Share of the stream within the bandwidth of its client
+    const qint64 streamWeight = request["stream-weight"].toInteger(1);
+    if (serial.isEmpty() || tag <= 0 || streamWeight < 1
+            || streamWeight > std::numeric_limits<quint32>::max()) {
+        qCWarning(hostServerC) << "Invalid stream request from client" << m_id;
+        sendResponse(ResponseType::InvalidRequest, QString(), QCborValue(), id);
+        close();
+        return;
+    }
+
+    const auto connection = m_deviceManager.connectToDevice(serial);
+    if (!connection) {
+        sendResponse(ResponseType::StreamFailed, "reason", QString{"No device with serial %1"}.arg(serial), id);
+        close();
         return;
-    close();
+    }
+
+    // Streams are scheduled by the client name, which clients can share
+    QString client = request["client"].toString();
+    if (client.isEmpty())
+        client = QString{"client-%1"}.arg(m_id);
+
+    qCDebug(hostServerC) << "Opening stream with tag" << tag << "to" << serial << "for client" << m_id;
+    m_proxy = new StreamProxyService{connection, static_cast<uint32_t>(tag), client,
+                                     m_deviceManager.trafficClass(client),
+                                     static_cast<quint32>(streamWeight)};
+    m_proxy->moveToThread(connection->thread());
+    StreamProxyService *proxy = m_proxy;
+    connect(proxy, &StreamProxyService::opened, this, [=]() {
+        handOverSocket(proxy, id);
+    });
+    connect(proxy, &StreamProxyService::failed, this, [=](const QString &reason) {
+        m_proxy = nullptr;
+        proxy->deleteLater();
+        sendResponse(ResponseType::StreamFailed, "reason", reason, id);
+        close();
+    });
+    QMetaObject::invokeMethod(proxy, &StreamProxyService::initialize, Qt::QueuedConnection);
+}
+
+void HostServlet::handOverSocket(StreamProxyService *proxy, const QJsonValue &requestId)
+{
+    if (!sendResponse(ResponseType::StreamOpened, QString(), QCborValue(), requestId)) {
+        m_proxy = nullptr;
+        proxy->deleteLater();
+        return;
+    }
+
+    // From here on the socket is served by the proxy in the thread of the connection
+    QLocalSocket *socket = m_socket;
+    m_socket = nullptr;
+    m_proxy = nullptr;
+    socket->disconnect(this);
+    socket->setParent(nullptr);
+    socket->moveToThread(proxy->thread());
+    QMetaObject::invokeMethod(proxy, [=]() {
+        proxy->attachSocket(socket);
+    }, Qt::QueuedConnection);
+
+    emit done(m_id);
 }
 
-void HostServlet::replyNewDevice(const DeviceInformation &deviceInfo)
+bool HostServlet::checkMessageLevel(const QJsonObject &request, const QJsonValue &requestId)
 {
-    sendResponse(ResponseType::NewDevice, "device", deviceInformationToJsonObject(deviceInfo));
+    if (hasValidMessageLevel(request))
+        return true;
+
+    qCWarning(hostServerC) << "Invalid message level" << request["level"].toString()
+                           << "from client" << m_id;
+    sendResponse(ResponseType::InvalidRequest, QString(), QCborValue(), requestId);
+    return false;
 }
 
-void HostServlet::replyMessages()
+void HostServlet::setQos(const QJsonObject &request, const QJsonValue &requestId)
 {
-    QJsonArray infoArray;
-    const auto &messages = Logging::instance().getMessages();
+    const QString client = request["client"].toString();
+    const qint64 weight = request["weight"].toInteger(1);
+    const qint64 rate = request["rate"].toInteger(0);
+    if (client.isEmpty() || weight < 1 || weight > std::numeric_limits<quint32>::max() || rate < 0) {
+        qCWarning(hostServerC) << "Invalid QoS request from client" << m_id;
+        sendResponse(ResponseType::InvalidRequest, QString(), QCborValue(), requestId);
+        return;
+    }
+
+    TrafficClass trafficClass;
+    trafficClass.weight = static_cast<quint32>(weight);
+    trafficClass.bytesPerSecond = rate;
+    m_deviceManager.setTrafficClass(client, trafficClass);
+
+    QCborMap response = initializeResponse(ResponseType::QosSet);
+    response[QStringLiteral("client")] = client;
+    response[QStringLiteral("weight")] = weight;
+    response[QStringLiteral("rate")] = rate;
+    sendResponse(response, requestId);
+}
 
-    for (int i = 0; i < messages.count(); ++i) {
-        const auto &item = messages.at(i);
-        QJsonObject info;
-        info["type"] = item.first;
-        info["text"] = item.second;
-        infoArray << info;
+void HostServlet::replyStatistics(const QJsonValue &requestId)
+{
+    QCborArray devices;
+    const auto statistics = m_deviceManager.trafficStatistics();
+    const auto roundTripTimes = m_deviceManager.roundTripTimes();
+    for (auto iter = statistics.cbegin(); iter != statistics.cend(); ++iter) {
+        QCborArray streams;
+        for (const auto &stream : iter.value()) {
+            QCborMap info;
+            info[QStringLiteral("stream")] = static_cast<qint64>(stream.hostStream);
+            info[QStringLiteral("client")] = stream.client;
+            info[QStringLiteral("weight")] = static_cast<qint64>(stream.trafficClass.weight);
+            info[QStringLiteral("rate")] = stream.trafficClass.bytesPerSecond;
+            info[QStringLiteral("stream-weight")] = static_cast<qint64>(stream.streamWeight);
+            info[QStringLiteral("sent")] = static_cast<qint64>(stream.bytesSent);
+            info[QStringLiteral("received")] = static_cast<qint64>(stream.bytesReceived);
+            info[QStringLiteral("queued")] = stream.bytesQueued;
+            streams << info;
+        }
+        // In microseconds
+        const RoundTripTimes times = roundTripTimes.value(iter.key());
+        QCborMap rtt;
+        rtt[QStringLiteral("samples")] = static_cast<qint64>(times.samples);
+        rtt[QStringLiteral("min")] = times.minimum;
+        rtt[QStringLiteral("avg")] = times.average;
+        rtt[QStringLiteral("p99")] = times.p99;
+        QCborMap device;
+        device[QStringLiteral("serial")] = iter.key();
+        device[QStringLiteral("streams")] = streams;
+        device[QStringLiteral("rtt")] = rtt;
+        devices << device;
     }
 
-    sendResponse(ResponseType::Messages, "messages", infoArray);
+    sendResponse(ResponseType::Statistics, "devices", devices, requestId);
 }
 
-void HostServlet::replyDisconnectedDevice(const QString &serial)
+void HostServlet::replyDevices(const QJsonValue &requestId)
 {
-    sendResponse(ResponseType::DisconnectedDevice, "serial", serial);
+    sendSerialised(m_deviceManager.snapshot()->devicesResponse(), requestId);
+    qCDebug(hostServerC) << "Sent devices information to client" << m_id;
 }
 
-void HostServlet::startWatchingDevices()
+void HostServlet::replyMessages(const QJsonValue &requestId, const LogFilter &filter)
+{
+    QCborArray infoArray;
+    const auto entries = Logging::instance().messages(filter);
+    for (const auto &entry : entries)
+        infoArray << logEntryToCborMap(entry);
+
+    sendMessages(infoArray, requestId);
+}
+
+void HostServlet::replyNewMessage(const LogEntry &entry)
+{
+    // Warning about the failure would only result in another message
+    if (!m_socket || !m_socket->isWritable() || !m_messageFilter.matches(entry))
+        return;
+    sendMessages(QCborArray{logEntryToCborMap(entry)}, m_watchMessagesId);
+}
+
+void HostServlet::sendMessages(const QCborArray &messages, const QJsonValue &requestId)
+{
+    QCborMap response = initializeResponse(ResponseType::Messages);
+    response[QStringLiteral("messages")] = messages;
+    // Clients pass this as "since" to continue where they left off
+    response[QStringLiteral("last-sequence")] = static_cast<qint64>(Logging::instance().lastSequence());
+    sendResponse(response, requestId);
+}
+
+void HostServlet::startWatchingDevices(const QJsonValue &requestId)
 {
     qCDebug(hostServerC) << "Starting to watch devices for client" << m_id;
-    connect(&m_deviceManager, &DeviceManager::newDeviceInfo, this, &HostServlet::replyNewDevice);
-    connect(&m_deviceManager, &DeviceManager::disconnectedDevice, this, &HostServlet::replyDisconnectedDevice);
+    // Later events are passed in by the host server with sendDeviceEvent().
+    // Watching again in a persistent session only changes the id of the events.
+    m_watchingDevices = true;
+    m_watchDevicesId = requestId;
 
-    const auto deviceInfos = m_deviceManager.listDevices();
-    for (const auto &deviceInfo : deviceInfos)
-        replyNewDevice(deviceInfo);
+    const auto snapshot = m_deviceManager.snapshot();
+    for (const auto &event : snapshot->newDeviceEvents())
+        sendSerialised(event, requestId);
     qCDebug(hostServerC) << "Reported initial devices to client" << m_id;
 }
 
-void HostServlet::startWatchingMessages()
+void HostServlet::startWatchingMessages(const QJsonValue &requestId, const LogFilter &filter)
 {
     qCDebug(hostServerC) << "Starting to watch messages for client" << m_id;
-    connect(&Logging::instance(), &Logging::newMessage, this, [=](QtMsgType type, const QString &message) {
-          QJsonArray infoArray;
-          QJsonObject info;
-          info["type"] = type;
-          info["text"] = message;
-          infoArray << info;
-          sendResponse(ResponseType::Messages, "messages", infoArray);
-        });
-
-    replyMessages();
+    m_watchMessagesId = requestId;
+    m_messageFilter = filter;
+    connect(&Logging::instance(), &Logging::newMessage,
+            this, &HostServlet::replyNewMessage, Qt::UniqueConnection);
+
+    // Later entries are filtered by severity and category only
+    replyMessages(requestId, filter);
+    m_messageFilter.since = 0;
     qCDebug(hostServerC) << "Reported initial messages to client" << m_id;
 }
 
-void HostServlet::stopServer()
+void HostServlet::stopServer(const QJsonValue &requestId)
 {
-    sendResponse(ResponseType::Stopping, QString(), QJsonValue());
+    sendResponse(ResponseType::Stopping, QString(), QCborValue(), requestId);
 
     emit serverStopRequested();
     // All servlets, including this one will be closed during shutdown
@@ -30,13 +30,15 @@
 #define HOSTSERVLET_H
 
 #include "devicemanager.h"
+#include "hostmessages.h"
+#include "logging.h"
 
 #include <QtCore/qobject.h>
 QT_BEGIN_NAMESPACE
 class QLocalSocket;
 QT_END_NAMESPACE
 
-enum class ResponseType;
+class StreamProxyService;
 using ServletId = uint32_t;
 
 // Takes ownership of the passed QLocalSocket
@@ -49,6 +51,8 @@ public:
 
     void close();
     ServletId id() const;
+    //! Writes the event if the client is watching devices
+    void sendDeviceEvent(const SerialisedMessage &event);
 
 signals:
     void done(ServletId id);
@@ -58,18 +62,39 @@ public slots:
     void handleDisconnection();
     void handleRequest();
 
+private slots:
+    void replyNewMessage(const LogEntry &entry);
+
 private:
-    void replyDevices();
-    void replyMessages();
-    void replyNewDevice(const DeviceInformation &deviceInfo);
-    void replyDisconnectedDevice(const QString &serial);
-    void startWatchingDevices();
-    void startWatchingMessages();
-    void stopServer();
-    bool sendResponse(ResponseType type, const QString &fieldName, const QJsonValue &value);
+    void dispatchRequest(const QJsonObject &request);
+    void finishRequest();
+    void openStream(const QJsonObject &request);
+    void handOverSocket(StreamProxyService *proxy, const QJsonValue &requestId);
+    //! Answers InvalidRequest if the request filters for a level that is not kept
+    bool checkMessageLevel(const QJsonObject &request, const QJsonValue &requestId);
+    void setQos(const QJsonObject &request, const QJsonValue &requestId);
+    void replyStatistics(const QJsonValue &requestId);
+    void replyDevices(const QJsonValue &requestId);
+    void replyMessages(const QJsonValue &requestId, const LogFilter &filter);
+    void sendMessages(const QCborArray &messages, const QJsonValue &requestId);
+    void startWatchingDevices(const QJsonValue &requestId);
+    void startWatchingMessages(const QJsonValue &requestId, const LogFilter &filter);
+    void stopServer(const QJsonValue &requestId);
+    bool sendResponse(ResponseType type, const QString &fieldName, const QCborValue &value,
+                      const QJsonValue &requestId);
+    bool sendResponse(QCborMap response, const QJsonValue &requestId);
+    bool sendSerialised(const SerialisedMessage &message, const QJsonValue &requestId);
 
     ServletId m_id;
     QLocalSocket *m_socket;
+    HostMessageFraming m_framing;
+    bool m_keepAlive;
+    bool m_acceptsRequests;
+    bool m_watchingDevices;
+    QJsonValue m_watchDevicesId;
+    QJsonValue m_watchMessagesId;
+    LogFilter m_messageFilter;
+    StreamProxyService *m_proxy;
     DeviceManager &m_deviceManager;
 };
 
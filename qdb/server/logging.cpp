@@ -28,66 +28,77 @@
 ****************************************************************************/
 #include "logging.h"
 
-#include <QtCore/qdatetime.h>
+#include "logwriter.h"
+
+#include <QtCore/qcoreapplication.h>
 #include <QtCore/qdebug.h>
 #include <QtCore/qdir.h>
-#include <QtCore/qfile.h>
 #include <QtCore/qstandardpaths.h>
+#include <QtCore/qthread.h>
 #include <QtGlobal>
 
-static QFile logFile;
+#include <atomic>
+#include <cstdio>
+
+// Never deleted once started, so that loggers in other threads can keep using
+// the writer they loaded while stopLogWriter() runs
+static std::atomic<LogWriter *> logWriter{nullptr};
 
+// Runs on whatever thread logged, so only formats the line and queues it
 void hostServerMessageHandler(QtMsgType type, const QMessageLogContext &context, const QString &msg)
 {
-    if (!logFile.isWritable()) {
-        if (!logFile.open(QFile::WriteOnly | QIODevice::Unbuffered)) {
-            // Fall back to default handler
-            qInstallMessageHandler(nullptr);
-            qCritical() << "Could not open log file" << logFile.fileName();
-            return;
-        } else {
-            QString startMessage{"-- Starting QDB host server log on %1 --\n"};
-            startMessage = startMessage.arg(QDateTime::currentDateTime().toString(Qt::ISODate));
-            logFile.write(startMessage.toUtf8());
-        }
-    }
-
-    QString prefix;
+    const char *prefix = "";
     switch (type) {
     case QtDebugMsg:
-        prefix = "D:";
+        prefix = "D: ";
         break;
     case QtInfoMsg:
-        prefix = "I:";
+        prefix = "I: ";
         break;
     case QtWarningMsg:
-        prefix = "W:";
+        prefix = "W: ";
         break;
     case QtCriticalMsg:
-        prefix = "C:";
+        prefix = "C: ";
         break;
     case QtFatalMsg:
-        prefix = "F:";
+        prefix = "F: ";
         break;
     }
 
     const auto message = qFormatLogMessage(type, context, msg);
-    const auto fullMsg = QString{"%1 %2\n"}.arg(prefix).arg(message).toUtf8();
-
-    if (type == QtWarningMsg || type == QtCriticalMsg || type == QtFatalMsg)
-        Logging::instance().emitNewMessage(type, message);
-
-    auto written = logFile.write(fullMsg);
-    if (written != fullMsg.size()) {
-        qInstallMessageHandler(nullptr);
-        qCritical() << "Could not write into log file" << logFile.fileName()
-                    << ":" << logFile.errorString();
+    QByteArray line{prefix};
+    line.append(message.toUtf8()).append('\n');
+
+    if (isKeptLogType(type))
+        Logging::instance().emitNewMessage(type, QString::fromLatin1(context.category), message);
+
+    LogWriter *writer = logWriter.load(std::memory_order_acquire);
+    if (writer) {
+        writer->enqueue(std::move(line));
+        if (type == QtFatalMsg)
+            writer->stop();
+    } else {
+        // Logged while the writer was being stopped
+        fputs(line.constData(), stderr);
     }
 
     if (type == QtFatalMsg)
         abort();
 }
 
+void stopLogWriter()
+{
+    // Messages after this go to the console
+    qInstallMessageHandler(nullptr);
+
+    // The writer is left to the end of the process instead of deleted, since
+    // a logger may still be enqueueing into it. A line that races with stopping
+    // can stay in the queue unwritten.
+    LogWriter *writer = logWriter.exchange(nullptr, std::memory_order_acq_rel);
+    writer->stop();
+}
+
 void setupLogging()
 {
     if (qgetenv("QDB_LOGGING_TO_CONSOLE") != "1") {
@@ -101,8 +112,16 @@ void setupLogging()
                 dirAvailable = dataDir.mkpath(".");
 
             if (dirAvailable) {
-                logFile.setFileName(dataLocation + "/qdb.log");
-                qInstallMessageHandler(hostServerMessageHandler);
+                auto *writer = new LogWriter{dataLocation + "/qdb.log"};
+                if (writer->start()) {
+                    logWriter.store(writer, std::memory_order_release);
+                    qInstallMessageHandler(hostServerMessageHandler);
+                    qAddPostRoutine(stopLogWriter);
+                } else {
+                    qWarning() << "Could not open log file" << writer->fileName()
+                               << ", logging to console";
+                    delete writer;
+                }
             } else {
                 qWarning() << "Application data location" << dataLocation
                            << "was not possible to log in, logging to console";
@@ -115,17 +134,63 @@ void setupLogging()
     Logging::instance();
 }
 
+int logSeverity(QtMsgType type)
+{
+    switch (type) {
+    case QtDebugMsg:
+        return 0;
+    case QtInfoMsg:
+        return 1;
+    case QtWarningMsg:
+        return 2;
+    case QtCriticalMsg:
+        return 3;
+    case QtFatalMsg:
+        return 4;
+    }
+    return 0;
+}
+
+bool isKeptLogType(QtMsgType type)
+{
+    return logSeverity(type) >= logSeverity(QtWarningMsg);
+}
+
+bool LogFilter::matches(const LogEntry &entry) const
+{
+    return entry.sequence > since
+            && logSeverity(entry.type) >= minimumSeverity
+            && entry.category.startsWith(categoryPrefix);
+}
+
 void Logging::clearMessages()
 {
+    // Sequence numbers continue, so that clients never see a number twice
     m_messages.clear();
 }
 
-const QContiguousCache<QPair<int, QString>> &Logging::getMessages()
+std::vector<LogEntry> Logging::messages(const LogFilter &filter) const
+{
+    std::vector<LogEntry> entries;
+    if (m_messages.isEmpty() || filter.since >= m_lastSequence)
+        return entries;
+
+    for (qsizetype i = m_messages.firstIndex(); i <= m_messages.lastIndex(); ++i) {
+        const LogEntry &entry = m_messages.at(i);
+        if (filter.matches(entry))
+            entries.push_back(entry);
+    }
+    return entries;
+}
+
+quint64 Logging::lastSequence() const
 {
-    return m_messages;
+    return m_lastSequence;
 }
 
 Logging::Logging()
+    : m_messages{},
+      m_lastSequence{0}
 {
     m_messages.setCapacity(200);
 }
@@ -136,8 +201,17 @@ Logging &Logging::instance()
     return logging;
 }
 
-void Logging::emitNewMessage(QtMsgType type, const QString &message)
+void Logging::emitNewMessage(QtMsgType type, const QString &category, const QString &message)
 {
-    m_messages.append(qMakePair(type, message));
-    emit newMessage(type, message);
+    // Messages may be logged in any thread, but are kept in the main thread
+    if (QThread::currentThread() != thread()) {
+        QMetaObject::invokeMethod(this, [=]() {
+            emitNewMessage(type, category, message);
+        }, Qt::QueuedConnection);
+        return;
+    }
+
+    const LogEntry entry{++m_lastSequence, type, category, message};
+    m_messages.append(entry);
+    emit newMessage(entry);
 }
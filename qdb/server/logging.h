@@ -31,25 +31,55 @@
 
 #include <QObject>
 #include <QContiguousCache>
-#include <QPair>
+#include <QString>
+
+#include <vector>
 
 void setupLogging();
 
+struct LogEntry
+{
+    quint64 sequence;
+    QtMsgType type;
+    QString category;
+    QString text;
+};
+Q_DECLARE_METATYPE(LogEntry)
+
+//! Severity of a message type, since QtMsgType is not ordered by it
+int logSeverity(QtMsgType type);
+//! Whether messages of the type are numbered and kept for clients. Debug and
+//! info messages are only written to the log.
+bool isKeptLogType(QtMsgType type);
+
+struct LogFilter
+{
+    quint64 since = 0; // Only entries with a higher sequence number
+    // Lower severities would never match, since no such entries are kept
+    int minimumSeverity = logSeverity(QtWarningMsg);
+    QString categoryPrefix;
+
+    bool matches(const LogEntry &entry) const;
+};
+
 class Logging : public QObject
 {
 Q_OBJECT
 public:
     void clearMessages();
-    const QContiguousCache<QPair<int, QString>> &getMessages();
+    std::vector<LogEntry> messages(const LogFilter &filter) const;
+    //! Sequence number of the latest entry, 0 if there is none
+    quint64 lastSequence() const;
     static Logging &instance();
-    void emitNewMessage(QtMsgType type, const QString &message);
+    void emitNewMessage(QtMsgType type, const QString &category, const QString &message);
 
 private:
     Logging();
-    QContiguousCache<QPair<int, QString>> m_messages;
+    QContiguousCache<LogEntry> m_messages;
+    quint64 m_lastSequence;
 
 signals:
-    void newMessage(QtMsgType type, const QString &);
+    void newMessage(const LogEntry &entry);
 };
 
 #endif // QDB_LOGGING_H
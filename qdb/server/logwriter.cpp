@@ -0,0 +1,246 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Debug Bridge.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+#include "logwriter.h"
+
+#include <QtCore/qdatetime.h>
+#include <QtCore/qdebug.h>
+#include <QtCore/qthread.h>
+
+namespace {
+
+// Lines queued beyond this are dropped until the writer catches up
+const qint64 maxQueuedBytes = 8 * 1024 * 1024;
+const int maxBatchSize = 64 * 1024;
+const unsigned long flushInterval = 100; // in ms
+const qint64 defaultMaxFileSize = 10 * 1024 * 1024;
+const int rotatedLogFileCount = 3;
+
+} // anonymous namespace
+
+LogWriter::LogWriter(const QString &fileName)
+    : m_fileName{fileName},
+      m_file{fileName},
+      m_maxFileSize{defaultMaxFileSize},
+      m_stub{},
+      m_head{&m_stub},
+      m_tail{&m_stub},
+      m_queuedBytes{0},
+      m_droppedLines{0},
+      m_failed{false},
+      m_wakeMutex{},
+      m_wakeCondition{},
+      m_stopping{false},
+      m_thread{}
+{
+    m_stub.next.store(nullptr, std::memory_order_relaxed);
+}
+
+LogWriter::~LogWriter()
+{
+    stop();
+
+    while (Node *node = pop())
+        delete node;
+}
+
+QString LogWriter::fileName() const
+{
+    return m_fileName;
+}
+
+void LogWriter::setMaxFileSize(qint64 size)
+{
+    m_maxFileSize = size;
+}
+
+bool LogWriter::start()
+{
+    if (!m_file.open(QFile::WriteOnly | QFile::Append))
+        return false;
+    writeStartLine("Starting");
+
+    m_thread.reset(QThread::create([this]() { run(); }));
+    m_thread->setObjectName("LogWriter");
+    m_thread->start(QThread::LowPriority);
+    return true;
+}
+
+void LogWriter::enqueue(QByteArray line)
+{
+    const qint64 size = line.size();
+    if (m_queuedBytes.fetch_add(size, std::memory_order_relaxed) + size > maxQueuedBytes) {
+        m_queuedBytes.fetch_sub(size, std::memory_order_relaxed);
+        m_droppedLines.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    auto *node = new Node;
+    node->line = std::move(line);
+    push(node);
+}
+
+void LogWriter::stop()
+{
+    if (!m_thread)
+        return;
+    // A fatal message from the writer thread itself can only be left queued
+    if (QThread::currentThread() == m_thread.get())
+        return;
+
+    {
+        QMutexLocker locker{&m_wakeMutex};
+        m_stopping = true;
+        m_wakeCondition.wakeAll();
+    }
+    // Several threads may stop the writer at once, e.g. the post routine and
+    // a fatal message, so the thread is kept until the writer is destroyed
+    m_thread->wait();
+}
+
+void LogWriter::run()
+{
+    forever {
+        bool stopping;
+        {
+            QMutexLocker locker{&m_wakeMutex};
+            if (!m_stopping)
+                m_wakeCondition.wait(&m_wakeMutex, flushInterval);
+            stopping = m_stopping;
+        }
+
+        // Lines queued before stopping are still written
+        writeQueued();
+        if (stopping)
+            return;
+    }
+}
+
+void LogWriter::push(Node *node)
+{
+    node->next.store(nullptr, std::memory_order_relaxed);
+    Node *previous = m_head.exchange(node, std::memory_order_acq_rel);
+    previous->next.store(node, std::memory_order_release);
+}
+
+LogWriter::Node *LogWriter::pop()
+{
+    Node *tail = m_tail;
+    Node *next = tail->next.load(std::memory_order_acquire);
+    if (tail == &m_stub) {
+        if (!next)
+            return nullptr;
+        m_tail = next;
+        tail = next;
+        next = next->next.load(std::memory_order_acquire);
+    }
+    if (next) {
+        m_tail = next;
+        return tail;
+    }
+
+    // The tail is the last node, unless a producer is between its exchange
+    // and linking, in which case its node is picked up by the next pop
+    if (tail != m_head.load(std::memory_order_acquire))
+        return nullptr;
+    push(&m_stub);
+    next = tail->next.load(std::memory_order_acquire);
+    if (next) {
+        m_tail = next;
+        return tail;
+    }
+    return nullptr;
+}
+
+void LogWriter::writeQueued()
+{
+    QByteArray batch;
+    batch.reserve(maxBatchSize);
+
+    const quint64 droppedLines = m_droppedLines.exchange(0, std::memory_order_relaxed);
+    if (droppedLines > 0)
+        batch.append("-- Dropped ").append(QByteArray::number(droppedLines)).append(" log messages --\n");
+
+    while (Node *node = pop()) {
+        m_queuedBytes.fetch_sub(node->line.size(), std::memory_order_relaxed);
+        batch.append(node->line);
+        delete node;
+
+        if (batch.size() >= maxBatchSize) {
+            writeBatch(batch);
+            batch.clear();
+        }
+    }
+    if (!batch.isEmpty())
+        writeBatch(batch);
+    if (!m_failed)
+        m_file.flush();
+}
+
+bool LogWriter::writeBatch(const QByteArray &batch)
+{
+    if (m_failed)
+        return false;
+
+    if (m_file.write(batch) != batch.size()) {
+        m_failed = true;
+        qInstallMessageHandler(nullptr);
+        qCritical() << "Could not write into log file" << m_fileName << ":" << m_file.errorString();
+        return false;
+    }
+
+    if (m_file.size() >= m_maxFileSize)
+        rotate();
+    return true;
+}
+
+void LogWriter::rotate()
+{
+    m_file.close();
+
+    QFile::remove(QString{"%1.%2"}.arg(m_fileName).arg(rotatedLogFileCount));
+    for (int i = rotatedLogFileCount - 1; i > 0; --i)
+        QFile::rename(QString{"%1.%2"}.arg(m_fileName).arg(i), QString{"%1.%2"}.arg(m_fileName).arg(i + 1));
+    QFile::rename(m_fileName, m_fileName + ".1");
+
+    if (!m_file.open(QFile::WriteOnly | QFile::Truncate)) {
+        m_failed = true;
+        qInstallMessageHandler(nullptr);
+        qCritical() << "Could not open log file" << m_fileName << "after rotating it";
+        return;
+    }
+    writeStartLine("Continuing");
+}
+
+void LogWriter::writeStartLine(const char *action)
+{
+    QByteArray line{"-- "};
+    line.append(action).append(" QDB host server log on ");
+    line.append(QDateTime::currentDateTime().toString(Qt::ISODate).toUtf8()).append(" --\n");
+    m_file.write(line);
+}
@@ -0,0 +1,96 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Debug Bridge.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+#ifndef LOGWRITER_H
+#define LOGWRITER_H
+
+#include <QtCore/qbytearray.h>
+#include <QtCore/qfile.h>
+#include <QtCore/qmutex.h>
+#include <QtCore/qstring.h>
+#include <QtCore/qwaitcondition.h>
+QT_BEGIN_NAMESPACE
+class QThread;
+QT_END_NAMESPACE
+
+#include <atomic>
+#include <memory>
+
+// Writes log lines into a file from a thread of its own. Any thread may call
+// enqueue() without taking a lock. The writer thread collects queued lines
+// into batches, rotates the file once it grows over its size limit and drops
+// lines while the queue is over its memory budget.
+class LogWriter
+{
+public:
+    explicit LogWriter(const QString &fileName);
+    ~LogWriter();
+
+    QString fileName() const;
+    //! Size in bytes after which the file is rotated, 10 MiB by default
+    void setMaxFileSize(qint64 size);
+    bool start();
+    void enqueue(QByteArray line);
+    //! Writes everything still queued and stops the writer thread, may be
+    //! called from several threads
+    void stop();
+
+private:
+    struct Node
+    {
+        std::atomic<Node *> next;
+        QByteArray line;
+    };
+
+    void run();
+    void push(Node *node);
+    Node *pop();
+    void writeQueued();
+    bool writeBatch(const QByteArray &batch);
+    void rotate();
+    void writeStartLine(const char *action);
+
+    QString m_fileName;
+    QFile m_file;
+    qint64 m_maxFileSize;
+    // Multi-producer single-consumer queue, where producers only exchange the
+    // head and the writer thread alone follows the links from the tail
+    Node m_stub;
+    std::atomic<Node *> m_head;
+    Node *m_tail;
+    std::atomic<qint64> m_queuedBytes;
+    std::atomic<quint64> m_droppedLines;
+    bool m_failed;
+    // Only used by the writer thread to sleep between batches
+    QMutex m_wakeMutex;
+    QWaitCondition m_wakeCondition;
+    bool m_stopping;
+    std::unique_ptr<QThread> m_thread;
+};
+
+#endif // LOGWRITER_H
@@ -29,21 +29,81 @@
 #include "networkconfigurator.h"
 
 #include "connection.h"
-#include "connectionpool.h"
 #include "networkconfigurationservice.h"
 #include "subnet.h"
+#include "subnetcache.h"
 
 #include <QtCore/qloggingcategory.h>
 
 Q_LOGGING_CATEGORY(configuratorC, "qdb.networkconfiguration")
 
-NetworkConfigurator::NetworkConfigurator(ConnectionPool *pool, UsbDevice device)
-    : m_connection{pool->connect(device)},
+NetworkConfigurator::NetworkConfigurator(std::shared_ptr<Connection> connection, UsbDevice device)
+    : m_connection{connection},
       m_device(device) // uniform initialization with {} fails in MSVC 2013 with error C2797
 {
 
 }
 
+SubnetReservation NetworkConfigurator::reserveSubnet(const QString &serial)
+{
+    // Offering the subnet the device had before lets it skip reconfiguring
+    // its network if it still has that configuration
+    const std::pair<Subnet, bool> cached = SubnetCache::instance()->lookup(serial);
+    SubnetReservation reservation = cached.second ? findUnusedSubnet(cached.first)
+                                                  : findUnusedSubnet();
+    if (!reservation) {
+        qCCritical(configuratorC) << "Could not find a free subnet to use for the network of device"
+                                  << serial;
+        return reservation;
+    }
+
+    const Subnet subnet = reservation->subnet();
+    qCDebug(configuratorC) << "Using" << (cached.second && subnet == cached.first ? "cached" : "new")
+                           << "subnet" << subnetString(subnet) << "for" << serial;
+    return reservation;
+}
+
+SubnetReservation NetworkConfigurator::adoptSubnet(const QString &serial, const QString &subnet,
+                                                   const SubnetReservation &offered)
+{
+    const QStringList parts = subnet.split(QLatin1Char{'/'});
+    if (parts.size() != 2) {
+        qCCritical(configuratorC) << "Invalid already set subnet from device" << serial
+                                  << ":" << subnet;
+        return SubnetReservation{};
+    }
+
+    const QHostAddress address{parts[0]};
+    const int prefixLength = parts[1].toInt();
+    if (address.isNull() || prefixLength < 1 || prefixLength > 32) {
+        qCCritical(configuratorC) << "Invalid already set subnet from device" << serial
+                                  << ":" << subnet;
+        return SubnetReservation{};
+    }
+
+    Subnet subnetStruct{address, prefixLength};
+    if (offered && offered->subnet() == subnetStruct) {
+        // The device kept the subnet that was offered to it
+        return offered;
+    }
+
+    SubnetReservation reservation = SubnetPool::instance()->reserve(subnetStruct);
+    if (!reservation) {
+        qCWarning(configuratorC) << "Could not reserve already set subnet" << subnet
+                                 << "for device" << serial;
+        return reservation;
+    }
+
+    qCDebug(configuratorC) << "Reused already set configuration" << subnet << "for device"
+                           << serial;
+    return reservation;
+}
+
+QString NetworkConfigurator::subnetString(const Subnet &subnet)
+{
+    return QString{"%1/%2"}.arg(subnet.address.toString()).arg(subnet.prefixLength);
+}
+
 void NetworkConfigurator::configure()
 {
     if (!m_connection || m_connection->state() == ConnectionState::Disconnected) {
@@ -53,20 +113,14 @@ void NetworkConfigurator::configure()
         return;
     }
 
-    SubnetReservation reservation = findUnusedSubnet();
+    SubnetReservation reservation = reserveSubnet(m_device.serial);
     if (!reservation) {
-        qCCritical(configuratorC) << "Could not find a free subnet to use for the network of device"
-                                  << m_device.serial;
         emit configured(m_device, false);
         return;
     }
 
     m_device.reservation = reservation;
-    const auto subnet = reservation->subnet();
-    const auto subnetString
-            = QString{"%1/%2"}.arg(subnet.address.toString()).arg(subnet.prefixLength);
-
-    qCDebug(configuratorC) << "Using subnet" << subnetString << "for" << m_device.serial;
+    const QString proposal = subnetString(reservation->subnet());
 
     auto *service = new NetworkConfigurationService{m_connection.get()};
 
@@ -77,7 +131,7 @@ void NetworkConfigurator::configure()
     connect(service, &NetworkConfigurationService::alreadySetResponse,
             this, &NetworkConfigurator::handleAlreadySetResponse);
     connect(service, &Service::initialized, [=]() {
-        service->configure(subnetString);
+        service->configure(proposal);
     });
 
     service->initialize();
@@ -85,39 +139,24 @@ void NetworkConfigurator::configure()
 
 void NetworkConfigurator::handleAlreadySetResponse(QString subnet)
 {
-    const QStringList parts = subnet.split(QLatin1Char{'/'});
-    if (parts.size() != 2) {
-        qCCritical(configuratorC) << "Invalid already set subnet from device" << m_device.serial
-                                  << ":" << subnet;
-        emit configured(m_device, false);
-        return;
-    }
-
-    const QHostAddress address{parts[0]};
-    const int prefixLength = parts[1].toInt();
-    if (address.isNull() || prefixLength < 1 || prefixLength > 32) {
-        qCCritical(configuratorC) << "Invalid already set subnet from device" << m_device.serial
-                                  << ":" << subnet;
-        emit configured(m_device, false);
-        return;
-    }
-
-    Subnet subnetStruct{address, prefixLength};
-    SubnetReservation reservation = SubnetPool::instance()->reserve(subnetStruct);
+    SubnetReservation reservation = adoptSubnet(m_device.serial, subnet, m_device.reservation);
     if (!reservation) {
-        qCWarning(configuratorC) << "Could not reserve already set subnet" << subnet
-                                 << "for device" << m_device.serial;
         emit configured(m_device, false);
         return;
     }
 
-    qCDebug(configuratorC) << "Reused already set configuration" << subnet << "for device"
-                           << m_device.serial;
     m_device.reservation = reservation;
-    emit configured(m_device, true);
+    finish(true);
 }
 
 void NetworkConfigurator::handleResponse(ConfigurationResult result)
 {
-    emit configured(m_device, result == ConfigurationResult::Success);
+    finish(result == ConfigurationResult::Success);
+}
+
+void NetworkConfigurator::finish(bool success)
+{
+    if (success && m_device.reservation)
+        SubnetCache::instance()->remember(m_device.serial, m_device.reservation->subnet());
+    emit configured(m_device, success);
 }
@@ -30,9 +30,9 @@
 #define NETWORKCONFIGURATOR_H
 
 #include "libqdb/networkconfigurationcommon.h"
+#include "subnet.h"
 #include "usb-host/usbdevice.h"
 class Connection;
-class ConnectionPool;
 
 #include <QtCore/qobject.h>
 
@@ -43,8 +43,16 @@ class NetworkConfigurator : public QObject
 {
     Q_OBJECT
 public:
-    NetworkConfigurator(ConnectionPool *pool, UsbDevice device);
+    NetworkConfigurator(std::shared_ptr<Connection> connection, UsbDevice device);
 
+    //! Reserve a subnet for the device, preferring the one it had before
+    static SubnetReservation reserveSubnet(const QString &serial);
+    //! Reserve the subnet a device reported as already set, nullptr if not possible
+    static SubnetReservation adoptSubnet(const QString &serial, const QString &subnet,
+                                         const SubnetReservation &offered);
+    static QString subnetString(const Subnet &subnet);
+
+public slots:
     void configure();
 
 signals:
@@ -55,6 +63,8 @@ private slots:
     void handleResponse(ConfigurationResult result);
 
 private:
+    void finish(bool success);
+
     std::shared_ptr<Connection> m_connection;
     UsbDevice m_device;
 };
@@ -0,0 +1,97 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Debug Bridge.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+#include "notificationservice.h"
+
+#include "connection.h"
+#include "libqdb/notificationcommon.h"
+#include "libqdb/protocol/services.h"
+#include "libqdb/stream.h"
+
+#include <QtCore/qdebug.h>
+#include <QtCore/qloggingcategory.h>
+
+Q_LOGGING_CATEGORY(notificationC, "qdb.services.notification");
+
+NotificationService::NotificationService(Connection *connection)
+    : m_connection{connection},
+      m_closed{false}
+{
+
+}
+
+NotificationService::~NotificationService()
+{
+    if (m_stream)
+        m_stream->requestClose();
+}
+
+void NotificationService::initialize()
+{
+    connect(m_connection, &Connection::disconnected, this, &NotificationService::handleDisconnected);
+    m_connection->createStream(tagBuffer(NotificationTag), [=](Stream *stream) {
+        this->streamCreated(stream);
+    });
+}
+
+void NotificationService::receive(StreamPacket packet)
+{
+    uint32_t type = 0;
+    packet >> type;
+
+    switch (static_cast<NotificationMessage>(type)) {
+    case NotificationMessage::Address: {
+        QString ipAddress;
+        bool follows = false;
+        packet >> ipAddress >> follows;
+        emit addressChanged(ipAddress, follows);
+        return;
+    }
+    }
+    // Newer devices may notify about more than this host knows
+    qCDebug(notificationC) << "Ignoring unknown notification" << type;
+}
+
+void NotificationService::onStreamClosed()
+{
+    Service::onStreamClosed();
+    close();
+}
+
+void NotificationService::handleDisconnected()
+{
+    close();
+}
+
+void NotificationService::close()
+{
+    if (m_closed)
+        return;
+    m_closed = true;
+    emit closed();
+}
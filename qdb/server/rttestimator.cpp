@@ -0,0 +1,101 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Debug Bridge.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+#include "rttestimator.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <numeric>
+
+RttEstimator::RttEstimator()
+    : m_lock{},
+      m_window{},
+      m_next{0},
+      m_samples{0},
+      m_smoothed{0},
+      m_variation{0}
+{
+    m_window.reserve(windowSize);
+}
+
+void RttEstimator::addSample(qint64 microseconds)
+{
+    QMutexLocker locker{&m_lock};
+    if (m_window.size() < static_cast<size_t>(windowSize))
+        m_window.push_back(microseconds);
+    else
+        m_window[m_next] = microseconds;
+    m_next = (m_next + 1) % windowSize;
+
+    if (m_samples == 0) {
+        m_smoothed = microseconds;
+        m_variation = microseconds / 2;
+    } else {
+        // Gains of 1/8 and 1/4 as in RFC 6298
+        m_variation += (std::abs(m_smoothed - microseconds) - m_variation) / 4;
+        m_smoothed += (microseconds - m_smoothed) / 8;
+    }
+    ++m_samples;
+}
+
+void RttEstimator::reset()
+{
+    QMutexLocker locker{&m_lock};
+    m_window.clear();
+    m_next = 0;
+    m_samples = 0;
+    m_smoothed = 0;
+    m_variation = 0;
+}
+
+RoundTripTimes RttEstimator::roundTripTimes() const
+{
+    QMutexLocker locker{&m_lock};
+    RoundTripTimes times;
+    times.samples = m_samples;
+    if (m_window.empty())
+        return times;
+
+    std::vector<qint64> sorted = m_window;
+    std::sort(sorted.begin(), sorted.end());
+    times.minimum = sorted.front();
+    times.average = std::accumulate(sorted.cbegin(), sorted.cend(), qint64{0})
+            / static_cast<qint64>(sorted.size());
+    // Nearest rank, so that the maximum of fewer than 100 samples counts
+    const size_t rank = (sorted.size() * 99 + 99) / 100;
+    times.p99 = sorted[rank - 1];
+    return times;
+}
+
+qint64 RttEstimator::timeout() const
+{
+    QMutexLocker locker{&m_lock};
+    if (m_samples == 0)
+        return 0;
+    return m_smoothed + 4 * m_variation;
+}
@@ -0,0 +1,71 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Debug Bridge.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+#ifndef RTTESTIMATOR_H
+#define RTTESTIMATOR_H
+
+#include <QtCore/qmutex.h>
+
+#include <vector>
+
+// Round trip times in microseconds over the recent samples
+struct RoundTripTimes
+{
+    quint64 samples = 0; // Count of all samples, not only the recent ones
+    qint64 minimum = 0;
+    qint64 average = 0;
+    qint64 p99 = 0;
+};
+
+// Rolling estimate of the round trip time of a link from heartbeat samples.
+// Also keeps a smoothed time and its variation as in RFC 6298 for deriving
+// timeouts. All methods are thread-safe.
+class RttEstimator
+{
+public:
+    static const int windowSize = 256;
+
+    RttEstimator();
+
+    void addSample(qint64 microseconds);
+    //! Forgets all samples
+    void reset();
+    RoundTripTimes roundTripTimes() const;
+    //! Time in microseconds after which an answer is overdue, 0 without samples
+    qint64 timeout() const;
+
+private:
+    mutable QMutex m_lock;
+    std::vector<qint64> m_window;
+    size_t m_next;
+    quint64 m_samples;
+    qint64 m_smoothed;
+    qint64 m_variation;
+};
+
+#endif // RTTESTIMATOR_H
@@ -0,0 +1,191 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Debug Bridge.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+#include "streamproxyservice.h"
+
+#include "connection.h"
+#include "libqdb/protocol/services.h"
+#include "libqdb/stream.h"
+
+#include <QtCore/qloggingcategory.h>
+#include <QtNetwork/qlocalsocket.h>
+
+Q_LOGGING_CATEGORY(streamProxyC, "qdb.services.streamproxy");
+
+namespace {
+
+// Amount of data read from the client per stream packet
+const qint64 chunkSize = 16 * 1024;
+// Stop reading from the client while this much is not acknowledged by the device
+const qint64 maxPendingToDevice = 64 * 1024;
+// Hold back acknowledging data from the device while this much is not yet
+// written to the client, and acknowledge again once it is down to the low
+// water mark. The device waits for the acknowledgement, so a slow client
+// slows down the whole connection instead of growing the buffer.
+const qint64 highWaterToClient = 256 * 1024;
+const qint64 lowWaterToClient = 64 * 1024;
+
+} // anonymous namespace
+
+StreamProxyService::StreamProxyService(std::shared_ptr<Connection> connection, uint32_t tag,
+                                       const QString &client, const TrafficClass &trafficClass,
+                                       quint32 streamWeight)
+    : m_connection{connection},
+      m_tag{tag},
+      m_client{client},
+      m_trafficClass{trafficClass},
+      m_streamWeight{streamWeight},
+      m_opened{false},
+      m_socket{nullptr},
+      m_earlyData{}
+{
+    connect(this, &Service::initialized, this, &StreamProxyService::handleOpened);
+}
+
+StreamProxyService::~StreamProxyService()
+{
+    if (m_stream)
+        m_stream->requestClose();
+}
+
+void StreamProxyService::initialize()
+{
+    if (!m_connection || m_connection->state() == ConnectionState::Disconnected) {
+        emit failed("No connection to the device");
+        return;
+    }
+
+    connect(m_connection.get(), &Connection::disconnected,
+            this, &StreamProxyService::handleDisconnected);
+    m_connection->createStream(tagBuffer(static_cast<ServiceTag>(m_tag)), [=](Stream *stream) {
+        this->streamCreated(stream);
+    });
+}
+
+void StreamProxyService::receive(StreamPacket packet)
+{
+    if (!m_stream)
+        return; // Dropped already, the device has not seen the close yet
+
+    qint64 buffered = 0;
+    if (m_socket) {
+        m_socket->write(packet.buffer());
+        buffered = m_socket->bytesToWrite();
+    } else {
+        m_earlyData.append(packet.buffer());
+        buffered = m_earlyData.size();
+    }
+
+    if (buffered >= highWaterToClient)
+        m_stream->pause();
+}
+
+void StreamProxyService::attachSocket(QLocalSocket *socket)
+{
+    m_socket = socket;
+    m_socket->setParent(this);
+    connect(m_socket, &QIODevice::readyRead, this, &StreamProxyService::forwardToDevice);
+    connect(m_socket, &QLocalSocket::disconnected, this, &StreamProxyService::handleSocketDisconnected);
+    connect(m_socket, &QIODevice::bytesWritten, this, &StreamProxyService::handleSocketBytesWritten);
+
+    if (!m_earlyData.isEmpty()) {
+        m_socket->write(m_earlyData);
+        m_earlyData.clear();
+    }
+
+    if (!m_stream || m_socket->state() != QLocalSocket::ConnectedState) {
+        closeSocket();
+        return;
+    }
+
+    forwardToDevice();
+}
+
+void StreamProxyService::onStreamClosed()
+{
+    Service::onStreamClosed();
+    qCDebug(streamProxyC) << "Device closed proxied stream";
+
+    if (!m_opened) {
+        emit failed("The device closed the stream");
+        return;
+    }
+    if (m_socket)
+        closeSocket();
+    // Otherwise the socket is closed when it is attached
+}
+
+void StreamProxyService::handleOpened()
+{
+    m_opened = true;
+    m_connection->setStreamTrafficClass(m_stream->hostId(), m_client, m_trafficClass, m_streamWeight);
+    connect(m_stream, &Stream::bytesWritten, this, &StreamProxyService::forwardToDevice);
+    qCDebug(streamProxyC) << "Opened stream with tag" << m_tag;
+    emit opened();
+}
+
+void StreamProxyService::handleDisconnected()
+{
+    if (!m_opened)
+        emit failed("The connection to the device was lost");
+}
+
+void StreamProxyService::forwardToDevice()
+{
+    while (m_socket && m_stream && m_socket->bytesAvailable() > 0
+           && m_stream->bytesPending() < maxPendingToDevice) {
+        const QByteArray data = m_socket->read(chunkSize);
+        m_stream->write(StreamPacket{data});
+    }
+}
+
+void StreamProxyService::handleSocketBytesWritten()
+{
+    if (m_stream && m_stream->isPaused() && m_socket->bytesToWrite() <= lowWaterToClient)
+        m_stream->resume();
+}
+
+void StreamProxyService::handleSocketDisconnected()
+{
+    qCDebug(streamProxyC) << "Client of proxied stream disconnected";
+    if (m_stream) {
+        // Nobody reads the data any more, so the device may go on
+        m_stream->resume();
+        m_stream->requestClose();
+        m_stream = nullptr;
+    }
+    deleteLater();
+}
+
+void StreamProxyService::closeSocket()
+{
+    // Disconnecting waits for the data that is still to be written
+    m_socket->disconnectFromServer();
+    if (m_socket->state() == QLocalSocket::UnconnectedState)
+        handleSocketDisconnected();
+}
@@ -0,0 +1,90 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Debug Bridge.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+#ifndef STREAMPROXYSERVICE_H
+#define STREAMPROXYSERVICE_H
+
+#include "service.h"
+#include "trafficscheduler.h"
+class Connection;
+QT_BEGIN_NAMESPACE
+class QLocalSocket;
+QT_END_NAMESPACE
+
+#include <QtCore/qbytearray.h>
+
+#include <cstdint>
+#include <memory>
+
+// Splices a client socket to a device stream. Lives in the thread of the
+// connection, and the socket is moved there with attachSocket() once the
+// stream is open. Bytes are passed through as they are in both directions.
+class StreamProxyService : public Service
+{
+    Q_OBJECT
+public:
+    StreamProxyService(std::shared_ptr<Connection> connection, uint32_t tag,
+                       const QString &client, const TrafficClass &trafficClass,
+                       quint32 streamWeight);
+    ~StreamProxyService();
+
+    void initialize() override;
+
+signals:
+    void opened();
+    void failed(QString reason);
+
+public slots:
+    void receive(StreamPacket packet) override;
+    //! Takes ownership of the socket, which must already be in this thread
+    void attachSocket(QLocalSocket *socket);
+
+protected slots:
+    void onStreamClosed() override;
+
+private slots:
+    void handleOpened();
+    void handleDisconnected();
+    void forwardToDevice();
+    void handleSocketBytesWritten();
+    void handleSocketDisconnected();
+
+private:
+    void closeSocket();
+
+    std::shared_ptr<Connection> m_connection;
+    uint32_t m_tag;
+    QString m_client;
+    TrafficClass m_trafficClass;
+    quint32 m_streamWeight;
+    bool m_opened;
+    QLocalSocket *m_socket;
+    QByteArray m_earlyData;
+};
+
+#endif // STREAMPROXYSERVICE_H
@@ -28,10 +28,32 @@
 ****************************************************************************/
 #include "subnet.h"
 
+#include <QtCore/qalgorithms.h>
+#include <QtCore/qstringlist.h>
 #include <QtNetwork/qnetworkinterface.h>
 
+#include <algorithm>
+
 namespace {
 
+// Each device gets a /30: the host end, the device end and two unusable addresses
+const int devicePrefixLength = 30;
+const quint32 deviceSubnetSize = 1u << (32 - devicePrefixLength);
+// Keeps the bitmap of one range under 512 KiB
+const int minimumRangePrefixLength = 8;
+
+quint32 prefixMask(int prefixLength)
+{
+    return prefixLength == 0 ? 0 : ~quint32{0} << (32 - prefixLength);
+}
+
+bool isValidRange(const SubnetRange &range)
+{
+    return range.network.protocol() == QAbstractSocket::IPv4Protocol
+            && range.prefixLength >= minimumRangePrefixLength
+            && range.prefixLength <= devicePrefixLength;
+}
+
 std::vector<Subnet> fetchUsedSubnets()
 {
     std::vector<Subnet> subnets;
@@ -47,13 +69,21 @@ std::vector<Subnet> fetchUsedSubnets()
 SubnetReservation findUnusedSubnet()
 {
     SubnetPool *pool = SubnetPool::instance();
-    const std::vector<Subnet> usedSubnets = fetchUsedSubnets();
-    const std::pair<Subnet, bool> result = findUnusedSubnet(pool->candidates(),
-                                                            usedSubnets);
-    if (!result.second)
-        return SubnetReservation{};
+    if (const auto usedSubnets = pool->usedSubnets())
+        return pool->reserveUnused(*usedSubnets);
+    return pool->reserveUnused(fetchUsedSubnets());
+}
 
-    return pool->reserve(result.first);
+SubnetReservation findUnusedSubnet(const Subnet &preferred)
+{
+    SubnetPool *pool = SubnetPool::instance();
+    auto usedSubnets = pool->usedSubnets();
+    if (!usedSubnets)
+        usedSubnets = std::make_shared<AddressIntervals>(fetchUsedSubnets());
+
+    if (SubnetReservation reservation = pool->reserveIfUnused(preferred, *usedSubnets))
+        return reservation;
+    return pool->reserveUnused(*usedSubnets);
 }
 
 std::pair<Subnet, bool> findUnusedSubnet(const std::vector<Subnet> &candidateSubnets,
@@ -72,23 +102,142 @@ std::pair<Subnet, bool> findUnusedSubnet(const std::vector<Subnet> &candidateSub
     return std::make_pair(Subnet{}, false);
 }
 
+AddressIntervals::AddressIntervals(const std::vector<Subnet> &subnets)
+    : m_intervals{}
+{
+    for (const Subnet &subnet : subnets) {
+        bool isIPv4 = false;
+        const quint32 address = subnet.address.toIPv4Address(&isIPv4);
+        if (!isIPv4)
+            continue; // Device subnets are IPv4 only
+        const int prefixLength = subnet.prefixLength < 0 ? 32 : std::min(subnet.prefixLength, 32);
+        const quint32 first = address & prefixMask(prefixLength);
+        m_intervals.push_back({first, first | ~prefixMask(prefixLength)});
+    }
+    std::sort(m_intervals.begin(), m_intervals.end());
+
+    std::vector<Interval> merged;
+    for (const Interval &interval : m_intervals) {
+        // Adjacent intervals are merged too, so that skipping them takes one step
+        if (!merged.empty() && (interval.first <= merged.back().second
+                                || interval.first - 1 == merged.back().second))
+            merged.back().second = std::max(merged.back().second, interval.second);
+        else
+            merged.push_back(interval);
+    }
+    m_intervals.swap(merged);
+}
+
+bool AddressIntervals::overlaps(quint32 first, quint32 last, quint32 *end) const
+{
+    auto iter = std::upper_bound(m_intervals.begin(), m_intervals.end(), last,
+                                 [](quint32 address, const Interval &interval) {
+                                     return address < interval.first;
+                                 });
+    if (iter == m_intervals.begin())
+        return false;
+    --iter;
+    if (iter->second < first)
+        return false;
+    *end = iter->second;
+    return true;
+}
+
+bool parseSubnetRange(const QString &text, SubnetRange *range)
+{
+    const QStringList parts = text.split(QLatin1Char{'/'});
+    if (parts.size() != 2)
+        return false;
+
+    QHostAddress network;
+    bool ok = false;
+    const int prefixLength = parts[1].toInt(&ok);
+    if (!ok || !network.setAddress(parts[0]))
+        return false;
+
+    SubnetRange parsed{network, prefixLength};
+    if (!isValidRange(parsed))
+        return false;
+
+    parsed.network = QHostAddress{network.toIPv4Address() & prefixMask(prefixLength)};
+    *range = parsed;
+    return true;
+}
+
+SubnetPool::SubnetPool(const std::vector<SubnetRange> &ranges)
+    : m_lock{},
+      m_ranges{},
+      m_reservedCount{0},
+      m_externalReservations{},
+      m_usedSubnetsLock{},
+      m_usedSubnets{}
+{
+    setRanges(ranges);
+}
+
 SubnetPool *SubnetPool::instance()
 {
-    static SubnetPool pool;
+    static SubnetPool pool{defaultRanges()};
     return &pool;
 }
 
+std::vector<SubnetRange> SubnetPool::defaultRanges()
+{
+    // The networks of the old fixed candidates, so the first device keeps its address
+    std::vector<SubnetRange> ranges;
+    for (int i = 16; i <= 31; ++i)
+        ranges.push_back({QHostAddress{QString{"172.%1.58.0"}.arg(i)}, 24});
+    ranges.push_back({QHostAddress{"192.168.58.0"}, 24});
+    ranges.push_back({QHostAddress{"10.17.20.0"}, 24});
+    return ranges;
+}
+
+bool SubnetPool::setRanges(const std::vector<SubnetRange> &ranges)
+{
+    QMutexLocker locker{&m_lock};
+    if (m_reservedCount > 0 || !m_externalReservations.empty())
+        return false;
+
+    std::vector<Range> newRanges;
+    for (const SubnetRange &subnetRange : ranges) {
+        if (!isValidRange(subnetRange))
+            return false;
+
+        Range range;
+        range.first = subnetRange.network.toIPv4Address() & prefixMask(subnetRange.prefixLength);
+        range.subnetCount = 1u << (devicePrefixLength - subnetRange.prefixLength);
+        const quint32 last = range.first + (range.subnetCount * deviceSubnetSize - 1);
+        const bool overlapsOther = std::any_of(newRanges.begin(), newRanges.end(),
+                                               [&](const Range &other) {
+            const quint32 otherLast = other.first + (other.subnetCount * deviceSubnetSize - 1);
+            return range.first <= otherLast && other.first <= last;
+        });
+        if (overlapsOther)
+            return false;
+
+        range.reserved.resize((range.subnetCount + 63) / 64, 0);
+        // Bits past the end of a short range are never free
+        if (range.subnetCount % 64 != 0)
+            range.reserved.back() = ~quint64{0} << (range.subnetCount % 64);
+        newRanges.push_back(std::move(range));
+    }
+
+    m_ranges.swap(newRanges);
+    return true;
+}
+
 std::vector<Subnet> SubnetPool::candidates()
 {
     QMutexLocker locker{&m_lock};
     std::vector<Subnet> freeCandidates;
-    freeCandidates.reserve(m_candidates.size() - m_reserved.size());
-    std::copy_if(m_candidates.begin(), m_candidates.end(),
-                 std::back_inserter(freeCandidates),
-                 [&](const Subnet &subnet) {
-                     return std::find(m_reserved.begin(), m_reserved.end(), subnet)
-                             == m_reserved.end();
-                 });
+    for (const Range &range : m_ranges) {
+        for (quint32 index = 0; index < range.subnetCount; ++index) {
+            if (range.reserved[index / 64] & (quint64{1} << (index % 64)))
+                continue;
+            const quint32 address = range.first + index * deviceSubnetSize + 1;
+            freeCandidates.push_back(Subnet{QHostAddress{address}, devicePrefixLength});
+        }
+    }
     return freeCandidates;
 }
 
@@ -96,47 +245,156 @@ SubnetReservation SubnetPool::reserve(const Subnet &subnet)
 {
     QMutexLocker locker{&m_lock};
 
-    const auto iter = std::find(m_reserved.begin(), m_reserved.end(), subnet);
-    if (iter != m_reserved.end()) // Already reserved
+    Range *range = nullptr;
+    quint32 index = 0;
+    if (findSubnet(subnet, &range, &index)) {
+        quint64 &word = range->reserved[index / 64];
+        const quint64 bit = quint64{1} << (index % 64);
+        if (word & bit) // Already reserved
+            return SubnetReservation{};
+        word |= bit;
+        ++m_reservedCount;
+        return std::make_shared<SubnetReservationImpl>(subnet, this);
+    }
+
+    const auto iter = std::find(m_externalReservations.begin(), m_externalReservations.end(),
+                                subnet);
+    if (iter != m_externalReservations.end()) // Already reserved
+        return SubnetReservation{};
+
+    m_externalReservations.push_back(subnet);
+    return std::make_shared<SubnetReservationImpl>(subnet, this);
+}
+
+SubnetReservation SubnetPool::reserveUnused(const std::vector<Subnet> &usedSubnets)
+{
+    return reserveUnused(AddressIntervals{usedSubnets});
+}
+
+SubnetReservation SubnetPool::reserveUnused(const AddressIntervals &used)
+{
+    QMutexLocker locker{&m_lock};
+    for (Range &range : m_ranges) {
+        quint32 index = 0;
+        while (index < range.subnetCount) {
+            const quint32 wordIndex = index / 64;
+            const quint64 freeBits = ~range.reserved[wordIndex] & (~quint64{0} << (index % 64));
+            if (freeBits == 0) {
+                index = (wordIndex + 1) * 64;
+                continue;
+            }
+            index = wordIndex * 64 + qCountTrailingZeroBits(freeBits);
+            if (index >= range.subnetCount)
+                break;
+
+            const quint32 first = range.first + index * deviceSubnetSize;
+            quint32 usedEnd = 0;
+            if (used.overlaps(first, first + deviceSubnetSize - 1, &usedEnd)) {
+                // Skip every subnet covered by the used interval at once
+                const quint32 last = range.first + (range.subnetCount * deviceSubnetSize - 1);
+                if (usedEnd >= last)
+                    break;
+                index = (usedEnd - range.first) / deviceSubnetSize + 1;
+                continue;
+            }
+
+            return take(&range, index);
+        }
+    }
+    return SubnetReservation{};
+}
+
+SubnetReservation SubnetPool::reserveIfUnused(const Subnet &subnet,
+                                              const AddressIntervals &usedSubnets)
+{
+    QMutexLocker locker{&m_lock};
+
+    Range *range = nullptr;
+    quint32 index = 0;
+    if (!findSubnet(subnet, &range, &index))
+        return SubnetReservation{};
+    if (range->reserved[index / 64] & (quint64{1} << (index % 64)))
+        return SubnetReservation{};
+
+    const quint32 first = range->first + index * deviceSubnetSize;
+    quint32 usedEnd = 0;
+    if (usedSubnets.overlaps(first, first + deviceSubnetSize - 1, &usedEnd))
         return SubnetReservation{};
 
-    m_reserved.push_back(subnet);
-    return std::make_shared<SubnetReservationImpl>(subnet);
+    return take(range, index);
 }
 
 void SubnetPool::free(const Subnet &subnet)
 {
     QMutexLocker locker{&m_lock};
 
-    const auto iter = std::find(m_reserved.begin(), m_reserved.end(), subnet);
-    if (iter != m_reserved.end())
-        m_reserved.erase(iter);
+    Range *range = nullptr;
+    quint32 index = 0;
+    if (findSubnet(subnet, &range, &index)) {
+        quint64 &word = range->reserved[index / 64];
+        const quint64 bit = quint64{1} << (index % 64);
+        if (word & bit) {
+            word &= ~bit;
+            --m_reservedCount;
+        }
+        return;
+    }
+
+    const auto iter = std::find(m_externalReservations.begin(), m_externalReservations.end(),
+                                subnet);
+    if (iter != m_externalReservations.end())
+        m_externalReservations.erase(iter);
 }
 
-SubnetPool::SubnetPool()
-    : m_lock{},
-      m_candidates(),
-      m_reserved{}
-{
-    // MSVC 2013 gave error C2707 when trying to use initializer list for m_candidates
-    m_candidates.push_back({QHostAddress{"172.16.58.1"}, 30});
-    m_candidates.push_back({QHostAddress{"172.17.58.1"}, 30});
-    m_candidates.push_back({QHostAddress{"172.18.58.1"}, 30});
-    m_candidates.push_back({QHostAddress{"172.19.58.1"}, 30});
-    m_candidates.push_back({QHostAddress{"172.20.58.1"}, 30});
-    m_candidates.push_back({QHostAddress{"172.21.58.1"}, 30});
-    m_candidates.push_back({QHostAddress{"172.22.58.1"}, 30});
-    m_candidates.push_back({QHostAddress{"172.23.58.1"}, 30});
-    m_candidates.push_back({QHostAddress{"172.24.58.1"}, 30});
-    m_candidates.push_back({QHostAddress{"172.25.58.1"}, 30});
-    m_candidates.push_back({QHostAddress{"172.26.58.1"}, 30});
-    m_candidates.push_back({QHostAddress{"172.27.58.1"}, 30});
-    m_candidates.push_back({QHostAddress{"172.28.58.1"}, 30});
-    m_candidates.push_back({QHostAddress{"172.29.58.1"}, 30});
-    m_candidates.push_back({QHostAddress{"172.30.58.1"}, 30});
-    m_candidates.push_back({QHostAddress{"172.31.58.1"}, 30});
-    m_candidates.push_back({QHostAddress{"192.168.58.1"}, 30});
-    m_candidates.push_back({QHostAddress{"10.17.20.1"}, 30});
+std::shared_ptr<const AddressIntervals> SubnetPool::usedSubnets() const
+{
+    QMutexLocker locker{&m_usedSubnetsLock};
+    return m_usedSubnets;
+}
+
+void SubnetPool::setUsedSubnets(const std::vector<Subnet> &usedSubnets)
+{
+    std::shared_ptr<const AddressIntervals> intervals = std::make_shared<AddressIntervals>(usedSubnets);
+    // The previous intervals are released after unlocking
+    QMutexLocker locker{&m_usedSubnetsLock};
+    m_usedSubnets.swap(intervals);
+}
+
+void SubnetPool::clearUsedSubnets()
+{
+    std::shared_ptr<const AddressIntervals> intervals;
+    QMutexLocker locker{&m_usedSubnetsLock};
+    m_usedSubnets.swap(intervals);
+}
+
+bool SubnetPool::findSubnet(const Subnet &subnet, Range **range, quint32 *index)
+{
+    if (subnet.prefixLength != devicePrefixLength)
+        return false;
+    bool isIPv4 = false;
+    const quint32 address = subnet.address.toIPv4Address(&isIPv4);
+    if (!isIPv4)
+        return false;
+
+    // There are only a few ranges, the lookup within one is constant time
+    for (Range &candidate : m_ranges) {
+        const quint32 offset = address - candidate.first;
+        if (address >= candidate.first && offset / deviceSubnetSize < candidate.subnetCount) {
+            *range = &candidate;
+            *index = offset / deviceSubnetSize;
+            return true;
+        }
+    }
+    return false;
+}
+
+SubnetReservation SubnetPool::take(Range *range, quint32 index)
+{
+    range->reserved[index / 64] |= quint64{1} << (index % 64);
+    ++m_reservedCount;
+    const quint32 address = range->first + index * deviceSubnetSize + 1;
+    const Subnet subnet{QHostAddress{address}, devicePrefixLength};
+    return std::make_shared<SubnetReservationImpl>(subnet, this);
 }
 
 bool operator==(const Subnet &lhs, const Subnet &rhs)
@@ -145,15 +403,22 @@ bool operator==(const Subnet &lhs, const Subnet &rhs)
             && lhs.prefixLength == rhs.prefixLength;
 }
 
-SubnetReservationImpl::SubnetReservationImpl(const Subnet &subnet)
-    : m_subnet(subnet) // uniform initialization with {} fails in MSVC 2013 with error C2797
+bool operator==(const SubnetRange &lhs, const SubnetRange &rhs)
+{
+    return lhs.network == rhs.network
+            && lhs.prefixLength == rhs.prefixLength;
+}
+
+SubnetReservationImpl::SubnetReservationImpl(const Subnet &subnet, SubnetPool *pool)
+    : m_subnet(subnet), // uniform initialization with {} fails in MSVC 2013 with error C2797
+      m_pool{pool}
 {
 
 }
 
 SubnetReservationImpl::~SubnetReservationImpl()
 {
-    SubnetPool::instance()->free(m_subnet);
+    m_pool->free(m_subnet);
 }
 
 Subnet SubnetReservationImpl::subnet() const
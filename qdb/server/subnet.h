@@ -33,6 +33,7 @@
 #include <QtNetwork/qhostaddress.h>
 
 #include <memory>
+#include <vector>
 
 struct Subnet
 {
@@ -43,16 +44,46 @@ Q_DECLARE_METATYPE(Subnet)
 
 bool operator==(const Subnet &lhs, const Subnet &rhs);
 
+// IPv4 network that is carved into /30 subnets for devices
+struct SubnetRange
+{
+    QHostAddress network;
+    int prefixLength;
+};
+Q_DECLARE_METATYPE(SubnetRange)
+
+bool operator==(const SubnetRange &lhs, const SubnetRange &rhs);
+// Parses "<address>/<prefix length>", for example "172.16.0.0/16"
+bool parseSubnetRange(const QString &text, SubnetRange *range);
+
+// Sorted and merged IPv4 address intervals for logarithmic overlap checks
+class AddressIntervals
+{
+public:
+    explicit AddressIntervals(const std::vector<Subnet> &subnets);
+
+    //! Whether [first, last] overlaps an interval and if so, where that ends
+    bool overlaps(quint32 first, quint32 last, quint32 *end) const;
+
+private:
+    using Interval = std::pair<quint32, quint32>;
+
+    std::vector<Interval> m_intervals;
+};
+
+class SubnetPool;
+
 class SubnetReservationImpl
 {
 public:
-    SubnetReservationImpl(const Subnet &subnet);
+    SubnetReservationImpl(const Subnet &subnet, SubnetPool *pool);
     ~SubnetReservationImpl();
 
     Subnet subnet() const;
 
 private:
     Subnet m_subnet;
+    SubnetPool *m_pool;
 };
 
 using SubnetReservation = std::shared_ptr<SubnetReservationImpl>;
@@ -60,22 +91,55 @@ using SubnetReservation = std::shared_ptr<SubnetReservationImpl>;
 class SubnetPool
 {
 public:
+    explicit SubnetPool(const std::vector<SubnetRange> &ranges);
+
     static SubnetPool *instance();
+    static std::vector<SubnetRange> defaultRanges();
+
+    // Fails if a range is invalid or subnets are already reserved
+    bool setRanges(const std::vector<SubnetRange> &ranges);
 
+    // Lists every free subnet, so this is linear in the size of the pool
     std::vector<Subnet> candidates();
     SubnetReservation reserve(const Subnet &subnet);
+    // Reserves the first free subnet that does not overlap the used ones
+    SubnetReservation reserveUnused(const std::vector<Subnet> &usedSubnets);
+    SubnetReservation reserveUnused(const AddressIntervals &usedSubnets);
+    // Reserves the subnet only if it is in the ranges, free and not used
+    SubnetReservation reserveIfUnused(const Subnet &subnet, const AddressIntervals &usedSubnets);
     void free(const Subnet &subnet);
 
+    // Subnets of the host's interfaces as followed by a monitor. Without
+    // them, the interfaces are enumerated for every reservation.
+    std::shared_ptr<const AddressIntervals> usedSubnets() const;
+    void setUsedSubnets(const std::vector<Subnet> &usedSubnets);
+    void clearUsedSubnets();
+
 private:
-    SubnetPool();
-    SubnetPool(const std::vector<Subnet> &subnet);
+    struct Range
+    {
+        quint32 first;
+        quint32 subnetCount;
+        std::vector<quint64> reserved; // A bit per subnet
+    };
+
+    bool findSubnet(const Subnet &subnet, Range **range, quint32 *index);
+    SubnetReservation take(Range *range, quint32 index);
 
     QMutex m_lock;
-    std::vector<Subnet> m_candidates;
-    std::vector<Subnet> m_reserved;
+    std::vector<Range> m_ranges;
+    size_t m_reservedCount;
+    // Subnets reserved outside of the ranges, e.g. already set on a device
+    std::vector<Subnet> m_externalReservations;
+    // Only held to copy or swap the pointer, so reservations don't wait for
+    // the intervals to be built
+    mutable QMutex m_usedSubnetsLock;
+    std::shared_ptr<const AddressIntervals> m_usedSubnets;
 };
 
 SubnetReservation findUnusedSubnet();
+//! Prefers the given subnet, e.g. the one a device had before
+SubnetReservation findUnusedSubnet(const Subnet &preferred);
 std::pair<Subnet, bool> findUnusedSubnet(const std::vector<Subnet> &candidateSubnets,
                                          const std::vector<Subnet> &usedSubnets);
 
@@ -0,0 +1,204 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Debug Bridge.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+#include "subnetcache.h"
+
+#include <QtCore/qdatetime.h>
+#include <QtCore/qdebug.h>
+#include <QtCore/qdir.h>
+#include <QtCore/qfile.h>
+#include <QtCore/qfileinfo.h>
+#include <QtCore/qjsondocument.h>
+#include <QtCore/qjsonobject.h>
+#include <QtCore/qloggingcategory.h>
+#include <QtCore/qsavefile.h>
+#include <QtCore/qstandardpaths.h>
+#include <QtCore/qstringlist.h>
+
+#include <algorithm>
+
+Q_LOGGING_CATEGORY(subnetCacheC, "qdb.subnetcache");
+
+namespace {
+
+const int cacheVersion = 1;
+// Devices that have not been seen for longest are dropped beyond this
+const int maxEntries = 1024;
+
+QString subnetToString(const Subnet &subnet)
+{
+    return QString{"%1/%2"}.arg(subnet.address.toString()).arg(subnet.prefixLength);
+}
+
+bool subnetFromString(const QString &text, Subnet *subnet)
+{
+    const QStringList parts = text.split(QLatin1Char{'/'});
+    if (parts.size() != 2)
+        return false;
+
+    bool ok = false;
+    const QHostAddress address{parts[0]};
+    const int prefixLength = parts[1].toInt(&ok);
+    if (!ok || address.isNull() || prefixLength < 1 || prefixLength > 32)
+        return false;
+
+    *subnet = Subnet{address, prefixLength};
+    return true;
+}
+
+} // anonymous namespace
+
+SubnetCache::SubnetCache()
+    : m_lock{},
+      m_path{},
+      m_entries{}
+{
+
+}
+
+SubnetCache *SubnetCache::instance()
+{
+    static SubnetCache cache;
+    return &cache;
+}
+
+bool SubnetCache::load(const QString &path)
+{
+    QMutexLocker locker{&m_lock};
+    m_path = path;
+    m_entries.clear();
+
+    QFile file{path};
+    if (!file.exists())
+        return true;
+    if (!file.open(QIODevice::ReadOnly)) {
+        qCWarning(subnetCacheC) << "Could not open subnet cache" << path << ":" << file.errorString();
+        return false;
+    }
+
+    QJsonParseError error;
+    const QJsonDocument document = QJsonDocument::fromJson(file.readAll(), &error);
+    if (error.error != QJsonParseError::NoError || !document.isObject()) {
+        qCWarning(subnetCacheC) << "Ignoring invalid subnet cache" << path << ":" << error.errorString();
+        return false;
+    }
+
+    const QJsonObject root = document.object();
+    if (root["version"].toInt() != cacheVersion) {
+        qCWarning(subnetCacheC) << "Ignoring subnet cache" << path << "of unknown version"
+                                << root["version"].toInt();
+        return false;
+    }
+
+    const QJsonObject devices = root["devices"].toObject();
+    for (auto iter = devices.constBegin(); iter != devices.constEnd(); ++iter) {
+        const QJsonObject device = iter.value().toObject();
+        Entry entry;
+        if (!subnetFromString(device["subnet"].toString(), &entry.subnet))
+            continue;
+        entry.lastUsed = device["used"].toInteger();
+        m_entries[iter.key()] = entry;
+    }
+    qCDebug(subnetCacheC) << "Loaded" << m_entries.size() << "cached subnets from" << path;
+    return true;
+}
+
+std::pair<Subnet, bool> SubnetCache::lookup(const QString &serial)
+{
+    QMutexLocker locker{&m_lock};
+    const auto iter = m_entries.constFind(serial);
+    if (iter == m_entries.constEnd())
+        return std::make_pair(Subnet{}, false);
+    return std::make_pair(iter->subnet, true);
+}
+
+void SubnetCache::remember(const QString &serial, const Subnet &subnet)
+{
+    QMutexLocker locker{&m_lock};
+    Entry &entry = m_entries[serial];
+    // Only the changes of subnets are saved, not every time a device is seen
+    const bool changed = !(entry.subnet == subnet);
+    entry.subnet = subnet;
+    entry.lastUsed = QDateTime::currentMSecsSinceEpoch();
+    if (!changed)
+        return;
+
+    evict();
+    save();
+}
+
+void SubnetCache::forget(const QString &serial)
+{
+    QMutexLocker locker{&m_lock};
+    if (m_entries.remove(serial) > 0)
+        save();
+}
+
+void SubnetCache::evict()
+{
+    while (m_entries.size() > maxEntries) {
+        const auto oldest = std::min_element(m_entries.begin(), m_entries.end(),
+                                             [](const Entry &lhs, const Entry &rhs) {
+                                                 return lhs.lastUsed < rhs.lastUsed;
+                                             });
+        m_entries.erase(oldest);
+    }
+}
+
+bool SubnetCache::save()
+{
+    if (m_path.isEmpty())
+        return true;
+
+    QJsonObject devices;
+    for (auto iter = m_entries.constBegin(); iter != m_entries.constEnd(); ++iter) {
+        QJsonObject device;
+        device["subnet"] = subnetToString(iter->subnet);
+        device["used"] = iter->lastUsed;
+        devices[iter.key()] = device;
+    }
+    QJsonObject root;
+    root["version"] = cacheVersion;
+    root["devices"] = devices;
+
+    QDir{}.mkpath(QFileInfo{m_path}.path());
+    // Written to a temporary file first, so a crash never leaves half a cache
+    QSaveFile file{m_path};
+    if (!file.open(QIODevice::WriteOnly)
+            || file.write(QJsonDocument{root}.toJson(QJsonDocument::Compact)) < 0
+            || !file.commit()) {
+        qCWarning(subnetCacheC) << "Could not save subnet cache" << m_path << ":" << file.errorString();
+        return false;
+    }
+    return true;
+}
+
+QString subnetCacheFilePath()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/subnets.json";
+}
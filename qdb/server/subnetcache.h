@@ -0,0 +1,74 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Debug Bridge.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+#ifndef SUBNETCACHE_H
+#define SUBNETCACHE_H
+
+#include "subnet.h"
+
+#include <QtCore/qhash.h>
+#include <QtCore/qmutex.h>
+#include <QtCore/qstring.h>
+
+#include <utility>
+
+// Remembers the subnet each device was last configured with, so that a
+// replugged device or a restarted server can offer the device the same
+// subnet again.
+class SubnetCache
+{
+public:
+    SubnetCache();
+
+    static SubnetCache *instance();
+
+    //! Load the cache from a file and save each change to it
+    bool load(const QString &path);
+
+    std::pair<Subnet, bool> lookup(const QString &serial);
+    void remember(const QString &serial, const Subnet &subnet);
+    void forget(const QString &serial);
+
+private:
+    struct Entry
+    {
+        Subnet subnet{QHostAddress{}, 0};
+        qint64 lastUsed{0}; // ms since epoch
+    };
+
+    void evict();
+    bool save();
+
+    QMutex m_lock;
+    QString m_path;
+    QHash<QString, Entry> m_entries;
+};
+
+QString subnetCacheFilePath();
+
+#endif // SUBNETCACHE_H
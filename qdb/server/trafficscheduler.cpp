@@ -0,0 +1,309 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Debug Bridge.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+#include "trafficscheduler.h"
+
+#include "libqdb/protocol/protocol.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+// Bytes a client of weight 1 may send per round
+const qint64 quantum = qdbMessageSize;
+
+qint64 burstSize(const TrafficClass &trafficClass)
+{
+    // At least a full message must fit, or a client could never send one
+    return std::max<qint64>(trafficClass.bytesPerSecond, qdbMessageSize);
+}
+
+} // anonymous namespace
+
+TrafficScheduler::TrafficScheduler()
+    : m_lock{},
+      m_flows{},
+      m_clients{},
+      m_activeClients{}
+{
+
+}
+
+void TrafficScheduler::setTrafficClass(StreamId id, const QString &client,
+                                       const TrafficClass &trafficClass)
+{
+    QMutexLocker locker{&m_lock};
+    Flow &streamFlow = flow(id);
+    if (streamFlow.client != client) {
+        detach(id, streamFlow);
+        Client &previous = m_clients[streamFlow.client];
+        if (--previous.streamCount == 0)
+            m_clients.erase(streamFlow.client);
+
+        streamFlow.client = client;
+        ++clientShare(client).streamCount;
+        attach(id, streamFlow);
+    }
+
+    applyTrafficClass(clientShare(client), trafficClass);
+}
+
+void TrafficScheduler::setClientTrafficClass(const QString &client, const TrafficClass &trafficClass)
+{
+    QMutexLocker locker{&m_lock};
+    const auto iter = m_clients.find(client);
+    if (iter == m_clients.end())
+        return; // No streams of the client on this connection
+
+    applyTrafficClass(iter->second, trafficClass);
+}
+
+void TrafficScheduler::setStreamWeight(StreamId id, quint32 weight)
+{
+    QMutexLocker locker{&m_lock};
+    flow(id).weight = std::max<quint32>(weight, 1);
+}
+
+void TrafficScheduler::enqueue(const QdbMessage &message)
+{
+    QMutexLocker locker{&m_lock};
+    Flow &streamFlow = flow(message.hostStream());
+    streamFlow.queue.enqueue(message);
+    streamFlow.bytesQueued += message.data().size();
+    if (streamFlow.queue.size() == 1)
+        attach(message.hostStream(), streamFlow);
+}
+
+bool TrafficScheduler::isEmpty() const
+{
+    QMutexLocker locker{&m_lock};
+    return m_activeClients.empty();
+}
+
+bool TrafficScheduler::dequeue(QdbMessage *message, int *retryAfter)
+{
+    QMutexLocker locker{&m_lock};
+    *retryAfter = -1;
+
+    // Clients held back by their rate in a row, the round is over once all are
+    size_t heldBack = 0;
+    qint64 shortestWait = std::numeric_limits<qint64>::max();
+    while (!m_activeClients.empty() && heldBack < m_activeClients.size()) {
+        const QString name = m_activeClients.front();
+        Client &streamClient = m_clients[name];
+        pickFlow(streamClient);
+        const StreamId id = streamClient.activeFlows.front();
+        Flow &streamFlow = m_flows[id];
+        const qint64 size = streamFlow.queue.head().data().size();
+
+        if (streamClient.trafficClass.bytesPerSecond > 0) {
+            refill(streamClient);
+            if (streamClient.tokens < size) {
+                const qint64 missing = size - streamClient.tokens;
+                shortestWait = std::min(shortestWait,
+                                        missing * 1000 / streamClient.trafficClass.bytesPerSecond + 1);
+                ++heldBack;
+                m_activeClients.pop_front();
+                m_activeClients.push_back(name);
+                continue;
+            }
+        }
+
+        if (streamClient.deficit < size) {
+            streamClient.deficit += quantum * std::max<quint32>(streamClient.trafficClass.weight, 1);
+            heldBack = 0;
+            m_activeClients.pop_front();
+            m_activeClients.push_back(name);
+            continue;
+        }
+
+        *message = streamFlow.queue.dequeue();
+        streamClient.deficit -= size;
+        streamFlow.deficit -= size;
+        streamFlow.bytesSent += size;
+        streamFlow.bytesQueued -= size;
+        if (streamClient.trafficClass.bytesPerSecond > 0)
+            streamClient.tokens -= size;
+
+        // The stream keeps its turn within the client while its deficit lasts
+        if (streamFlow.queue.isEmpty()) {
+            // Idle streams do not save up a deficit either
+            streamFlow.deficit = 0;
+            streamClient.activeFlows.pop_front();
+        } else if (streamFlow.deficit < streamFlow.queue.head().data().size()) {
+            streamClient.activeFlows.pop_front();
+            streamClient.activeFlows.push_back(id);
+        }
+        if (streamClient.activeFlows.empty()) {
+            // Idle clients do not save up a deficit
+            streamClient.deficit = 0;
+            m_activeClients.pop_front();
+        }
+        return true;
+    }
+
+    if (!m_activeClients.empty())
+        *retryAfter = static_cast<int>(std::min<qint64>(shortestWait, std::numeric_limits<int>::max()));
+    return false;
+}
+
+void TrafficScheduler::recordReceived(StreamId id, qint64 bytes)
+{
+    QMutexLocker locker{&m_lock};
+    flow(id).bytesReceived += bytes;
+}
+
+void TrafficScheduler::removeStream(StreamId id)
+{
+    QMutexLocker locker{&m_lock};
+    const auto iter = m_flows.find(id);
+    if (iter == m_flows.end())
+        return;
+
+    Flow &streamFlow = iter->second;
+    detach(id, streamFlow);
+    Client &streamClient = m_clients[streamFlow.client];
+    if (--streamClient.streamCount == 0)
+        m_clients.erase(streamFlow.client);
+    m_flows.erase(iter);
+}
+
+void TrafficScheduler::clear()
+{
+    QMutexLocker locker{&m_lock};
+    m_flows.clear();
+    m_clients.clear();
+    m_activeClients.clear();
+}
+
+std::vector<StreamStatistics> TrafficScheduler::statistics() const
+{
+    QMutexLocker locker{&m_lock};
+    std::vector<StreamStatistics> result;
+    for (const auto &pair : m_flows) {
+        const Flow &streamFlow = pair.second;
+        const Client &streamClient = m_clients.at(streamFlow.client);
+        result.push_back(StreamStatistics{pair.first, streamFlow.client, streamClient.trafficClass,
+                                          streamFlow.weight, streamFlow.bytesSent, streamFlow.bytesReceived,
+                                          streamFlow.bytesQueued});
+    }
+    return result;
+}
+
+TrafficScheduler::Flow &TrafficScheduler::flow(StreamId id)
+{
+    auto iter = m_flows.find(id);
+    if (iter == m_flows.end()) {
+        iter = m_flows.emplace(id, Flow{}).first;
+        ++clientShare(QString{}).streamCount;
+    }
+    return iter->second;
+}
+
+TrafficScheduler::Client &TrafficScheduler::clientShare(const QString &name)
+{
+    auto iter = m_clients.find(name);
+    if (iter == m_clients.end()) {
+        iter = m_clients.emplace(name, Client{}).first;
+        iter->second.refillTimer.start();
+    }
+    return iter->second;
+}
+
+void TrafficScheduler::attach(StreamId id, Flow &flow)
+{
+    if (flow.queue.isEmpty())
+        return;
+
+    Client &streamClient = clientShare(flow.client);
+    if (streamClient.activeFlows.empty())
+        m_activeClients.push_back(flow.client);
+    streamClient.activeFlows.push_back(id);
+}
+
+void TrafficScheduler::detach(StreamId id, Flow &flow)
+{
+    const auto iter = m_clients.find(flow.client);
+    if (iter == m_clients.end())
+        return;
+
+    Client &streamClient = iter->second;
+    auto &flows = streamClient.activeFlows;
+    flows.erase(std::remove(flows.begin(), flows.end(), id), flows.end());
+    flow.deficit = 0;
+    if (flows.empty()) {
+        streamClient.deficit = 0;
+        m_activeClients.erase(std::remove(m_activeClients.begin(), m_activeClients.end(),
+                                          flow.client),
+                              m_activeClients.end());
+    }
+}
+
+void TrafficScheduler::pickFlow(Client &client)
+{
+    // A stream that comes to the front starts its turn with another quantum,
+    // unless it is still in its turn because the client was held back
+    forever {
+        const StreamId id = client.activeFlows.front();
+        Flow &streamFlow = m_flows[id];
+        const qint64 size = streamFlow.queue.head().data().size();
+        if (streamFlow.deficit >= size)
+            return;
+        streamFlow.deficit += quantum * streamFlow.weight;
+        if (streamFlow.deficit >= size)
+            return;
+        client.activeFlows.pop_front();
+        client.activeFlows.push_back(id);
+    }
+}
+
+void TrafficScheduler::refill(Client &client)
+{
+    const double elapsed = client.refillTimer.nsecsElapsed() / 1e9;
+    const auto gained = static_cast<qint64>(elapsed * client.trafficClass.bytesPerSecond);
+    // Keep the time of a partial byte for the next refill
+    if (gained == 0)
+        return;
+    client.refillTimer.restart();
+    client.tokens = std::min(client.tokens + gained, burstSize(client.trafficClass));
+}
+
+void TrafficScheduler::applyTrafficClass(Client &client, const TrafficClass &trafficClass)
+{
+    // Tokens gained so far count at the old rate
+    refill(client);
+    if (client.trafficClass.bytesPerSecond == 0 && trafficClass.bytesPerSecond > 0) {
+        // A client that becomes rate limited, also a new one, may send a
+        // burst right away instead of waiting for its bucket to fill
+        client.tokens = burstSize(trafficClass);
+        client.refillTimer.restart();
+    }
+    client.trafficClass = trafficClass;
+    client.tokens = std::min(client.tokens, burstSize(trafficClass));
+}
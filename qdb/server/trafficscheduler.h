@@ -0,0 +1,133 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Debug Bridge.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+#ifndef TRAFFICSCHEDULER_H
+#define TRAFFICSCHEDULER_H
+
+#include "libqdb/protocol/qdbmessage.h"
+
+#include <QtCore/qelapsedtimer.h>
+#include <QtCore/qmutex.h>
+#include <QtCore/qqueue.h>
+#include <QtCore/qstring.h>
+
+#include <deque>
+#include <map>
+#include <vector>
+
+struct TrafficClass
+{
+    quint32 weight = 1;
+    qint64 bytesPerSecond = 0; // 0 for no limit
+};
+
+struct StreamStatistics
+{
+    StreamId hostStream;
+    QString client;
+    TrafficClass trafficClass;
+    quint32 streamWeight;
+    quint64 bytesSent;
+    quint64 bytesReceived;
+    qint64 bytesQueued;
+};
+
+// Orders the messages of streams to a device with two levels of deficit round
+// robin. Each client gets bandwidth in proportion to its weight and is held to
+// its byte rate, however many streams it opens; the streams of a client share
+// its bandwidth in proportion to their own weights. Streams not assigned to a
+// client share the unnamed client. Messages of a single stream keep their
+// order. All methods are thread-safe, so that statistics can be read from
+// outside the thread of the connection.
+class TrafficScheduler
+{
+public:
+    TrafficScheduler();
+
+    //! Assigns the stream to the client and sets the class of the client
+    void setTrafficClass(StreamId id, const QString &client, const TrafficClass &trafficClass);
+    //! Changes the class shared by the streams of the client
+    void setClientTrafficClass(const QString &client, const TrafficClass &trafficClass);
+    //! Sets the share of the stream within its client, 1 by default
+    void setStreamWeight(StreamId id, quint32 weight);
+    void enqueue(const QdbMessage &message);
+    bool isEmpty() const;
+    /*!
+     * Takes the next message to send. Returns false if nothing can be sent,
+     * in which case retryAfter is set to the milliseconds until a client held
+     * back by its byte rate may send again, or -1 if nothing is queued.
+     */
+    bool dequeue(QdbMessage *message, int *retryAfter);
+    void recordReceived(StreamId id, qint64 bytes);
+    //! Drops the queued messages of the stream and forgets it
+    void removeStream(StreamId id);
+    void clear();
+    std::vector<StreamStatistics> statistics() const;
+
+private:
+    struct Flow
+    {
+        QString client;
+        quint32 weight = 1;
+        qint64 deficit = 0;
+        QQueue<QdbMessage> queue;
+        quint64 bytesSent = 0;
+        quint64 bytesReceived = 0;
+        qint64 bytesQueued = 0;
+    };
+
+    struct Client
+    {
+        TrafficClass trafficClass;
+        qint64 deficit = 0;
+        qint64 tokens = 0;
+        QElapsedTimer refillTimer;
+        int streamCount = 0;
+        // Streams of the client with queued messages in their round robin order
+        std::deque<StreamId> activeFlows;
+    };
+
+    Flow &flow(StreamId id);
+    Client &clientShare(const QString &name);
+    //! Moves the first stream of the client that has enough deficit to the front
+    void pickFlow(Client &client);
+    //! Adds the stream to the round robin of its client, if it has messages queued
+    void attach(StreamId id, Flow &flow);
+    //! Takes the stream out of the round robin of its client
+    void detach(StreamId id, Flow &flow);
+    void refill(Client &client);
+    void applyTrafficClass(Client &client, const TrafficClass &trafficClass);
+
+    mutable QMutex m_lock;
+    std::map<StreamId, Flow> m_flows;
+    std::map<QString, Client> m_clients;
+    // Clients with queued messages in their round robin order
+    std::deque<QString> m_activeClients;
+};
+
+#endif // TRAFFICSCHEDULER_H
@@ -32,6 +32,7 @@
 #include "../subnet.h"
 #include "usbcommon.h"
 
+#include <QtCore/qmetatype.h>
 #include <QtCore/qstring.h>
 
 #include <cstdint>
@@ -74,5 +75,6 @@ struct UsbDevice
     UsbInterfaceInfo interfaceInfo;
     SubnetReservation reservation;
 };
+Q_DECLARE_METATYPE(UsbDevice)
 
 #endif // USBDEVICE_H
@@ -29,14 +29,14 @@
 #ifndef USBDEVICEENUMERATOR_H
 #define USBDEVICEENUMERATOR_H
 
+#include "../deviceenumerator.h"
 #include "usbdevice.h"
 
-#include <QtCore/qobject.h>
 #include <QtCore/qtimer.h>
 
 #include <vector>
 
-class UsbDeviceEnumerator : public QObject
+class UsbDeviceEnumerator : public DeviceEnumerator
 {
     Q_OBJECT
 public:
@@ -44,12 +44,8 @@ public:
     ~UsbDeviceEnumerator();
 
     std::vector<UsbDevice> listUsbDevices();
-    void startMonitoring();
-    void stopMonitoring();
-
-signals:
-    void devicePluggedIn(UsbDevice device);
-    void deviceUnplugged(UsbAddress address);
+    void startMonitoring() override;
+    void stopMonitoring() override;
 
 private:
     void pollQdbDevices();
@@ -0,0 +1,122 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Debug Bridge.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+#include "tracedump.h"
+
+#include "libqdb/protocol/qdbmessage.h"
+#include "libqdb/tracering.h"
+#include "server/connection.h"
+
+#include <QtCore/qdatetime.h>
+#include <QtCore/qdebug.h>
+#include <QtCore/qstandardpaths.h>
+
+#include <iostream>
+
+namespace {
+
+QString commandName(quint32 command)
+{
+    QString name;
+    {
+        QDebug debug{&name};
+        debug.nospace() << static_cast<QdbMessage::CommandType>(command);
+    }
+    return name;
+}
+
+QString stateName(quint32 state)
+{
+    switch (static_cast<ConnectionState>(state)) {
+    case ConnectionState::Disconnected:
+        return "Disconnected";
+    case ConnectionState::WaitingForConnection:
+        return "WaitingForConnection";
+    case ConnectionState::Connected:
+        return "Connected";
+    case ConnectionState::Waiting:
+        return "Waiting";
+    }
+    return QString::number(state);
+}
+
+QString describe(const TraceRecord &record)
+{
+    const auto &arguments = record.arguments;
+    switch (static_cast<TraceEvent>(record.event)) {
+    case TraceEvent::Started:
+        return QString{"Started process %1"}.arg(arguments[0]);
+    case TraceEvent::MessageSent:
+        return QString{"TX %1 host %2 device %3 size %4"}.arg(commandName(arguments[0]))
+                .arg(arguments[1]).arg(arguments[2]).arg(arguments[3]);
+    case TraceEvent::MessageReceived:
+        return QString{"RX %1 host %2 device %3 size %4"}.arg(commandName(arguments[0]))
+                .arg(arguments[1]).arg(arguments[2]).arg(arguments[3]);
+    case TraceEvent::StateChanged:
+        return QString{"State %1 -> %2"}.arg(stateName(arguments[0])).arg(stateName(arguments[1]));
+    case TraceEvent::Acknowledged:
+        return QString{"Ok for host %1 device %2 after %3 us"}.arg(arguments[0]).arg(arguments[1])
+                .arg(arguments[2]);
+    case TraceEvent::Invalid:
+        break;
+    }
+    return QString{"Unknown event %1"}.arg(record.event);
+}
+
+QString formatTimestamp(qint64 timestamp)
+{
+    const auto time = QDateTime::fromMSecsSinceEpoch(timestamp / 1000);
+    return QString{"%1%2"}.arg(time.toString("yyyy-MM-dd hh:mm:ss.zzz"))
+            .arg(timestamp % 1000, 3, 10, QChar{'0'});
+}
+
+} // anonymous namespace
+
+QString traceFilePath()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/qdb.trace";
+}
+
+int dumpTrace()
+{
+    std::vector<TraceRecord> records;
+    QString errorString;
+    if (!TraceRing::read(traceFilePath(), &records, &errorString)) {
+        std::cerr << "Could not read trace " << qUtf8Printable(traceFilePath()) << ": "
+                  << qUtf8Printable(errorString) << std::endl;
+        return 1;
+    }
+
+    for (const auto &record : records) {
+        std::cout << qUtf8Printable(formatTimestamp(record.timestamp)) << " #" << record.sequence
+                  << " 0x" << std::hex << record.source << std::dec << " "
+                  << qUtf8Printable(describe(record)) << "\n";
+    }
+    std::cout << records.size() << " records" << std::endl;
+    return 0;
+}
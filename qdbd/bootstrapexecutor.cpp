@@ -0,0 +1,127 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Debug Bridge.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+#include "bootstrapexecutor.h"
+
+#include "deviceidentity.h"
+#include "libqdb/bootstrapcommon.h"
+#include "libqdb/stream.h"
+#include "networkconfiguration.h"
+
+#include <QtCore/qdatastream.h>
+#include <QtCore/qdebug.h>
+#include <QtCore/qloggingcategory.h>
+
+Q_LOGGING_CATEGORY(bootstrapExecutorC, "qdb.executors.bootstrap");
+
+BootstrapExecutor::BootstrapExecutor(Stream *stream, const QByteArray &openTag)
+    : m_stream{stream},
+      m_proposedSubnet{},
+      m_validProposal{false},
+      m_waitingForAddress{false}
+{
+    QDataStream tagStream{openTag};
+    uint32_t tag = 0;
+    uint32_t version = 0;
+    tagStream >> tag >> version >> m_proposedSubnet;
+    // Newer hosts may append fields, which are ignored
+    m_validProposal = tagStream.status() == QDataStream::Ok && version >= bootstrapVersion;
+
+    // Runs once the executor has been moved to its worker thread
+    if (m_stream)
+        QMetaObject::invokeMethod(this, &BootstrapExecutor::bootstrap, Qt::QueuedConnection);
+}
+
+bool BootstrapExecutor::prefersWorkerThread() const
+{
+    return true;
+}
+
+void BootstrapExecutor::receive(StreamPacket packet)
+{
+    Q_UNUSED(packet);
+    qCWarning(bootstrapExecutorC) << "Ignoring unexpected packet from the host";
+}
+
+void BootstrapExecutor::bootstrap()
+{
+    StreamPacket accepted;
+    accepted << static_cast<uint32_t>(BootstrapMessage::Accepted);
+    m_stream->write(accepted);
+
+    auto *networkConfiguration = NetworkConfiguration::instance();
+    ConfigurationResult result = ConfigurationResult::Failure;
+    if (m_validProposal && !m_proposedSubnet.isEmpty())
+        result = networkConfiguration->set(m_proposedSubnet);
+    else
+        qCWarning(bootstrapExecutorC) << "Invalid subnet proposal from the host";
+
+    // Subscribe before taking the snapshot, so that an address assigned in
+    // between is not missed
+    DeviceIdentity *deviceIdentity = DeviceIdentity::instance();
+    if (deviceIdentity->followsIpAddress()) {
+        m_waitingForAddress = true;
+        connect(deviceIdentity, &DeviceIdentity::ipAddressChanged,
+                this, &BootstrapExecutor::handleIpAddressChanged);
+    }
+    const auto identity = deviceIdentity->snapshot();
+    const bool updateFollows = m_waitingForAddress && identity.ipAddress.isEmpty();
+    if (m_waitingForAddress && !updateFollows) {
+        disconnect(deviceIdentity, &DeviceIdentity::ipAddressChanged,
+                   this, &BootstrapExecutor::handleIpAddressChanged);
+        m_waitingForAddress = false;
+    }
+
+    StreamPacket response;
+    response << static_cast<uint32_t>(BootstrapMessage::Configured);
+    response << static_cast<uint32_t>(result);
+    response << networkConfiguration->subnet();
+    response << identity.serial;
+    response << identity.hostMac;
+    response << identity.ipAddress;
+    response << updateFollows;
+    m_stream->write(response);
+    qCDebug(bootstrapExecutorC) << "Bootstrapped with subnet" << networkConfiguration->subnet()
+                                << "and IP address" << identity.ipAddress;
+}
+
+void BootstrapExecutor::handleIpAddressChanged(QString ipAddress)
+{
+    if (ipAddress.isEmpty() || !m_waitingForAddress)
+        return;
+
+    disconnect(DeviceIdentity::instance(), &DeviceIdentity::ipAddressChanged,
+               this, &BootstrapExecutor::handleIpAddressChanged);
+    m_waitingForAddress = false;
+
+    StreamPacket update;
+    update << static_cast<uint32_t>(BootstrapMessage::AddressReady);
+    update << ipAddress;
+    m_stream->write(update);
+    qCDebug(bootstrapExecutorC) << "Sent IP address" << ipAddress;
+}
@@ -50,11 +50,36 @@ QString Configuration::usbEthernetFunctionName()
     return s_usbEthernetFunctionName;
 }
 
+QString Configuration::usbEthernetFunctionPath()
+{
+    return s_gadgetConfigFsDir + "/functions/" + s_usbEthernetFunctionName;
+}
+
 QString Configuration::udcDriverDir()
 {
     return s_udcDriverDir;
 }
 
+bool Configuration::useNetworkScript()
+{
+    return s_useNetworkScript;
+}
+
+bool Configuration::configuresNetwork()
+{
+    return s_configuresNetwork;
+}
+
+int Configuration::executorThreadCount()
+{
+    return s_executorThreadCount;
+}
+
+int Configuration::resumeGracePeriod()
+{
+    return s_resumeGracePeriod;
+}
+
 void Configuration::setFunctionFsDir(const QString &path)
 {
     s_functionFsDir = QDir::cleanPath(path);
@@ -75,8 +100,32 @@ void Configuration::setUsbEthernetFunctionName(const QString &name)
     s_usbEthernetFunctionName = name;
 }
 
+void Configuration::setUseNetworkScript(bool useScript)
+{
+    s_useNetworkScript = useScript;
+}
+
+void Configuration::setConfiguresNetwork(bool configures)
+{
+    s_configuresNetwork = configures;
+}
+
+void Configuration::setExecutorThreadCount(int count)
+{
+    s_executorThreadCount = count;
+}
+
+void Configuration::setResumeGracePeriod(int milliseconds)
+{
+    s_resumeGracePeriod = milliseconds;
+}
+
 QString Configuration::s_functionFsDir = "/dev/usb-ffs/qdb";
 QString Configuration::s_gadgetConfigFsDir = "/sys/kernel/config/usb_gadget/g1";
 QString Configuration::s_usbEthernetFunctionName = "rndis.usb0";
 QString Configuration::s_networkScript = "b2qt-gadget-network.sh";
 QString Configuration::s_udcDriverDir = "/sys/class/udc/";
+bool Configuration::s_useNetworkScript = false;
+bool Configuration::s_configuresNetwork = true;
+int Configuration::s_executorThreadCount = 2;
+int Configuration::s_resumeGracePeriod = 5000;
@@ -38,11 +38,20 @@ public:
     static QString gadgetConfigFsDir();
     static QString networkScript();
     static QString usbEthernetFunctionName();
+    static QString usbEthernetFunctionPath();
     static QString udcDriverDir();
+    static bool useNetworkScript();
+    static bool configuresNetwork();
+    static int executorThreadCount();
+    static int resumeGracePeriod();
     static void setFunctionFsDir(const QString &path);
     static void setGadgetConfigFsDir(const QString &path);
     static void setNetworkScript(const QString &script);
     static void setUsbEthernetFunctionName(const QString &name);
+    static void setUseNetworkScript(bool useScript);
+    static void setConfiguresNetwork(bool configures);
+    static void setExecutorThreadCount(int count);
+    static void setResumeGracePeriod(int milliseconds);
 
 private:
     static QString s_functionFsDir;
@@ -50,6 +59,10 @@ private:
     static QString s_networkScript;
     static QString s_usbEthernetFunctionName;
     static QString s_udcDriverDir;
+    static bool s_useNetworkScript;
+    static bool s_configuresNetwork;
+    static int s_executorThreadCount;
+    static int s_resumeGracePeriod;
 };
 
 #endif // CONFIGURATION_H
@@ -28,9 +28,11 @@
 ****************************************************************************/
 #include "createexecutor.h"
 
+#include "bootstrapexecutor.h"
 #include "echoexecutor.h"
 #include "handshakeexecutor.h"
 #include "networkconfigurationexecutor.h"
+#include "notificationexecutor.h"
 #include "libqdb/make_unique.h"
 #include "libqdb/protocol/services.h"
 
@@ -50,6 +52,10 @@ std::unique_ptr<Executor> createExecutor(Stream *stream, const QByteArray &tagBu
         return make_unique<HandshakeExecutor>(stream);
     case NetworkConfigurationTag:
         return make_unique<NetworkConfigurationExecutor>(stream);
+    case BootstrapTag:
+        return make_unique<BootstrapExecutor>(stream, tagBuffer);
+    case NotificationTag:
+        return make_unique<NotificationExecutor>(stream);
     default:
         qCritical("Unknown ServiceTag %d in createExecutor", tag);
         return std::unique_ptr<Executor>{};
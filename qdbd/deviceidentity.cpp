@@ -0,0 +1,183 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Debug Bridge.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+#include "deviceidentity.h"
+
+#include "configuration.h"
+#include "libqdb/make_unique.h"
+
+#include <QtCore/QMutexLocker>
+#include <QtCore/qfile.h>
+#include <QtCore/qloggingcategory.h>
+#include <QtCore/qsocketnotifier.h>
+
+#include <vector>
+
+Q_LOGGING_CATEGORY(identityC, "qdb.identity");
+
+namespace {
+
+QString readConfigFsValue(const QString &path)
+{
+    QFile file{path};
+    if (!file.open(QIODevice::ReadOnly)) {
+        qCCritical(identityC) << "Could not read" << path;
+        return "";
+    }
+    return QString{file.readAll()}.trimmed();
+}
+
+} // anonymous namespace
+
+DeviceIdentity::DeviceIdentity()
+    : m_lock{},
+      m_snapshot{},
+      m_interfaceName{},
+      m_interfaceIndex{0},
+      m_monitor{},
+      m_notifier{nullptr}
+{
+    Q_ASSERT(!s_instance);
+    s_instance = this;
+}
+
+DeviceIdentity::~DeviceIdentity()
+{
+    s_instance = nullptr;
+}
+
+DeviceIdentity *DeviceIdentity::instance()
+{
+    return s_instance;
+}
+
+bool DeviceIdentity::initialize()
+{
+    const QString functionPath = Configuration::usbEthernetFunctionPath();
+    {
+        QMutexLocker locker{&m_lock};
+        m_snapshot.serial = readConfigFsValue(Configuration::gadgetConfigFsDir()
+                                              + "/strings/0x409/serialnumber");
+        m_snapshot.hostMac = readConfigFsValue(functionPath + "/host_addr");
+    }
+    m_interfaceName = readConfigFsValue(functionPath + "/ifname");
+
+    // Subscribe before the initial dump so that no change can fall in between
+    const bool monitoring = m_monitor.openAddressMonitor();
+    if (monitoring) {
+        m_notifier = make_unique<QSocketNotifier>(m_monitor.descriptor(), QSocketNotifier::Read);
+        connect(m_notifier.get(), &QSocketNotifier::activated,
+                this, &DeviceIdentity::handleAddressNotifications);
+    }
+
+    refreshIpAddress();
+
+    const Snapshot current = snapshot();
+    qCDebug(identityC) << "Device serial:" << current.serial;
+    qCDebug(identityC) << "Host-side MAC address:" << current.hostMac;
+    qCDebug(identityC) << "Device IP address:" << current.ipAddress;
+    return monitoring;
+}
+
+DeviceIdentity::Snapshot DeviceIdentity::snapshot() const
+{
+    QMutexLocker locker{&m_lock};
+    return m_snapshot;
+}
+
+bool DeviceIdentity::followsIpAddress() const
+{
+    return m_notifier != nullptr;
+}
+
+void DeviceIdentity::handleAddressNotifications()
+{
+    std::vector<InterfaceAddressChange> changes;
+    if (!m_monitor.readAddressChanges(&changes)) {
+        refreshIpAddress();
+        return;
+    }
+
+    if (!resolveInterface())
+        return;
+
+    for (const auto &change : changes) {
+        if (change.address.interfaceIndex != m_interfaceIndex)
+            continue;
+
+        const QString address = change.address.address.toString();
+        if (change.added)
+            setIpAddress(address);
+        else if (address == snapshot().ipAddress)
+            setIpAddress("");
+    }
+}
+
+void DeviceIdentity::refreshIpAddress()
+{
+    if (!resolveInterface())
+        return;
+
+    RtNetlinkSocket netlink;
+    std::vector<InterfaceAddress> addresses;
+    if (!netlink.open() || !netlink.dumpAddresses(&addresses)) {
+        qCWarning(identityC) << "Could not query the addresses of" << m_interfaceName;
+        return;
+    }
+
+    QString ipAddress;
+    for (const auto &entry : addresses) {
+        if (entry.interfaceIndex == m_interfaceIndex) {
+            ipAddress = entry.address.toString();
+            break;
+        }
+    }
+    setIpAddress(ipAddress);
+}
+
+void DeviceIdentity::setIpAddress(const QString &ipAddress)
+{
+    {
+        QMutexLocker locker{&m_lock};
+        if (m_snapshot.ipAddress == ipAddress)
+            return;
+        m_snapshot.ipAddress = ipAddress;
+    }
+    qCDebug(identityC) << "Device IP address changed to" << ipAddress;
+    emit ipAddressChanged(ipAddress);
+}
+
+bool DeviceIdentity::resolveInterface()
+{
+    // The interface may not exist yet if the gadget was not bound at startup
+    if (m_interfaceIndex == 0 && !m_interfaceName.isEmpty())
+        m_interfaceIndex = RtNetlinkSocket::interfaceIndex(m_interfaceName);
+    return m_interfaceIndex != 0;
+}
+
+DeviceIdentity *DeviceIdentity::s_instance = nullptr;
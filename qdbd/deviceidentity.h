@@ -0,0 +1,88 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Debug Bridge.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+#ifndef DEVICEIDENTITY_H
+#define DEVICEIDENTITY_H
+
+#include "libqdb/rtnetlink.h"
+
+#include <QtCore/qmutex.h>
+#include <QtCore/qobject.h>
+#include <QtCore/qstring.h>
+QT_BEGIN_NAMESPACE
+class QSocketNotifier;
+QT_END_NAMESPACE
+
+#include <memory>
+
+// Keeps the information the host asks for in the handshake in memory. The
+// configfs values are read once at startup and the IP address is followed
+// through rtnetlink notifications. Snapshots can be taken from any thread,
+// but the object itself lives in the main thread.
+class DeviceIdentity : public QObject
+{
+    Q_OBJECT
+public:
+    struct Snapshot
+    {
+        QString serial;
+        QString hostMac;
+        QString ipAddress;
+    };
+
+    DeviceIdentity();
+    ~DeviceIdentity();
+
+    static DeviceIdentity *instance();
+
+    bool initialize();
+    Snapshot snapshot() const;
+    bool followsIpAddress() const;
+
+signals:
+    void ipAddressChanged(QString ipAddress);
+
+private slots:
+    void handleAddressNotifications();
+
+private:
+    void refreshIpAddress();
+    void setIpAddress(const QString &ipAddress);
+    bool resolveInterface();
+
+    static DeviceIdentity *s_instance;
+
+    mutable QMutex m_lock;
+    Snapshot m_snapshot;
+    QString m_interfaceName;
+    int m_interfaceIndex;
+    RtNetlinkSocket m_monitor;
+    std::unique_ptr<QSocketNotifier> m_notifier;
+};
+
+#endif // DEVICEIDENTITY_H
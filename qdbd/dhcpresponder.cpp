@@ -0,0 +1,261 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Debug Bridge.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+#include "dhcpresponder.h"
+
+#include "libqdb/make_unique.h"
+
+#include <QtCore/qdatastream.h>
+#include <QtCore/qendian.h>
+#include <QtCore/qloggingcategory.h>
+#include <QtNetwork/qnetworkdatagram.h>
+#include <QtNetwork/qudpsocket.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include <sys/socket.h>
+
+Q_LOGGING_CATEGORY(dhcpC, "qdb.dhcp")
+
+namespace {
+
+const quint16 serverPort = 67;
+const quint16 clientPort = 68;
+const quint32 magicCookie = 0x63825363;
+const int fixedHeaderSize = 236; // BOOTP header before the options
+const int minimumReplySize = 300;
+const quint32 leaseTime = 24 * 60 * 60; // in seconds
+
+enum MessageType : quint8
+{
+    Discover = 1,
+    Offer = 2,
+    Request = 3,
+    Decline = 4,
+    Ack = 5,
+    Nak = 6,
+    Release = 7,
+    Inform = 8,
+};
+
+enum OptionCode : quint8
+{
+    PadOption = 0,
+    SubnetMaskOption = 1,
+    RequestedAddressOption = 50,
+    LeaseTimeOption = 51,
+    MessageTypeOption = 53,
+    ServerIdentifierOption = 54,
+    EndOption = 255,
+};
+
+struct DhcpRequest
+{
+    quint32 transactionId;
+    quint16 flags;
+    quint32 clientAddress;
+    QByteArray hardwareAddress;
+    quint8 type;
+    quint32 requestedAddress;
+    quint32 serverIdentifier;
+};
+
+bool parseRequest(const QByteArray &datagram, DhcpRequest *request)
+{
+    if (datagram.size() < fixedHeaderSize + static_cast<int>(sizeof(magicCookie)))
+        return false;
+
+    const auto *data = reinterpret_cast<const uchar *>(datagram.constData());
+    if (data[0] != 1) // Only BOOTREQUESTs are for servers
+        return false;
+    if (qFromBigEndian<quint32>(data + fixedHeaderSize) != magicCookie)
+        return false;
+
+    request->transactionId = qFromBigEndian<quint32>(data + 4);
+    request->flags = qFromBigEndian<quint16>(data + 10);
+    request->clientAddress = qFromBigEndian<quint32>(data + 12);
+    request->hardwareAddress = datagram.mid(28, 16);
+    request->type = 0;
+    request->requestedAddress = 0;
+    request->serverIdentifier = 0;
+
+    int offset = fixedHeaderSize + static_cast<int>(sizeof(magicCookie));
+    while (offset < datagram.size()) {
+        const quint8 code = data[offset++];
+        if (code == PadOption)
+            continue;
+        if (code == EndOption || offset >= datagram.size())
+            break;
+
+        const int length = data[offset++];
+        if (offset + length > datagram.size())
+            return false;
+
+        if (code == MessageTypeOption && length == 1)
+            request->type = data[offset];
+        else if (code == RequestedAddressOption && length == 4)
+            request->requestedAddress = qFromBigEndian<quint32>(data + offset);
+        else if (code == ServerIdentifierOption && length == 4)
+            request->serverIdentifier = qFromBigEndian<quint32>(data + offset);
+        offset += length;
+    }
+    return request->type != 0;
+}
+
+QByteArray makeReply(const DhcpRequest &request, MessageType type, quint32 serverAddress,
+                     quint32 clientAddress, quint32 subnetMask)
+{
+    QByteArray reply;
+    QDataStream stream{&reply, QIODevice::WriteOnly};
+    stream << quint8{2} << quint8{1} << quint8{6} << quint8{0}; // BOOTREPLY, Ethernet, MAC length, hops
+    stream << request.transactionId << quint16{0} << request.flags;
+    stream << quint32{0}; // ciaddr
+    stream << (type == Nak ? quint32{0} : clientAddress); // yiaddr
+    stream << serverAddress; // siaddr
+    stream << quint32{0}; // giaddr
+    stream.writeRawData(request.hardwareAddress.constData(), request.hardwareAddress.size());
+    const QByteArray serverNameAndFile{64 + 128, '\0'};
+    stream.writeRawData(serverNameAndFile.constData(), serverNameAndFile.size());
+    stream << magicCookie;
+
+    stream << quint8{MessageTypeOption} << quint8{1} << quint8{type};
+    stream << quint8{ServerIdentifierOption} << quint8{4} << serverAddress;
+    if (type != Nak) {
+        stream << quint8{LeaseTimeOption} << quint8{4} << leaseTime;
+        stream << quint8{SubnetMaskOption} << quint8{4} << subnetMask;
+    }
+    stream << quint8{EndOption};
+
+    // Some clients ignore replies shorter than a BOOTP message
+    const int padding = minimumReplySize - reply.size();
+    if (padding > 0) {
+        const QByteArray zeroes{padding, '\0'};
+        stream.writeRawData(zeroes.constData(), zeroes.size());
+    }
+    return reply;
+}
+
+} // anonymous namespace
+
+DhcpResponder::DhcpResponder(QObject *parent)
+    : QObject{parent},
+      m_socket{nullptr},
+      m_serverAddress{},
+      m_clientAddress{},
+      m_prefixLength{0}
+{
+
+}
+
+DhcpResponder::~DhcpResponder() = default;
+
+bool DhcpResponder::isRunning() const
+{
+    return m_socket != nullptr;
+}
+
+bool DhcpResponder::start(const QString &interfaceName, const QHostAddress &serverAddress,
+                          const QHostAddress &clientAddress, int prefixLength)
+{
+    stop();
+
+    // Parent the socket so that it follows the responder to other threads
+    auto socket = make_unique<QUdpSocket>(this);
+    if (!socket->bind(QHostAddress::AnyIPv4, serverPort,
+                      QAbstractSocket::ShareAddress | QAbstractSocket::ReuseAddressHint)) {
+        qCWarning(dhcpC) << "Could not bind DHCP socket:" << socket->errorString();
+        return false;
+    }
+
+    // Only answer requests arriving through the USB Ethernet interface
+    const QByteArray name = interfaceName.toLocal8Bit();
+    if (::setsockopt(socket->socketDescriptor(), SOL_SOCKET, SO_BINDTODEVICE,
+                     name.constData(), name.size()) != 0) {
+        qCWarning(dhcpC) << "Could not bind DHCP socket to interface" << interfaceName << ":"
+                         << strerror(errno);
+        return false;
+    }
+
+    m_socket = std::move(socket);
+    m_serverAddress = serverAddress;
+    m_clientAddress = clientAddress;
+    m_prefixLength = prefixLength;
+    connect(m_socket.get(), &QUdpSocket::readyRead, this, &DhcpResponder::handleDatagrams);
+
+    qCDebug(dhcpC) << "Offering" << clientAddress.toString() << "through" << interfaceName;
+    return true;
+}
+
+void DhcpResponder::stop()
+{
+    if (!m_socket)
+        return;
+
+    m_socket.reset();
+    qCDebug(dhcpC) << "Stopped DHCP responder";
+}
+
+void DhcpResponder::handleDatagrams()
+{
+    const quint32 server = m_serverAddress.toIPv4Address();
+    const quint32 client = m_clientAddress.toIPv4Address();
+    const quint32 mask = ~quint32{0} << (32 - m_prefixLength);
+
+    while (m_socket && m_socket->hasPendingDatagrams()) {
+        const QNetworkDatagram datagram = m_socket->receiveDatagram();
+
+        DhcpRequest request;
+        if (!parseRequest(datagram.data(), &request))
+            continue;
+
+        MessageType replyType;
+        switch (request.type) {
+        case Discover:
+            replyType = Offer;
+            break;
+        case Request: {
+            if (request.serverIdentifier != 0 && request.serverIdentifier != server)
+                continue; // Client selected another server
+            const quint32 requested = request.requestedAddress != 0 ? request.requestedAddress
+                                                                    : request.clientAddress;
+            replyType = (requested == 0 || requested == client) ? Ack : Nak;
+            break;
+        }
+        default:
+            // Nothing to do for releases, declines or informs with a single client
+            continue;
+        }
+
+        const QByteArray reply = makeReply(request, replyType, server, client, mask);
+        if (m_socket->writeDatagram(reply, QHostAddress::Broadcast, clientPort) != reply.size())
+            qCWarning(dhcpC) << "Could not send DHCP reply:" << m_socket->errorString();
+        else
+            qCDebug(dhcpC) << "Sent DHCP reply" << replyType << "for request" << request.type;
+    }
+}
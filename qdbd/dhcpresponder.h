@@ -0,0 +1,66 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Debug Bridge.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+#ifndef DHCPRESPONDER_H
+#define DHCPRESPONDER_H
+
+#include <QtCore/qobject.h>
+#include <QtNetwork/qhostaddress.h>
+QT_BEGIN_NAMESPACE
+class QUdpSocket;
+QT_END_NAMESPACE
+
+#include <memory>
+
+// DHCP server for the point-to-point USB Ethernet link. There is only ever
+// one client, the host, so it always gets offered the same address.
+class DhcpResponder : public QObject
+{
+    Q_OBJECT
+public:
+    explicit DhcpResponder(QObject *parent = nullptr);
+    ~DhcpResponder();
+
+    bool isRunning() const;
+
+public slots:
+    bool start(const QString &interfaceName, const QHostAddress &serverAddress,
+               const QHostAddress &clientAddress, int prefixLength);
+    void stop();
+
+private slots:
+    void handleDatagrams();
+
+private:
+    std::unique_ptr<QUdpSocket> m_socket;
+    QHostAddress m_serverAddress;
+    QHostAddress m_clientAddress;
+    int m_prefixLength;
+};
+
+#endif // DHCPRESPONDER_H
@@ -33,7 +33,7 @@
 #include <QtCore/qdebug.h>
 #include <QtCore/qloggingcategory.h>
 
-Q_LOGGING_CATEGORY(echoC, "qdb.executors.echo");
+Q_LOGGING_CATEGORY(echoExecutorC, "qdb.executors.echo");
 
 EchoExecutor::EchoExecutor(Stream *stream)
     : m_stream{stream}
@@ -44,6 +44,6 @@ EchoExecutor::EchoExecutor(Stream *stream)
 
 void EchoExecutor::receive(StreamPacket packet)
 {
-    qCDebug(echoC) << "EchoExecutor received:" << packet.buffer();
+    qCDebug(echoExecutorC) << "EchoExecutor received:" << packet.buffer();
     m_stream->write(packet);
 }
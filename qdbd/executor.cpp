@@ -36,6 +36,11 @@ Executor::Executor()
 
 Executor::~Executor() = default;
 
+bool Executor::prefersWorkerThread() const
+{
+    return false;
+}
+
 void Executor::onStreamClosed()
 {
     m_stream = nullptr;
@@ -41,6 +41,11 @@ public:
     Executor();
     virtual ~Executor();
 
+    // Executors that block in receive(), e.g. by running processes or reading
+    // sysfs, should return true to be run in the server's worker pool instead
+    // of the thread handling the connection.
+    virtual bool prefersWorkerThread() const;
+
 public slots:
     virtual void receive(StreamPacket packet) = 0;
     virtual void onStreamClosed();
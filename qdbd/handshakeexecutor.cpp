@@ -28,62 +28,13 @@
 ****************************************************************************/
 #include "handshakeexecutor.h"
 
-#include "configuration.h"
+#include "deviceidentity.h"
 #include "libqdb/stream.h"
 
 #include <QtCore/qdebug.h>
-#include <QtCore/qfile.h>
 #include <QtCore/qloggingcategory.h>
-#include <QtNetwork/qnetworkinterface.h>
 
-Q_LOGGING_CATEGORY(handshakeC, "qdb.executors.handshake");
-
-QString usbEthernetFunctionPath()
-{
-    return Configuration::gadgetConfigFsDir() + "/functions/" + Configuration::usbEthernetFunctionName();
-}
-
-QString deviceIpAddress()
-{
-    QFile file{usbEthernetFunctionPath() + "/ifname"};
-    if (!file.open(QIODevice::ReadOnly)) {
-        qCCritical(handshakeC) << "Could not find network interface name from Usb Ethernet configuration at" << usbEthernetFunctionPath();
-        return "";
-    }
-
-    const auto interfaceName = QString{file.readAll()}.trimmed();
-    const auto interface = QNetworkInterface::interfaceFromName(interfaceName);
-    const auto addressEntries = interface.addressEntries();
-
-    for (const auto &entry : addressEntries) {
-        const auto ip = entry.ip();
-        if (ip.protocol() == QAbstractSocket::IPv4Protocol) {
-            qCDebug(handshakeC) << "Device IP address:" << ip.toString();
-            return ip.toString();
-        }
-    }
-    return "";
-}
-
-QString deviceSerial()
-{
-    QFile file{Configuration::gadgetConfigFsDir() + "/strings/0x409/serialnumber"};
-    if (!file.open(QIODevice::ReadOnly)) {
-        qCCritical(handshakeC) << "Could not find device serial number from configfs configuration at" << Configuration::gadgetConfigFsDir();
-        return "";
-    }
-    return QString{file.readAll()}.trimmed();
-}
-
-QString hostSideMac()
-{
-    QFile file{usbEthernetFunctionPath() + "/host_addr"};
-    if (!file.open(QIODevice::ReadOnly)) {
-        qCCritical(handshakeC) << "Could not find host MAC address from Usb Ethernet configuration at" << usbEthernetFunctionPath();
-        return "";
-    }
-    return QString{file.readAll()}.trimmed();
-}
+Q_LOGGING_CATEGORY(handshakeExecutorC, "qdb.executors.handshake");
 
 HandshakeExecutor::HandshakeExecutor(Stream *stream)
     : m_stream{stream}
@@ -96,10 +47,12 @@ void HandshakeExecutor::receive(StreamPacket packet)
 {
     Q_UNUSED(packet);
 
+    // Hosts that want to know when the address changes open a notification stream
+    const auto identity = DeviceIdentity::instance()->snapshot();
     StreamPacket response;
-    response << deviceSerial();
-    response << hostSideMac();
-    response << deviceIpAddress();
+    response << identity.serial;
+    response << identity.hostMac;
+    response << identity.ipAddress;
     m_stream->write(response);
-    qCDebug(handshakeC) << "Responded to handshake with device information";
+    qCDebug(handshakeExecutorC) << "Responded to handshake with device information";
 }
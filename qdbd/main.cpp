@@ -27,6 +27,7 @@
 **
 ****************************************************************************/
 #include "configuration.h"
+#include "deviceidentity.h"
 #include "libqdb/protocol/qdbtransport.h"
 #include "usb-gadget/usbgadget.h"
 #include "server.h"
@@ -45,6 +46,8 @@ int main(int argc, char *argv[])
     const QString gadgetKey{"gadget-configfs-dir"};
     const QString networkKey{"network-script"};
     const QString usbEthernetKey{"usb-ethernet-function-name"};
+    const QString executorThreadsKey{"executor-threads"};
+    const QString resumeGraceKey{"resume-grace-period"};
 
     QCommandLineParser parser;
     parser.addHelpOption();
@@ -58,21 +61,47 @@ int main(int argc, char *argv[])
                       "Location of the configfs gadget configuration (including the gadget name)",
                       "directory"});
     parser.addOption({networkKey,
-                      "Script to run for controlling the network between host and device",
+                      "Script to run for controlling the network between host and device instead of configuring it natively",
                       "script"});
     parser.addOption({usbEthernetKey,
                       "Name of the Function File System function that provides USB Ethernet",
                       "name"});
+    parser.addOption({executorThreadsKey,
+                      "Amount of worker threads for running blocking services, 0 runs all services in the main thread",
+                      "count"});
+    parser.addOption({resumeGraceKey,
+                      "Time to keep the network configuration and session after the USB link goes down",
+                      "milliseconds"});
     parser.process(app);
 
     if (parser.isSet(ffsKey))
         Configuration::setFunctionFsDir(parser.value(ffsKey));
     if (parser.isSet(gadgetKey))
         Configuration::setGadgetConfigFsDir(parser.value(gadgetKey));
-    if (parser.isSet(networkKey))
+    if (parser.isSet(networkKey)) {
         Configuration::setNetworkScript(parser.value(networkKey));
+        Configuration::setUseNetworkScript(true);
+    }
     if (parser.isSet(usbEthernetKey))
         Configuration::setUsbEthernetFunctionName(parser.value(usbEthernetKey));
+    if (parser.isSet(executorThreadsKey)) {
+        bool ok = false;
+        const int count = parser.value(executorThreadsKey).toInt(&ok);
+        if (!ok || count < 0) {
+            qCritical() << "Invalid amount of executor threads:" << parser.value(executorThreadsKey);
+            return 1;
+        }
+        Configuration::setExecutorThreadCount(count);
+    }
+    if (parser.isSet(resumeGraceKey)) {
+        bool ok = false;
+        const int period = parser.value(resumeGraceKey).toInt(&ok);
+        if (!ok || period < 0) {
+            qCritical() << "Invalid resume grace period:" << parser.value(resumeGraceKey);
+            return 1;
+        }
+        Configuration::setResumeGracePeriod(period);
+    }
 
     QString filterRules;
     if (!parser.isSet("debug-transport")) {
@@ -83,7 +112,13 @@ int main(int argc, char *argv[])
     }
     QLoggingCategory::setFilterRules(filterRules);
 
-    Server server{new QdbTransport{new UsbGadget{}}};
+    DeviceIdentity identity;
+    if (!identity.initialize())
+        qWarning() << "Could not follow changes to the device IP address";
+
+    auto *gadget = new UsbGadget{};
+    Server server{new QdbTransport{gadget}};
+    QObject::connect(gadget, &UsbGadget::linkLost, &server, &Server::invalidateSession);
     if (server.initialize()) {
         qDebug() << "Initialized device server";
     } else {
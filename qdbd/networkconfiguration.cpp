@@ -29,12 +29,33 @@
 #include "networkconfiguration.h"
 
 #include "configuration.h"
+#include "dhcpresponder.h"
+#include "libqdb/make_unique.h"
+#include "libqdb/rtnetlink.h"
 
 #include <QtCore/QMutexLocker>
+#include <QtCore/qcoreapplication.h>
+#include <QtCore/qfile.h>
 #include <QtCore/qloggingcategory.h>
 #include <QtCore/qprocess.h>
+#include <QtNetwork/qhostaddress.h>
 
-Q_LOGGING_CATEGORY(configurationC, "qdb.networkconfiguration")
+Q_LOGGING_CATEGORY(networkConfigurationC, "qdb.networkconfiguration")
+
+namespace {
+
+QString usbEthernetInterfaceName()
+{
+    QFile file{Configuration::usbEthernetFunctionPath() + "/ifname"};
+    if (!file.open(QIODevice::ReadOnly)) {
+        qCWarning(networkConfigurationC) << "Could not find network interface name from Usb Ethernet configuration at"
+                                         << Configuration::usbEthernetFunctionPath();
+        return "";
+    }
+    return QString{file.readAll()}.trimmed();
+}
+
+} // anonymous namespace
 
 NetworkConfiguration *NetworkConfiguration::instance()
 {
@@ -42,58 +63,71 @@ NetworkConfiguration *NetworkConfiguration::instance()
     return &instance;
 }
 
+NetworkConfiguration::~NetworkConfiguration() = default;
+
 ConfigurationResult NetworkConfiguration::set(QString subnetString)
 {
+    if (!Configuration::configuresNetwork()) {
+        // Simulated devices share the process and have no network of their own
+        qCDebug(networkConfigurationC) << "Not configuring the network to" << subnetString;
+        return ConfigurationResult::Success;
+    }
+
     QMutexLocker m_locker{&m_lock};
+    if (m_subnetString == subnetString) {
+        // The host offered the subnet the device still has, e.g. after a replug
+        qCDebug(networkConfigurationC) << "Network configuration" << subnetString << "is already set";
+        return ConfigurationResult::Success;
+    }
     if (!m_subnetString.isEmpty()) {
-        qCWarning(configurationC) << "Can't set network configuration since it is already set";
+        qCWarning(networkConfigurationC) << "Can't set network configuration since it is already set";
         return ConfigurationResult::AlreadySet;
     }
     m_subnetString = subnetString;
 
-    QProcess process;
-    process.setProcessChannelMode(QProcess::MergedChannels);
-    QObject::connect(&process, &QProcess::readyReadStandardOutput, &process, [&]() {
-        qCDebug(configurationC) << "Script:" << process.readAllStandardOutput();
-    });
-
-    const QStringList args = QStringList{"--set", subnetString};
-    qCDebug(configurationC) << "Running network configuration script" << Configuration::networkScript() << args;
-    process.start(Configuration::networkScript(), args);
+    if (!Configuration::useNetworkScript()) {
+        if (setNatively(subnetString)) {
+            qCDebug(networkConfigurationC) << "Configured network device to" << subnetString;
+            return ConfigurationResult::Success;
+        }
+        qCWarning(networkConfigurationC) << "Configuring the network natively failed, falling back to"
+                                         << Configuration::networkScript();
+        resetNatively();
+    }
 
-    process.waitForFinished();
-    if (process.exitCode() != 0) {
-        qCWarning(configurationC) << "Using script" << Configuration::networkScript() << "to configure the network failed";
+    if (!runScript(QStringList{"--set", subnetString})) {
+        qCWarning(networkConfigurationC) << "Using script" << Configuration::networkScript() << "to configure the network failed";
         m_subnetString.clear();
         return ConfigurationResult::Failure;
     }
 
-    qCDebug(configurationC) << "Configured network device to" << subnetString;
+    qCDebug(networkConfigurationC) << "Configured network device to" << subnetString;
     return ConfigurationResult::Success;
 }
 
 bool NetworkConfiguration::reset()
 {
+    if (!Configuration::configuresNetwork())
+        return true;
+
     QMutexLocker m_locker{&m_lock};
     m_subnetString.clear();
 
-    QProcess process;
-    process.setProcessChannelMode(QProcess::MergedChannels);
-    QObject::connect(&process, &QProcess::readyReadStandardOutput, &process, [&]() {
-        qCDebug(configurationC) << "Script:" << process.readAllStandardOutput();
-    });
-
-    const QStringList args = QStringList{"--reset"};
-    qCDebug(configurationC) << "Running network configuration script" << Configuration::networkScript() << args;
-    process.start(Configuration::networkScript(), args);
+    if (m_configuredNatively) {
+        if (!resetNatively()) {
+            qCWarning(networkConfigurationC) << "Resetting the network configuration natively failed";
+            return false;
+        }
+        qCDebug(networkConfigurationC) << "Reset the network configuration";
+        return true;
+    }
 
-    process.waitForFinished();
-    if (process.exitCode() != 0) {
-        qCWarning(configurationC) << "Using script" << Configuration::networkScript()
-                                  << "to reset the network configuration failed";
+    if (!runScript(QStringList{"--reset"})) {
+        qCWarning(networkConfigurationC) << "Using script" << Configuration::networkScript()
+                                         << "to reset the network configuration failed";
         return false;
     }
-    qCDebug(configurationC) << "Reset the network configuration";
+    qCDebug(networkConfigurationC) << "Reset the network configuration";
     return true;
 }
 
@@ -110,7 +144,107 @@ QString NetworkConfiguration::subnet() const
 }
 
 NetworkConfiguration::NetworkConfiguration()
-    : m_subnetString{}
+    : m_subnetString{},
+      m_dhcpResponder{nullptr},
+      m_configuredNatively{false}
 {
 
 }
+
+bool NetworkConfiguration::setNatively(const QString &subnetString)
+{
+    // The subnet string is the address of the device followed by the prefix
+    // length. QHostAddress::parseSubnet() would mask away the host part.
+    const QStringList parts = subnetString.split('/');
+    bool ok = false;
+    const int prefixLength = parts.size() == 2 ? parts[1].toInt(&ok) : 0;
+    const QHostAddress address{parts.value(0)};
+    if (!ok || address.protocol() != QAbstractSocket::IPv4Protocol
+            || prefixLength < 1 || prefixLength > 30) {
+        qCWarning(networkConfigurationC) << "Invalid subnet" << subnetString;
+        return false;
+    }
+
+    // Offer the other usable address of the subnet to the host
+    const quint32 deviceAddress = address.toIPv4Address();
+    const quint32 mask = ~quint32{0} << (32 - prefixLength);
+    const quint32 network = deviceAddress & mask;
+    const quint32 broadcast = network | ~mask;
+    if (deviceAddress == network || deviceAddress == broadcast) {
+        qCWarning(networkConfigurationC) << "Device address in" << subnetString << "is not a host address";
+        return false;
+    }
+    const QHostAddress hostAddress{deviceAddress == network + 1 ? network + 2 : network + 1};
+
+    const QString interfaceName = usbEthernetInterfaceName();
+    const int interfaceIndex = RtNetlinkSocket::interfaceIndex(interfaceName);
+    if (interfaceIndex == 0) {
+        qCWarning(networkConfigurationC) << "Could not find network interface" << interfaceName;
+        return false;
+    }
+
+    RtNetlinkSocket netlink;
+    if (!netlink.open())
+        return false;
+
+    m_configuredNatively = true;
+    if (!netlink.flushAddresses(interfaceIndex)
+            || !netlink.addAddress(interfaceIndex, address, prefixLength)
+            || !netlink.setLinkUp(interfaceIndex, true)) {
+        return false;
+    }
+
+    // Started in this thread, so that a failure falls back to the script.
+    // The responder then serves from the main thread, since a worker that
+    // configures the network has no event loop of its own to spare.
+    auto responder = make_unique<DhcpResponder>();
+    if (!responder->start(interfaceName, address, hostAddress, prefixLength))
+        return false;
+
+    QCoreApplication *application = QCoreApplication::instance();
+    responder->moveToThread(application->thread());
+    DhcpResponder *movedResponder = responder.release();
+    QMetaObject::invokeMethod(application, [=]() {
+        // Parented in its own thread, so that it is deleted with the application
+        movedResponder->setParent(application);
+    });
+    m_dhcpResponder = movedResponder;
+
+    return true;
+}
+
+bool NetworkConfiguration::resetNatively()
+{
+    m_configuredNatively = false;
+
+    if (m_dhcpResponder) {
+        // Deleting the responder stops it, and a new one is created for the next subnet
+        m_dhcpResponder->deleteLater();
+        m_dhcpResponder = nullptr;
+    }
+
+    const QString interfaceName = usbEthernetInterfaceName();
+    const int interfaceIndex = RtNetlinkSocket::interfaceIndex(interfaceName);
+    if (interfaceIndex == 0) {
+        qCWarning(networkConfigurationC) << "Could not find network interface" << interfaceName;
+        return false;
+    }
+
+    RtNetlinkSocket netlink;
+    return netlink.open() && netlink.flushAddresses(interfaceIndex);
+}
+
+bool NetworkConfiguration::runScript(const QStringList &args)
+{
+    QProcess process;
+    process.setProcessChannelMode(QProcess::MergedChannels);
+    QObject::connect(&process, &QProcess::readyReadStandardOutput, &process, [&]() {
+        qCDebug(networkConfigurationC) << "Script:" << process.readAllStandardOutput();
+    });
+
+    qCDebug(networkConfigurationC) << "Running network configuration script" << Configuration::networkScript() << args;
+    process.start(Configuration::networkScript(), args);
+
+    process.waitForFinished();
+    return process.exitCode() == 0;
+}
@@ -32,13 +32,19 @@
 #include "libqdb/networkconfigurationcommon.h"
 
 #include <QtCore/qmutex.h>
+#include <QtCore/qpointer.h>
 #include <QtCore/qstring.h>
+#include <QtCore/qstringlist.h>
+
+class DhcpResponder;
 
 class NetworkConfiguration
 {
 public:
     static NetworkConfiguration *instance();
 
+    ~NetworkConfiguration();
+
     ConfigurationResult set(QString subnetString);
     bool reset();
 
@@ -49,8 +55,16 @@ public:
 private:
     NetworkConfiguration();
 
+    bool setNatively(const QString &subnetString);
+    bool resetNatively();
+    bool runScript(const QStringList &args);
+
     mutable QMutex m_lock;
     QString m_subnetString;
+    // Lives in the main thread and is owned by the application, which is
+    // destroyed before this singleton. The pointer is guarded by m_lock.
+    QPointer<DhcpResponder> m_dhcpResponder;
+    bool m_configuredNatively;
 };
 
 #endif // NETWORKCONFIGURATION_H
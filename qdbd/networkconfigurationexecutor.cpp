@@ -42,6 +42,11 @@ NetworkConfigurationExecutor::NetworkConfigurationExecutor(Stream *stream)
         connect(m_stream, &Stream::packetAvailable, this, &Executor::receive);
 }
 
+bool NetworkConfigurationExecutor::prefersWorkerThread() const
+{
+    return true;
+}
+
 void NetworkConfigurationExecutor::receive(StreamPacket packet)
 {
     QString subnetString;
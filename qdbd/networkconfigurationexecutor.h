@@ -39,6 +39,8 @@ class NetworkConfigurationExecutor : public Executor
 public:
     explicit NetworkConfigurationExecutor(Stream *stream);
 
+    bool prefersWorkerThread() const override;
+
 public slots:
     void receive(StreamPacket packet) override;
 
@@ -0,0 +1,80 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Debug Bridge.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+#include "notificationexecutor.h"
+
+#include "deviceidentity.h"
+#include "libqdb/notificationcommon.h"
+#include "libqdb/stream.h"
+
+#include <QtCore/qdebug.h>
+#include <QtCore/qloggingcategory.h>
+
+Q_LOGGING_CATEGORY(notificationExecutorC, "qdb.executors.notification");
+
+NotificationExecutor::NotificationExecutor(Stream *stream)
+    : m_stream{stream},
+      m_follows{false}
+{
+    if (m_stream)
+        QMetaObject::invokeMethod(this, &NotificationExecutor::subscribe, Qt::QueuedConnection);
+}
+
+void NotificationExecutor::receive(StreamPacket packet)
+{
+    Q_UNUSED(packet);
+    qCWarning(notificationExecutorC) << "Ignoring unexpected packet from the host";
+}
+
+void NotificationExecutor::subscribe()
+{
+    // Subscribe before taking the snapshot, so that no change falls in between
+    DeviceIdentity *deviceIdentity = DeviceIdentity::instance();
+    m_follows = deviceIdentity->followsIpAddress();
+    if (m_follows) {
+        connect(deviceIdentity, &DeviceIdentity::ipAddressChanged,
+                this, &NotificationExecutor::handleIpAddressChanged);
+    }
+    sendAddress(deviceIdentity->snapshot().ipAddress);
+}
+
+void NotificationExecutor::handleIpAddressChanged(QString ipAddress)
+{
+    sendAddress(ipAddress);
+    qCDebug(notificationExecutorC) << "Sent changed IP address" << ipAddress;
+}
+
+void NotificationExecutor::sendAddress(const QString &ipAddress)
+{
+    StreamPacket packet;
+    packet << static_cast<uint32_t>(NotificationMessage::Address);
+    packet << ipAddress;
+    // Without address notifications the host has to keep polling
+    packet << m_follows;
+    m_stream->write(packet);
+}
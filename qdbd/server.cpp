@@ -28,29 +28,54 @@
 ****************************************************************************/
 #include "server.h"
 
+#include "configuration.h"
 #include "createexecutor.h"
 #include "echoexecutor.h"
+#include "executor.h"
 #include "libqdb/make_unique.h"
 #include "libqdb/protocol/qdbmessage.h"
 #include "libqdb/protocol/qdbtransport.h"
 #include "libqdb/stream.h"
+#include "libqdb/workerthreadpool.h"
 
 #include <QtCore/qdebug.h>
 #include <QtCore/qloggingcategory.h>
+#include <QtCore/qrandom.h>
+#include <QtCore/qthread.h>
 
 #include <algorithm>
+#include <limits>
 
-Q_LOGGING_CATEGORY(connectionC, "qdb.connection");
+Q_LOGGING_CATEGORY(serverC, "qdb.connection");
 
 Server::Server(QdbTransport *transport, QObject *parent)
     : AbstractConnection{transport, parent},
       m_state{ServerState::Disconnected},
-      m_executors{}
+      m_sessionToken{0},
+      m_unacknowledgedStream{0},
+      m_unacknowledgedBytes{0},
+      m_capabilities{0},
+      m_heartbeatWatchdog{this},
+      m_executorPool{nullptr},
+      m_executors{},
+      m_executorThreads{}
 {
+    m_heartbeatWatchdog.setSingleShot(true);
+    connect(&m_heartbeatWatchdog, &QTimer::timeout, this, &Server::handleHeartbeatTimeout);
 
+    if (Configuration::executorThreadCount() > 0) {
+        m_executorPool = make_unique<WorkerThreadPool>(QString{"Executor"},
+                                                       Configuration::executorThreadCount());
+    }
 }
 
-Server::~Server() = default;
+Server::~Server()
+{
+    // Join the workers first, so executors and streams living in them can be
+    // destroyed from this thread along with the rest of the server. Those
+    // closed earlier are deleted by the pool before it joins the workers.
+    m_executorPool.reset();
+}
 
 void Server::handleMessage()
 {
@@ -62,10 +87,19 @@ void Server::handleMessage()
     if (message.command() == QdbMessage::Refuse)
         qFatal("Server received Refuse message, which is not supported");
 
+    if (m_heartbeatWatchdog.isActive())
+        m_heartbeatWatchdog.start();
+
+    // Heartbeats do not take part in the acknowledgements
+    if (message.command() == QdbMessage::Ping || message.command() == QdbMessage::Pong) {
+        handleHeartbeat(message);
+        return;
+    }
+
     switch (m_state) {
     case ServerState::Disconnected:
         if (message.command() != QdbMessage::Connect) {
-            qCWarning(connectionC) << "Server got non-Connect message in Disconnected state. Refusing.";
+            qCWarning(serverC) << "Server got non-Connect message in Disconnected state. Refusing.";
             refuse(RefuseReason::NotConnected);
             break;
         }
@@ -74,7 +108,7 @@ void Server::handleMessage()
     case ServerState::Connected:
         switch (message.command()) {
         case QdbMessage::Connect:
-            qCWarning(connectionC) << "Server received QdbMessage::Connect while already connected. Resetting.";
+            qCWarning(serverC) << "Server received QdbMessage::Connect while already connected. Resetting.";
             handleConnect(message.data());
             break;
         case QdbMessage::Open:
@@ -87,10 +121,14 @@ void Server::handleMessage()
             closeStream(message.deviceStream());
             break;
         case QdbMessage::Ok:
-            qCWarning(connectionC) << "Server received QdbMessage::Ok in connected state";
+            qCWarning(serverC) << "Server received QdbMessage::Ok in connected state";
             break;
         case QdbMessage::Refuse:
             //[[fallthrough]]
+        case QdbMessage::Ping:
+            //[[fallthrough]]
+        case QdbMessage::Pong:
+            //[[fallthrough]]
         case QdbMessage::Invalid:
             Q_UNREACHABLE();
             break;
@@ -99,7 +137,7 @@ void Server::handleMessage()
     case ServerState::Waiting:
         switch (message.command()) {
         case QdbMessage::Connect:
-            qCWarning(connectionC) << "Server received QdbMessage::Connect while already connected and waiting. Resetting.";
+            qCWarning(serverC) << "Server received QdbMessage::Connect while already connected and waiting. Resetting.";
             handleConnect(message.data());
             break;
         case QdbMessage::Open:
@@ -114,9 +152,14 @@ void Server::handleMessage()
             break;
         case QdbMessage::Ok:
             m_state = ServerState::Connected;
+            acknowledgeWrite();
             break;
         case QdbMessage::Refuse:
             //[[fallthrough]]
+        case QdbMessage::Ping:
+            //[[fallthrough]]
+        case QdbMessage::Pong:
+            //[[fallthrough]]
         case QdbMessage::Invalid:
             Q_UNREACHABLE();
             break;
@@ -128,19 +171,38 @@ void Server::handleMessage()
 
 void Server::enqueueMessage(const QdbMessage &message)
 {
+    if (QThread::currentThread() != thread()) {
+        // Executors in the worker pool write through their streams from the
+        // worker thread, hand the message over to the thread of the server.
+        // Messages from one stream stay in order since they are posted in order.
+        QMetaObject::invokeMethod(this, [this, message]() {
+            enqueueFromWorker(message);
+        }, Qt::QueuedConnection);
+        return;
+    }
+
     Q_ASSERT(message.command() != QdbMessage::Invalid);
-    qCDebug(connectionC) << "Server enqueue: " << message;
+    qCDebug(serverC) << "Server enqueue: " << message;
     m_outgoingMessages.enqueue(message);
     processQueue();
 }
 
+void Server::enqueueFromWorker(const QdbMessage &message)
+{
+    if (m_streams.find(message.deviceStream()) == m_streams.end()) {
+        qCDebug(serverC) << "Server dropping message from worker to closed stream" << message;
+        return;
+    }
+    enqueueMessage(message);
+}
+
 void Server::processQueue()
 {
     if (m_outgoingMessages.isEmpty())
         return;
 
     if (m_state == ServerState::Waiting) {
-        qCDebug(connectionC) << "Server::processQueue() skipping to wait for QdbMessage::Ok";
+        qCDebug(serverC) << "Server::processQueue() skipping to wait for QdbMessage::Ok";
         return;
     }
 
@@ -150,7 +212,7 @@ void Server::processQueue()
                "Tried to send invalid message");
 
     if (!m_transport->send(message)) {
-        qCCritical(connectionC) << "Server could not send" << message;
+        qCCritical(serverC) << "Server could not send" << message;
         m_state = ServerState::Disconnected;
         return;
     }
@@ -162,9 +224,17 @@ void Server::processQueue()
     case QdbMessage::Open:
         qFatal("Server sending QdbMessage::Open is not supported");
         break;
+    case QdbMessage::Ping:
+        //[[fallthrough]]
+    case QdbMessage::Pong:
+        // Heartbeats are sent directly
+        Q_UNREACHABLE();
+        break;
     case QdbMessage::Write:
         Q_ASSERT(m_state == ServerState::Connected);
         m_state = ServerState::Waiting;
+        m_unacknowledgedStream = message.deviceStream();
+        m_unacknowledgedBytes = message.data().size();
         break;
         // Connect, Close and Ok are not acknowledged when sent by server,
         // so no need to transition to ServerState::Waiting.
@@ -193,14 +263,100 @@ void Server::handleConnect(const QByteArray &payload)
         return;
     }
 
-    resetServer();
+    // Hosts that support resuming sessions send a session token after the
+    // version, 0 when they want a new session. Older hosts send only the version.
+    QDataStream dataStream{payload};
+    uint32_t protocolVersion = 0;
+    uint32_t requestedToken = 0;
+    dataStream >> protocolVersion;
+    const bool hostHasSessions = static_cast<size_t>(payload.size())
+            >= sizeof(protocolVersion) + sizeof(requestedToken);
+    if (hostHasSessions)
+        dataStream >> requestedToken;
+    // Newer hosts follow with their capabilities and heartbeat interval
+    uint32_t hostCapabilities = 0;
+    uint32_t heartbeatInterval = 0;
+    const bool hostHasCapabilities = static_cast<size_t>(payload.size())
+            >= sizeof(protocolVersion) + sizeof(requestedToken) + sizeof(hostCapabilities)
+               + sizeof(heartbeatInterval);
+    if (hostHasCapabilities)
+        dataStream >> hostCapabilities >> heartbeatInterval;
+    m_capabilities = hostCapabilities & qdbCapabilities;
+
+    if (hostHasSessions && requestedToken != 0 && requestedToken == m_sessionToken) {
+        resumeSession();
+    } else {
+        resetServer();
+        m_sessionToken = 0;
+        while (hostHasSessions && m_sessionToken == 0)
+            m_sessionToken = QRandomGenerator::global()->generate();
+    }
     m_state = ServerState::Connected;
 
     QByteArray buffer{};
-    QDataStream dataStream{&buffer, QIODevice::WriteOnly};
-    dataStream << qdbProtocolVersion;
+    QDataStream replyStream{&buffer, QIODevice::WriteOnly};
+    replyStream << qdbProtocolVersion;
+    if (hostHasSessions)
+        replyStream << m_sessionToken;
+    // The host keeps the subnet of an unplugged device for as long as qdbd
+    // keeps the network configuration
+    if (hostHasCapabilities)
+        replyStream << m_capabilities << static_cast<uint32_t>(Configuration::resumeGracePeriod());
+
+    if ((m_capabilities & HeartbeatCapability) && heartbeatInterval > 0) {
+        // Never before the host could resume the session after a USB link hiccup
+        const qint64 missed = static_cast<qint64>(qdbMissedHeartbeatLimit) * heartbeatInterval;
+        const qint64 timeout = std::max<qint64>(missed, Configuration::resumeGracePeriod());
+        m_heartbeatWatchdog.start(static_cast<int>(std::min<qint64>(timeout, std::numeric_limits<int>::max())));
+    } else {
+        m_heartbeatWatchdog.stop();
+    }
 
-    enqueueMessage(QdbMessage{QdbMessage::Connect, 0, 0, buffer});
+    m_outgoingMessages.enqueue(QdbMessage{QdbMessage::Connect, 0, 0, buffer});
+    processQueue();
+}
+
+void Server::handleHeartbeat(const QdbMessage &message)
+{
+    if (m_state == ServerState::Disconnected)
+        return;
+
+    if (message.command() == QdbMessage::Pong)
+        return; // The device does not measure the link
+
+    if (!m_transport->send(QdbMessage{QdbMessage::Pong, 0, 0, message.data()})) {
+        qCCritical(serverC) << "Server could not answer heartbeat";
+        m_state = ServerState::Disconnected;
+    }
+}
+
+void Server::handleHeartbeatTimeout()
+{
+    qCWarning(serverC) << "Host has not sent heartbeats for" << m_heartbeatWatchdog.interval()
+                       << "ms, closing the session";
+    invalidateSession();
+    resetServer();
+    m_state = ServerState::Disconnected;
+    m_capabilities = 0;
+}
+
+void Server::resumeSession()
+{
+    qCDebug(serverC) << "Resuming session" << m_sessionToken;
+
+    // The session outlives the connection of the host, but its streams do
+    // not: the host numbers the streams of its new connection from the start
+    // again, so streams kept from before would collide with them. Nor can a
+    // Write that was waiting for Ok continue without losing or duplicating
+    // data. Drop the streams without telling the host, which already has.
+    resetServer();
+}
+
+void Server::invalidateSession()
+{
+    if (m_sessionToken != 0)
+        qCDebug(serverC) << "Session" << m_sessionToken << "can no longer be resumed";
+    m_sessionToken = 0;
 }
 
 void Server::handleOpen(StreamId hostId, const QByteArray &tag)
@@ -208,7 +364,17 @@ void Server::handleOpen(StreamId hostId, const QByteArray &tag)
     StreamId deviceId = m_nextStreamId++;
     enqueueMessage(QdbMessage{QdbMessage::Ok, hostId, deviceId});
     m_streams[deviceId] = make_unique<Stream>(this, hostId, deviceId);
-    m_executors[deviceId] = createExecutor(m_streams[deviceId].get(), tag);
+    auto executor = createExecutor(m_streams[deviceId].get(), tag);
+
+    if (executor && m_executorPool && executor->prefersWorkerThread()) {
+        // The stream moves along with its executor, so that packets reach the
+        // executor in order and the executor can write without locking.
+        QThread *worker = m_executorPool->acquire();
+        m_streams[deviceId]->moveToThread(worker);
+        executor->moveToThread(worker);
+        m_executorThreads[deviceId] = worker;
+    }
+    m_executors[deviceId] = std::move(executor);
 }
 
 void Server::refuse(RefuseReason reason)
@@ -228,31 +394,61 @@ void Server::refuse(RefuseReason reason)
 void Server::resetServer()
 {
     m_outgoingMessages.clear();
+    while (!m_streams.empty())
+        destroyStream(m_streams.begin()->first);
     m_executors.clear();
-    m_streams.clear();
 }
 
 void Server::handleWrite(const QdbMessage &message)
 {
     if (m_streams.find(message.deviceStream()) == m_streams.end()) {
-        qCWarning(connectionC) << "Server received message to non-existing stream" << message.deviceStream();
+        qCWarning(serverC) << "Server received message to non-existing stream" << message.deviceStream();
         enqueueMessage(QdbMessage{QdbMessage::Close, message.hostStream(), message.deviceStream()});
         return;
     }
     enqueueMessage(QdbMessage{QdbMessage::Ok, message.hostStream(), message.deviceStream()});
-    m_streams[message.deviceStream()]->receiveMessage(message);
+    deliverToStream(message);
+}
+
+void Server::deliverToStream(const QdbMessage &message)
+{
+    Stream *stream = m_streams[message.deviceStream()].get();
+    if (m_executorThreads.find(message.deviceStream()) == m_executorThreads.end()) {
+        stream->receiveMessage(message);
+        return;
+    }
+
+    QMetaObject::invokeMethod(stream, [stream, message]() {
+        stream->receiveMessage(message);
+    }, Qt::QueuedConnection);
+}
+
+void Server::acknowledgeWrite()
+{
+    const auto iter = m_streams.find(m_unacknowledgedStream);
+    if (iter == m_streams.end())
+        return;
+
+    Stream *stream = iter->second.get();
+    const int bytes = m_unacknowledgedBytes;
+    if (m_executorThreads.find(m_unacknowledgedStream) == m_executorThreads.end()) {
+        stream->acknowledgeWrite(bytes);
+        return;
+    }
+
+    QMetaObject::invokeMethod(stream, [stream, bytes]() {
+        stream->acknowledgeWrite(bytes);
+    }, Qt::QueuedConnection);
 }
 
 void Server::closeStream(StreamId id)
 {
     if (m_streams.find(id) == m_streams.end()) {
-        qCWarning(connectionC) << "Server received Close to a non-existing stream" << id;
+        qCWarning(serverC) << "Server received Close to a non-existing stream" << id;
         return;
     }
 
-    m_streams[id]->close();
-    m_executors.erase(id);
-    m_streams.erase(id);
+    destroyStream(id);
 
     auto messageInStream = [&id](const QdbMessage &message) {
         return message.deviceStream() == id;
@@ -263,10 +459,38 @@ void Server::closeStream(StreamId id)
     // Closes are not acknowledged
 }
 
+void Server::destroyStream(StreamId id)
+{
+    std::unique_ptr<Stream> stream = std::move(m_streams[id]);
+    std::unique_ptr<Executor> executor = std::move(m_executors[id]);
+    m_streams.erase(id);
+    m_executors.erase(id);
+
+    const auto threadIter = m_executorThreads.find(id);
+    if (threadIter == m_executorThreads.end()) {
+        stream->close();
+        return; // Executor is destroyed before the stream when leaving the scope
+    }
+
+    m_executorPool->release(threadIter->second);
+    m_executorThreads.erase(threadIter);
+
+    // Both live in a worker thread, so they have to be closed and destroyed
+    // there after any packets already posted to them have been handled.
+    Stream *workerStream = stream.release();
+    Executor *workerExecutor = executor.release();
+    QMetaObject::invokeMethod(workerStream, [workerStream, workerExecutor]() {
+        workerStream->close();
+        if (workerExecutor)
+            workerExecutor->deleteLater();
+        workerStream->deleteLater();
+    }, Qt::QueuedConnection);
+}
+
 bool Server::checkVersion(const QByteArray &payload)
 {
     if (static_cast<size_t>(payload.size()) < sizeof(qdbProtocolVersion)) {
-       qCCritical(connectionC) << "Connection request did not contain a protocol version";
+       qCCritical(serverC) << "Connection request did not contain a protocol version";
        return false;
     };
 
@@ -275,8 +499,8 @@ bool Server::checkVersion(const QByteArray &payload)
     dataStream >> protocolVersion;
 
     if (protocolVersion != qdbProtocolVersion) {
-        qCWarning(connectionC) << "Protocol version" << protocolVersion << "requested, but only version"
-                               << qdbProtocolVersion << "is known";
+        qCWarning(serverC) << "Protocol version" << protocolVersion << "requested, but only version"
+                           << qdbProtocolVersion << "is known";
         return false;
     }
     return true;
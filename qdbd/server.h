@@ -34,6 +34,12 @@
 class Executor;
 class QdbMessage;
 class QdbTransport;
+class WorkerThreadPool;
+QT_BEGIN_NAMESPACE
+class QThread;
+QT_END_NAMESPACE
+
+#include <QtCore/qtimer.h>
 
 #include <memory>
 #include <unordered_map>
@@ -58,19 +64,42 @@ signals:
 
 public slots:
     void handleMessage() override;
+    void invalidateSession();
+
+private slots:
+    void handleHeartbeatTimeout();
 
 private:
     void processQueue();
+    void enqueueFromWorker(const QdbMessage &message);
     void handleConnect(const QByteArray &payload);
+    void handleHeartbeat(const QdbMessage &message);
+    void resumeSession();
     void handleOpen(StreamId hostId, const QByteArray &tag);
     void refuse(RefuseReason reason);
     void resetServer();
     void handleWrite(const QdbMessage &message);
     void closeStream(StreamId id);
+    void destroyStream(StreamId id);
+    void deliverToStream(const QdbMessage &message);
+    void acknowledgeWrite();
     bool checkVersion(const QByteArray &payload);
 
     ServerState m_state;
+    // Identifies the session to hosts that reconnect after a USB link hiccup,
+    // 0 if there is no session that could be resumed.
+    uint32_t m_sessionToken;
+    // Stream and size of the Write that is waiting for Ok in ServerState::Waiting
+    StreamId m_unacknowledgedStream;
+    int m_unacknowledgedBytes;
+    // Capabilities supported by both sides in the current connection
+    uint32_t m_capabilities;
+    // Fires when the host has sent nothing for too long while sending heartbeats
+    QTimer m_heartbeatWatchdog;
+    std::unique_ptr<WorkerThreadPool> m_executorPool;
     std::unordered_map<StreamId, std::unique_ptr<Executor>> m_executors;
+    // Streams whose executor runs in m_executorPool, with the thread they were given
+    std::unordered_map<StreamId, QThread *> m_executorThreads;
 };
 
 #endif // SERVER_H
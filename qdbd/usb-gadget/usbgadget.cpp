@@ -129,7 +129,6 @@ UsbGadget::UsbGadget()
     : m_controlEndpoint(Configuration::functionFsDir() + "/ep0"),
       m_outEndpoint(Configuration::functionFsDir() + "/ep1"),
       m_inEndpoint(Configuration::functionFsDir() + "/ep2"),
-      m_controlThread{nullptr},
       m_readThread{nullptr},
       m_writeThread{nullptr},
       m_control{nullptr},
@@ -142,17 +141,16 @@ UsbGadget::UsbGadget()
 
 UsbGadget::~UsbGadget()
 {
-    if (m_controlThread) {
-        m_controlThread->terminate();
-        m_controlThread->wait();
-    }
+    // Stop watching the control endpoint before it gets closed below
+    m_control.reset();
+
     if (m_readThread) {
         m_readThread->terminate();
         m_readThread->wait();
     }
     if (m_writeThread) {
         m_writeThread->terminate();
-        m_readThread->wait();
+        m_writeThread->wait();
     }
 
     // Disable USB gadget configuration
@@ -203,9 +201,9 @@ bool UsbGadget::open(QIODevice::OpenMode mode)
     }
     qCDebug(usbC) << "Initialized function fs";
 
-    startControlThread();
     startReadThread();
     startWriteThread();
+    startControl();
     initializeGadgetWithUdc();
 
     return true;
@@ -241,17 +239,15 @@ void UsbGadget::dataRead(QByteArray data)
     emit readyRead();
 }
 
-void UsbGadget::startControlThread()
+void UsbGadget::startControl()
 {
+    // The control endpoint is quiet most of the time, so it is watched from
+    // the event loop of this thread instead of blocking a thread of its own.
+    // The writer thread would not do, it blocks in bulk writes while the host
+    // is not reading.
     m_control = make_unique<UsbGadgetControl>(&m_controlEndpoint);
-    m_controlThread = make_unique<QThread>();
-
-    connect(m_controlThread.get(), &QThread::started,
-            m_control.get(), &UsbGadgetControl::monitor);
-
-    m_control->moveToThread(m_controlThread.get());
-    m_controlThread->setObjectName("UsbGadgetControl");
-    m_controlThread->start();
+    connect(m_control.get(), &UsbGadgetControl::linkLost, this, &UsbGadget::linkLost);
+    m_control->monitor();
 }
 
 void UsbGadget::startReadThread()
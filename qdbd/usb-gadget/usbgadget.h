@@ -55,6 +55,7 @@ public:
 
 signals:
     void writeAvailable(QByteArray data);
+    void linkLost();
 
 protected:
     qint64 readData(char *data, qint64 maxSize) override;
@@ -65,7 +66,7 @@ private slots:
 
 private:
     bool openControlEndpoint();
-    void startControlThread();
+    void startControl();
     void startReadThread();
     void startWriteThread();
     void initializeGadgetWithUdc();
@@ -75,7 +76,6 @@ private:
     // gadget and in means from gadget to host.
     QFile m_outEndpoint;
     QFile m_inEndpoint;
-    std::unique_ptr<QThread> m_controlThread;
     std::unique_ptr<QThread> m_readThread;
     std::unique_ptr<QThread> m_writeThread;
     std::unique_ptr<UsbGadgetControl> m_control;
@@ -28,14 +28,21 @@
 ****************************************************************************/
 #include "usbgadgetcontrol.h"
 
+#include "configuration.h"
 #include "networkconfiguration.h"
 
 #include <QtCore/qdebug.h>
 #include <QtCore/qfile.h>
 #include <QtCore/qloggingcategory.h>
+#include <QtCore/qsocketnotifier.h>
 #include <QtCore/qtimer.h>
 
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
 #include <linux/usb/functionfs.h>
+#include <unistd.h>
 
 Q_DECLARE_LOGGING_CATEGORY(usbC);
 
@@ -63,10 +70,15 @@ QString eventTypeName(usb_functionfs_event_type eventType)
     return QLatin1String("(unknown)");
 }
 
+// FunctionFS hands out as many queued events as fit into the read buffer
+const int maxEventsPerRead = 4;
+
 } // anonymous namespace
 
 UsbGadgetControl::UsbGadgetControl(QFile *controlEndpoint)
-    : m_controlEndpoint{controlEndpoint}
+    : m_controlEndpoint{controlEndpoint},
+      m_notifier{nullptr},
+      m_graceTimer{nullptr}
 {
 
 }
@@ -78,26 +90,85 @@ void UsbGadgetControl::monitor()
         return;
     }
 
-    QTimer::singleShot(0, this, &UsbGadgetControl::monitor);
+    const int descriptor = m_controlEndpoint->handle();
+    const int flags = ::fcntl(descriptor, F_GETFL);
+    if (flags == -1 || ::fcntl(descriptor, F_SETFL, flags | O_NONBLOCK) == -1) {
+        qCCritical(usbC) << "Could not make control endpoint non-blocking:" << strerror(errno);
+        return;
+    }
+
+    m_graceTimer = new QTimer{this};
+    m_graceTimer->setSingleShot(true);
+    m_graceTimer->setInterval(Configuration::resumeGracePeriod());
+    connect(m_graceTimer, &QTimer::timeout, this, &UsbGadgetControl::handleLinkLost);
+
+    m_notifier = new QSocketNotifier{descriptor, QSocketNotifier::Read, this};
+    connect(m_notifier, &QSocketNotifier::activated, this, &UsbGadgetControl::readEvents);
 
+    // Events may have been queued before the notifier was created
+    readEvents();
+}
+
+void UsbGadgetControl::readEvents()
+{
     const auto eventSize = sizeof(usb_functionfs_event);
+    usb_functionfs_event events[maxEventsPerRead];
 
-    QByteArray buffer{eventSize, '\0'};
-    int count = m_controlEndpoint->read(buffer.data(), buffer.size());
-    if (count == -1) {
-        qCWarning(usbC) << "Could not read FFS event from control endpoint";
-        return;
-    } else if (count < buffer.size()) {
-        qCWarning(usbC) << "Could only read" << count << "out of" << buffer.size()
-                        << "byte event from control endpoint";
-        return;
+    for (;;) {
+        const ssize_t count = ::read(m_controlEndpoint->handle(), events, sizeof(events));
+        if (count == -1) {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                qCWarning(usbC) << "Could not read FFS event from control endpoint:" << strerror(errno);
+            return;
+        }
+        if (count == 0)
+            return;
+        if (count % eventSize != 0) {
+            qCWarning(usbC) << "Read" << count << "bytes from control endpoint, which is not a"
+                            << "multiple of the" << eventSize << "byte event size";
+        }
+
+        const int eventCount = static_cast<int>(count / eventSize);
+        for (int i = 0; i < eventCount; ++i)
+            handleEvent(events[i].type);
+
+        if (eventCount < maxEventsPerRead)
+            return; // Drained all queued events
     }
+}
+
+void UsbGadgetControl::handleEvent(int eventType)
+{
+    const auto type = static_cast<usb_functionfs_event_type>(eventType);
+    qCDebug(usbC) << "USB FFS event:" << eventTypeName(type);
 
-    const auto *event = reinterpret_cast<usb_functionfs_event *>(buffer.data());
-    const auto eventType = static_cast<usb_functionfs_event_type>(event->type);
-    qCDebug(usbC) << "USB FFS event:" << eventTypeName(eventType);
-    if (eventType == FUNCTIONFS_DISABLE || eventType == FUNCTIONFS_SUSPEND) {
-        auto *networkConfiguration = NetworkConfiguration::instance();
-        networkConfiguration->reset();
+    switch (type) {
+    case FUNCTIONFS_DISABLE:
+        //[[fallthrough]]
+    case FUNCTIONFS_SUSPEND:
+        // Keep the network configuration for a while, the host can resume
+        // the session if the link comes back soon enough.
+        if (!m_graceTimer->isActive())
+            m_graceTimer->start();
+        break;
+    case FUNCTIONFS_ENABLE:
+        //[[fallthrough]]
+    case FUNCTIONFS_RESUME:
+        if (m_graceTimer->isActive()) {
+            qCDebug(usbC) << "USB link came back within the resume grace period";
+            m_graceTimer->stop();
+        }
+        break;
+    default:
+        break;
     }
 }
+
+void UsbGadgetControl::handleLinkLost()
+{
+    qCDebug(usbC) << "USB link was down longer than" << m_graceTimer->interval() << "ms";
+    NetworkConfiguration::instance()->reset();
+    emit linkLost();
+}
@@ -32,19 +32,35 @@
 #include <QtCore/qobject.h>
 QT_BEGIN_NAMESPACE
 class QFile;
+class QSocketNotifier;
+class QTimer;
 QT_END_NAMESPACE
 
+// Handles the FunctionFS events from the control endpoint. Does not need a
+// thread of its own, events are read only when the endpoint has some queued.
 class UsbGadgetControl : public QObject
 {
     Q_OBJECT
 public:
     UsbGadgetControl(QFile *controlEndpoint);
 
+signals:
+    //! The link was disabled or suspended for longer than the resume grace period
+    void linkLost();
+
 public slots:
     void monitor();
 
+private slots:
+    void readEvents();
+    void handleLinkLost();
+
 private:
+    void handleEvent(int eventType);
+
     QFile *m_controlEndpoint;
+    QSocketNotifier *m_notifier;
+    QTimer *m_graceTimer;
 };
 
 #endif // USBGADGETCONTROL_H
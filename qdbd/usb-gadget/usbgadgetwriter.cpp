@@ -56,6 +56,7 @@ void UsbGadgetWriter::write(QByteArray data)
     if (written != data.size()) {
         qCCritical(usbC) << "Could not write to endpoint";
         emit writeDone(false);
+        return;
     }
     emit writeDone(true);
 }
@@ -0,0 +1,182 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Debug Bridge.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+#include "../qdb/server/bringupscheduler.h"
+
+#include <QtTest>
+
+namespace {
+
+UsbDevice usbDevice(const QString &serial)
+{
+    UsbDevice device;
+    device.serial = serial;
+    device.address = UsbAddress{1, 1};
+    return device;
+}
+
+} // anonymous namespace
+
+class tst_BringUpScheduler : public QObject
+{
+    Q_OBJECT
+private slots:
+    void startsUpToLimit();
+    void configuredReleasesSlot();
+    void finishReleasesSlot();
+    void finishAfterConfiguredKeepsCount();
+    void cancelReleasesSlot();
+    void cancelDropsQueued();
+    void rescheduleStartsOver();
+    void raisingLimitStartsQueued();
+
+private:
+    BringUpScheduler scheduler(int maxParallel);
+
+    QStringList m_started;
+};
+
+BringUpScheduler tst_BringUpScheduler::scheduler(int maxParallel)
+{
+    m_started.clear();
+    BringUpScheduler scheduler{[this](const UsbDevice &device) {
+        m_started.append(device.serial);
+    }};
+    scheduler.setMaxParallel(maxParallel);
+    return scheduler;
+}
+
+void tst_BringUpScheduler::startsUpToLimit()
+{
+    auto bringUps = scheduler(2);
+    bringUps.schedule(usbDevice("a"));
+    bringUps.schedule(usbDevice("b"));
+    bringUps.schedule(usbDevice("c"));
+
+    QCOMPARE(m_started, (QStringList{"a", "b"}));
+}
+
+void tst_BringUpScheduler::configuredReleasesSlot()
+{
+    auto bringUps = scheduler(1);
+    bringUps.schedule(usbDevice("a"));
+    bringUps.schedule(usbDevice("b"));
+
+    bringUps.markConfigured("a");
+    QCOMPARE(m_started, (QStringList{"a", "b"}));
+
+    // Marking again does not free a second slot
+    bringUps.schedule(usbDevice("c"));
+    bringUps.markConfigured("a");
+    QCOMPARE(m_started, (QStringList{"a", "b"}));
+}
+
+void tst_BringUpScheduler::finishReleasesSlot()
+{
+    auto bringUps = scheduler(1);
+    bringUps.schedule(usbDevice("a"));
+    bringUps.schedule(usbDevice("b"));
+    bringUps.schedule(usbDevice("c"));
+
+    bringUps.finish("a", false);
+    QCOMPARE(m_started, (QStringList{"a", "b"}));
+    bringUps.finish("b", true);
+    QCOMPARE(m_started, (QStringList{"a", "b", "c"}));
+}
+
+void tst_BringUpScheduler::finishAfterConfiguredKeepsCount()
+{
+    auto bringUps = scheduler(1);
+    bringUps.schedule(usbDevice("a"));
+    bringUps.markConfigured("a");
+    bringUps.schedule(usbDevice("b"));
+    bringUps.schedule(usbDevice("c"));
+
+    // The slot of a was released already, so finishing it must not free another one
+    bringUps.finish("a", true);
+    QCOMPARE(m_started, (QStringList{"a", "b"}));
+}
+
+void tst_BringUpScheduler::cancelReleasesSlot()
+{
+    auto bringUps = scheduler(1);
+    bringUps.schedule(usbDevice("a"));
+    bringUps.schedule(usbDevice("b"));
+
+    bringUps.cancel("a");
+    QCOMPARE(m_started, (QStringList{"a", "b"}));
+
+    // Unknown devices are ignored
+    bringUps.cancel("x");
+    bringUps.finish("x", true);
+    bringUps.markConfigured("x");
+    bringUps.schedule(usbDevice("c"));
+    QCOMPARE(m_started, (QStringList{"a", "b"}));
+}
+
+void tst_BringUpScheduler::cancelDropsQueued()
+{
+    auto bringUps = scheduler(1);
+    bringUps.schedule(usbDevice("a"));
+    bringUps.schedule(usbDevice("b"));
+    bringUps.schedule(usbDevice("c"));
+
+    bringUps.cancel("b");
+    bringUps.finish("a", true);
+    QCOMPARE(m_started, (QStringList{"a", "c"}));
+}
+
+void tst_BringUpScheduler::rescheduleStartsOver()
+{
+    auto bringUps = scheduler(1);
+    bringUps.schedule(usbDevice("a"));
+    bringUps.schedule(usbDevice("b"));
+
+    // A replugged device gives up its slot and queues again
+    bringUps.schedule(usbDevice("a"));
+    QCOMPARE(m_started, (QStringList{"a", "b"}));
+    bringUps.finish("b", true);
+    QCOMPARE(m_started, (QStringList{"a", "b", "a"}));
+}
+
+void tst_BringUpScheduler::raisingLimitStartsQueued()
+{
+    auto bringUps = scheduler(1);
+    bringUps.schedule(usbDevice("a"));
+    bringUps.schedule(usbDevice("b"));
+    bringUps.schedule(usbDevice("c"));
+
+    bringUps.setMaxParallel(3);
+    QCOMPARE(m_started, (QStringList{"a", "b", "c"}));
+
+    bringUps.setMaxParallel(0);
+    QCOMPARE(bringUps.maxParallel(), 1);
+}
+
+QTEST_APPLESS_MAIN(tst_BringUpScheduler)
+#include "tst_bringupscheduler.moc"
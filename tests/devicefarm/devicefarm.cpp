@@ -0,0 +1,437 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Debug Bridge.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+#include "libqdb/make_unique.h"
+#include "libqdb/protocol/qdbtransport.h"
+#include "libqdb/workerthreadpool.h"
+#include "loopbackdevice.h"
+#include "qdb/server/deviceenumerator.h"
+#include "qdb/server/devicemanager.h"
+#include "qdbd/configuration.h"
+#include "qdbd/deviceidentity.h"
+#include "qdbd/server.h"
+
+#include <QtCore/qcommandlineparser.h>
+#include <QtCore/qcoreapplication.h>
+#include <QtCore/qdeadlinetimer.h>
+#include <QtCore/qdebug.h>
+#include <QtCore/qdir.h>
+#include <QtCore/qelapsedtimer.h>
+#include <QtCore/qeventloop.h>
+#include <QtCore/qfile.h>
+#include <QtCore/qfileinfo.h>
+#include <QtCore/qloggingcategory.h>
+#include <QtCore/qstandardpaths.h>
+#include <QtCore/qtemporarydir.h>
+#include <QtCore/qtimer.h>
+
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include <sys/resource.h>
+
+// Measures how the host side scales with the number of attached devices.
+// Each simulated device is a qdbd Server at the far end of a loopback link,
+// which the device manager finds and opens instead of a USB device, so the
+// bring-up goes through the same scheduling, bootstrap, registry and
+// notifications as with real devices. Everything runs in this process, so
+// the CPU, memory and thread figures include the simulated devices, which
+// run in a fixed number of threads.
+
+namespace {
+
+const int defaultSettleTime = 5; // in seconds
+const int defaultDeviceThreads = 2;
+const int readyTimeout = 60000; // in ms
+const int devicesPerBus = 127;
+
+struct ProcessUsage
+{
+    qint64 cpuTime; // user and system time in microseconds
+    qint64 residentSize; // in KiB
+    int threadCount;
+};
+
+ProcessUsage processUsage()
+{
+    ProcessUsage usage{0, 0, 0};
+
+    rusage resources;
+    if (getrusage(RUSAGE_SELF, &resources) == 0) {
+        usage.cpuTime = (resources.ru_utime.tv_sec + resources.ru_stime.tv_sec) * 1000000
+                + resources.ru_utime.tv_usec + resources.ru_stime.tv_usec;
+    }
+
+    QFile status{"/proc/self/status"};
+    if (!status.open(QIODevice::ReadOnly))
+        return usage;
+    for (const QByteArray &line : status.readAll().split('\n')) {
+        const QList<QByteArray> fields = line.simplified().split(' ');
+        if (fields.size() < 2)
+            continue;
+        if (fields[0] == "VmRSS:")
+            usage.residentSize = fields[1].toLongLong();
+        else if (fields[0] == "Threads:")
+            usage.threadCount = fields[1].toInt();
+    }
+    return usage;
+}
+
+double percentile(const std::vector<double> &sorted, double fraction)
+{
+    if (sorted.empty())
+        return 0.0;
+    const auto index = static_cast<size_t>(fraction * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+bool waitFor(const std::function<bool()> &condition, int timeout)
+{
+    QDeadlineTimer deadline{timeout};
+    QEventLoop loop;
+    QTimer poll;
+    poll.setInterval(1);
+    QObject::connect(&poll, &QTimer::timeout, &loop, [&]() {
+        if (condition() || deadline.hasExpired())
+            loop.quit();
+    });
+    poll.start();
+    if (!condition())
+        loop.exec();
+    return condition();
+}
+
+void settle(int milliseconds)
+{
+    QEventLoop loop;
+    QTimer::singleShot(milliseconds, &loop, &QEventLoop::quit);
+    loop.exec();
+}
+
+bool writeFile(const QString &path, const QByteArray &contents)
+{
+    QDir{}.mkpath(QFileInfo{path}.path());
+    QFile file{path};
+    return file.open(QIODevice::WriteOnly) && file.write(contents) == contents.size();
+}
+
+// Lets the simulated devices answer the handshake like a configured gadget.
+// The loopback interface stands in for the USB network, so the devices
+// report its address without any of them configuring a network.
+bool fakeGadgetConfiguration(const QString &path)
+{
+    const QString functionPath = path + "/functions/" + Configuration::usbEthernetFunctionName();
+    if (!writeFile(path + "/strings/0x409/serialnumber", "simulated")
+            || !writeFile(functionPath + "/host_addr", "02:00:00:00:00:01")
+            || !writeFile(functionPath + "/ifname", "lo")) {
+        return false;
+    }
+    Configuration::setGadgetConfigFsDir(path);
+    Configuration::setConfiguresNetwork(false);
+    return true;
+}
+
+UsbAddress simulatedAddress(int index)
+{
+    return UsbAddress{static_cast<uint8_t>(index / devicesPerBus + 1),
+                      static_cast<uint8_t>(index % devicesPerBus + 1)};
+}
+
+int simulatedIndex(const UsbAddress &address)
+{
+    return (address.busNumber - 1) * devicesPerBus + address.deviceAddress - 1;
+}
+
+// Device servers at the far ends of the loopback links
+class DeviceFarm
+{
+public:
+    explicit DeviceFarm(int threadCount)
+        : m_threads{QString{"Device"}, threadCount},
+          m_servers{}
+    {
+
+    }
+
+    ~DeviceFarm()
+    {
+        // Servers are deleted in their threads, which run the deferred
+        // deletes when the worker pool joins them.
+        for (Server *server : m_servers)
+            server->deleteLater();
+    }
+
+    int threadCount() const
+    {
+        return m_threads.threadCount();
+    }
+
+    //! Starts the server of a new device and returns the transport to reach it
+    QdbTransport *plugIn()
+    {
+        const auto link = LoopbackDevice::createLink();
+        auto *server = new Server{new QdbTransport{link.second}};
+        m_servers.push_back(server);
+
+        server->moveToThread(m_threads.acquire());
+        QMetaObject::invokeMethod(server, [server]() {
+            if (!server->initialize())
+                qCritical() << "Could not initialize simulated device";
+        }, Qt::QueuedConnection);
+
+        return new QdbTransport{link.first};
+    }
+
+private:
+    WorkerThreadPool m_threads;
+    std::vector<Server *> m_servers;
+};
+
+// Reports the simulated devices as attached in the first enumeration, like
+// devices that are plugged in when the host server starts
+class SimulatedEnumerator : public DeviceEnumerator
+{
+public:
+    explicit SimulatedEnumerator(int deviceCount)
+        : m_deviceCount{deviceCount}
+    {
+
+    }
+
+    void startMonitoring() override
+    {
+        for (int i = 0; i < m_deviceCount; ++i) {
+            UsbDevice device;
+            device.serial = QString{"simulated%1"}.arg(i, 4, 10, QChar{'0'});
+            device.address = simulatedAddress(i);
+            emit devicePluggedIn(device);
+        }
+    }
+
+    void stopMonitoring() override
+    {
+    }
+
+private:
+    int m_deviceCount;
+};
+
+struct Round
+{
+    int deviceCount;
+    int readyCount;
+    double startupTime; // in ms, until the device manager was ready
+    std::vector<double> readyTimes; // in ms
+    qint64 bringUpCpuTime; // in microseconds
+    double steadyCpuLoad; // in percent of one core
+    qint64 residentSize; // in KiB
+    qint64 residentGrowth; // in KiB
+    int threadCount;
+    int deviceThreadCount;
+};
+
+Round runRound(int deviceCount, int deviceThreads, int heartbeatInterval, int maxParallel,
+               int settleTime)
+{
+    Round round{deviceCount, 0, 0.0, {}, 0, 0.0, 0, 0, 0, 0};
+    const ProcessUsage baseline = processUsage();
+
+    QElapsedTimer clock;
+    std::vector<qint64> readyAt(deviceCount, -1);
+    qint64 startupAt = -1;
+
+    // Declared after everything the connections below refer to, so that the
+    // manager and its signals are gone before those
+    DeviceFarm farm{deviceThreads};
+    DeviceManager manager;
+    manager.setHeartbeatInterval(heartbeatInterval);
+    manager.setMaxParallelBringUps(maxParallel);
+    manager.setDeviceEnumerator(make_unique<SimulatedEnumerator>(deviceCount));
+    manager.setTransportFactory([&farm](const UsbDevice &) {
+        return farm.plugIn();
+    });
+
+    QObject::connect(&manager, &DeviceManager::ready, &manager, [&]() {
+        startupAt = clock.nsecsElapsed();
+    });
+    // Ready once the device is published with its IP address, like clients see it
+    QObject::connect(&manager, &DeviceManager::newDeviceInfo, &manager, [&](DeviceInformation info) {
+        const int index = simulatedIndex(info.usbAddress);
+        if (index >= 0 && index < deviceCount && readyAt[index] < 0 && !info.ipAddress.isEmpty()) {
+            readyAt[index] = clock.nsecsElapsed();
+            ++round.readyCount;
+        }
+    });
+
+    clock.start();
+    const ProcessUsage bringUpStart = processUsage();
+    manager.start();
+
+    if (!waitFor([&]() { return round.readyCount == deviceCount; }, readyTimeout))
+        qWarning() << "Only" << round.readyCount << "of" << deviceCount << "devices became ready";
+    const ProcessUsage bringUpEnd = processUsage();
+    round.bringUpCpuTime = bringUpEnd.cpuTime - bringUpStart.cpuTime;
+
+    if (startupAt >= 0)
+        round.startupTime = startupAt / 1000000.0;
+    for (qint64 time : readyAt) {
+        if (time >= 0)
+            round.readyTimes.push_back(time / 1000000.0);
+    }
+    std::sort(round.readyTimes.begin(), round.readyTimes.end());
+
+    // Steady state with the devices attached, watched and sending heartbeats
+    const ProcessUsage steadyStart = processUsage();
+    settle(settleTime * 1000);
+    const ProcessUsage steadyEnd = processUsage();
+    round.steadyCpuLoad = 100.0 * (steadyEnd.cpuTime - steadyStart.cpuTime) / (settleTime * 1000000.0);
+    round.residentSize = steadyEnd.residentSize;
+    round.residentGrowth = steadyEnd.residentSize - baseline.residentSize;
+    round.threadCount = steadyEnd.threadCount;
+    round.deviceThreadCount = farm.threadCount();
+
+    return round;
+}
+
+void printHeader()
+{
+    std::cout << "devices  ready  startup  ready p50  ready p99  ready max  bring-up cpu"
+                 "  steady cpu    rss  rss/device  threads  device threads\n"
+              << "                     ms         ms         ms         ms            ms"
+                 "           %    MiB         KiB\n";
+}
+
+void printRound(const Round &round)
+{
+    const double readyMax = round.readyTimes.empty() ? 0.0 : round.readyTimes.back();
+    std::cout << qPrintable(QString::asprintf(
+                     "%7d  %5d  %7.1f  %9.1f  %9.1f  %9.1f  %12.1f  %10.1f  %5.1f  %10.1f  %7d  %14d",
+                     round.deviceCount, round.readyCount,
+                     round.startupTime,
+                     percentile(round.readyTimes, 0.5),
+                     percentile(round.readyTimes, 0.99),
+                     readyMax,
+                     round.bringUpCpuTime / 1000.0,
+                     round.steadyCpuLoad,
+                     round.residentSize / 1024.0,
+                     static_cast<double>(round.residentGrowth) / round.deviceCount,
+                     round.threadCount,
+                     round.deviceThreadCount))
+              << std::endl;
+}
+
+bool parseCount(const QString &value, int minimum, int *count)
+{
+    bool ok = false;
+    *count = value.toInt(&ok);
+    return ok && *count >= minimum;
+}
+
+} // anonymous namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app{argc, argv};
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Brings up simulated QDB devices in rounds of growing size "
+                                     "and measures the host side.");
+    parser.addHelpOption();
+    parser.addOption({"settle-time", "Measure the steady state for <seconds> after bring-up.", "seconds"});
+    parser.addOption({"heartbeat-interval", "Send heartbeats to the devices every <ms>, 0 disables them.", "ms"});
+    parser.addOption({"device-threads", "Run the simulated devices in <count> threads.", "count"});
+    parser.addOption({"max-parallel-bringups", "Configure at most <count> devices at the same time.", "count"});
+    parser.addOption({"debug", "Show the debug output of host and devices"});
+    parser.addPositionalArgument("devices", "Numbers of simulated devices, 1 10 100 by default.",
+                                 "[devices...]");
+    parser.process(app);
+
+    int settleTime = defaultSettleTime;
+    if (parser.isSet("settle-time") && !parseCount(parser.value("settle-time"), 1, &settleTime)) {
+        qCritical() << "Invalid settle time" << parser.value("settle-time");
+        return 1;
+    }
+    int heartbeatInterval = 1000;
+    if (parser.isSet("heartbeat-interval")
+            && !parseCount(parser.value("heartbeat-interval"), 0, &heartbeatInterval)) {
+        qCritical() << "Invalid heartbeat interval" << parser.value("heartbeat-interval");
+        return 1;
+    }
+    int deviceThreads = defaultDeviceThreads;
+    if (parser.isSet("device-threads")
+            && !parseCount(parser.value("device-threads"), 1, &deviceThreads)) {
+        qCritical() << "Invalid device thread count" << parser.value("device-threads");
+        return 1;
+    }
+    int maxParallel = BringUpScheduler::defaultMaxParallel;
+    if (parser.isSet("max-parallel-bringups")
+            && !parseCount(parser.value("max-parallel-bringups"), 1, &maxParallel)) {
+        qCritical() << "Invalid number of parallel bring-ups" << parser.value("max-parallel-bringups");
+        return 1;
+    }
+    std::vector<int> deviceCounts;
+    for (const QString &argument : parser.positionalArguments()) {
+        int count = 0;
+        if (!parseCount(argument, 1, &count)) {
+            qCritical() << "Invalid number of devices" << argument;
+            return 1;
+        }
+        deviceCounts.push_back(count);
+    }
+    if (deviceCounts.empty())
+        deviceCounts = {1, 10, 100};
+
+    if (!parser.isSet("debug"))
+        QLoggingCategory::setFilterRules("qdb.*.debug=false\nqdb.*.info=false\n");
+
+    // Keeps the subnet cache of the host out of the user's data
+    QStandardPaths::setTestModeEnabled(true);
+
+    // Executors run in the thread of their server, so that the thread count
+    // of the process grows only with the threads of the host side.
+    Configuration::setExecutorThreadCount(0);
+    // All simulated devices answer the handshake with the same identity
+    QTemporaryDir gadgetDir;
+    if (!gadgetDir.isValid() || !fakeGadgetConfiguration(gadgetDir.path())) {
+        qCritical() << "Could not create the gadget configuration of the simulated devices";
+        return 1;
+    }
+    DeviceIdentity identity;
+    identity.initialize();
+
+    printHeader();
+    for (int deviceCount : deviceCounts) {
+        printRound(runRound(deviceCount, deviceThreads, heartbeatInterval, maxParallel,
+                            settleTime));
+    }
+
+    return 0;
+}
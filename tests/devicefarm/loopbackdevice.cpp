@@ -0,0 +1,128 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Debug Bridge.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+#include "loopbackdevice.h"
+
+#include <QtCore/qmutex.h>
+#include <QtCore/qqueue.h>
+
+#include <algorithm>
+#include <cstring>
+
+struct LoopbackDevice::Link
+{
+    QMutex lock;
+    LoopbackDevice *ends[2];
+    bool opened[2];
+    // Packets waiting to be read at each end
+    QQueue<QByteArray> packets[2];
+};
+
+std::pair<LoopbackDevice *, LoopbackDevice *> LoopbackDevice::createLink()
+{
+    auto link = std::make_shared<Link>();
+    auto *hostEnd = new LoopbackDevice{link, 0};
+    auto *deviceEnd = new LoopbackDevice{link, 1};
+    return std::make_pair(hostEnd, deviceEnd);
+}
+
+LoopbackDevice::LoopbackDevice(std::shared_ptr<Link> link, int end)
+    : QIODevice{},
+      m_link{link},
+      m_end{end}
+{
+    m_link->ends[m_end] = this;
+    m_link->opened[m_end] = false;
+}
+
+LoopbackDevice::~LoopbackDevice()
+{
+    QMutexLocker locker{&m_link->lock};
+    m_link->ends[m_end] = nullptr;
+    m_link->opened[m_end] = false;
+    m_link->packets[m_end].clear();
+}
+
+bool LoopbackDevice::open(OpenMode mode)
+{
+    if (!QIODevice::open(mode))
+        return false;
+
+    int pending = 0;
+    {
+        QMutexLocker locker{&m_link->lock};
+        m_link->opened[m_end] = true;
+        pending = m_link->packets[m_end].size();
+    }
+    // Packets written before this end was opened are announced now
+    for (int i = 0; i < pending; ++i)
+        emit readyRead();
+    return true;
+}
+
+bool LoopbackDevice::isSequential() const
+{
+    return true;
+}
+
+qint64 LoopbackDevice::bytesAvailable() const
+{
+    QMutexLocker locker{&m_link->lock};
+    const auto &packets = m_link->packets[m_end];
+    return (packets.isEmpty() ? 0 : packets.head().size()) + QIODevice::bytesAvailable();
+}
+
+qint64 LoopbackDevice::readData(char *data, qint64 maxSize)
+{
+    QMutexLocker locker{&m_link->lock};
+    auto &packets = m_link->packets[m_end];
+    if (packets.isEmpty())
+        return 0;
+
+    // Like with USB transfers, the part of a packet that does not fit is lost
+    const QByteArray packet = packets.dequeue();
+    const qint64 size = std::min<qint64>(packet.size(), maxSize);
+    std::memcpy(data, packet.constData(), size);
+    return size;
+}
+
+qint64 LoopbackDevice::writeData(const char *data, qint64 maxSize)
+{
+    const int peer = 1 - m_end;
+    QMutexLocker locker{&m_link->lock};
+    LoopbackDevice *peerDevice = m_link->ends[peer];
+    if (!peerDevice)
+        return -1;
+
+    m_link->packets[peer].enqueue(QByteArray{data, static_cast<qsizetype>(maxSize)});
+    // The peer reads through a queued connection in its own thread, so the
+    // signal can be emitted from here. Holding the lock keeps the peer alive.
+    if (m_link->opened[peer])
+        emit peerDevice->readyRead();
+    return maxSize;
+}
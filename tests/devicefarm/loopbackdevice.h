@@ -0,0 +1,65 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Debug Bridge.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+#ifndef LOOPBACKDEVICE_H
+#define LOOPBACKDEVICE_H
+
+#include <QtCore/qiodevice.h>
+
+#include <memory>
+#include <utility>
+
+// One end of an in-process link that stands in for the USB bulk endpoints:
+// every write() at one end arrives as a single packet for read() at the
+// other end. The ends may live in different threads, and writes fail once
+// the other end has been destroyed, like with an unplugged device.
+class LoopbackDevice : public QIODevice
+{
+public:
+    //! Returns the host and the device end of a new link
+    static std::pair<LoopbackDevice *, LoopbackDevice *> createLink();
+    ~LoopbackDevice();
+
+    bool open(OpenMode mode) override;
+    bool isSequential() const override;
+    qint64 bytesAvailable() const override;
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *data, qint64 maxSize) override;
+
+private:
+    struct Link;
+
+    LoopbackDevice(std::shared_ptr<Link> link, int end);
+
+    std::shared_ptr<Link> m_link;
+    int m_end;
+};
+
+#endif // LOOPBACKDEVICE_H
@@ -0,0 +1,150 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Debug Bridge.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+#include "../qdb/server/deviceregistry.h"
+
+#include <QtTest>
+
+namespace {
+
+UsbDevice usbDevice(const QString &serial, uint8_t bus, uint8_t address)
+{
+    UsbDevice device;
+    device.serial = serial;
+    device.address = UsbAddress{bus, address};
+    return device;
+}
+
+} // anonymous namespace
+
+class tst_DeviceRegistry : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void findBySerialAndAddress();
+    void replugAtNewAddress();
+    void unplugKeepsRecord();
+    void snapshotOrder();
+    void removePublishes();
+};
+
+void tst_DeviceRegistry::findBySerialAndAddress()
+{
+    DeviceRegistry registry;
+    registry.plugIn(usbDevice("first", 1, 2));
+    registry.plugIn(usbDevice("second", 2, 1));
+
+    QVERIFY(registry.find("first"));
+    QCOMPARE(registry.findByAddress(UsbAddress{1, 2})->serial, QString{"first"});
+    QCOMPARE(registry.findByAddress(UsbAddress{2, 1})->serial, QString{"second"});
+    QVERIFY(!registry.findByAddress(UsbAddress{1, 1}));
+    QVERIFY(!registry.find("third"));
+}
+
+void tst_DeviceRegistry::replugAtNewAddress()
+{
+    DeviceRegistry registry;
+    DeviceRecord &record = registry.plugIn(usbDevice("first", 1, 2));
+    record.state = DeviceState::Ready;
+
+    DeviceRecord &replugged = registry.plugIn(usbDevice("first", 1, 3));
+    QCOMPARE(&replugged, &record);
+    QVERIFY(replugged.state == DeviceState::Ready);
+    QVERIFY(!registry.findByAddress(UsbAddress{1, 2}));
+    QCOMPARE(registry.findByAddress(UsbAddress{1, 3}), &record);
+}
+
+void tst_DeviceRegistry::unplugKeepsRecord()
+{
+    DeviceRegistry registry;
+    DeviceRecord *record = &registry.plugIn(usbDevice("first", 1, 2));
+    registry.unplug(record);
+
+    QVERIFY(!record->pluggedIn);
+    QVERIFY(record->unpluggedTime.isValid());
+    QVERIFY(!registry.findByAddress(UsbAddress{1, 2}));
+    QCOMPARE(registry.find("first"), record);
+
+    // Another device may get the address in the meantime
+    registry.plugIn(usbDevice("second", 1, 2));
+    QCOMPARE(registry.findByAddress(UsbAddress{1, 2})->serial, QString{"second"});
+}
+
+void tst_DeviceRegistry::snapshotOrder()
+{
+    DeviceRegistry registry;
+    const quint64 initialVersion = registry.snapshot()->version();
+
+    const QStringList serials{"c", "a", "b"};
+    uint8_t address = 1;
+    for (const QString &serial : serials) {
+        DeviceRecord &record = registry.plugIn(usbDevice(serial, 1, address++));
+        record.info.serial = serial;
+        registry.setPublished(&record, true);
+    }
+    const DeviceSnapshotPtr snapshot = registry.snapshot();
+    QCOMPARE(snapshot->version(), initialVersion + serials.size());
+    QCOMPARE(snapshot->devices().size(), size_t{3});
+    for (int i = 0; i < serials.size(); ++i)
+        QCOMPARE(snapshot->devices()[i].serial, serials[i]);
+
+    // Unpublishing does not change the snapshots that were already taken
+    registry.setPublished(registry.find("a"), false);
+    QCOMPARE(snapshot->devices().size(), size_t{3});
+    QCOMPARE(registry.snapshot()->devices().size(), size_t{2});
+    QCOMPARE(registry.snapshot()->devices()[1].serial, QString{"b"});
+
+    // Republished devices go last
+    registry.setPublished(registry.find("a"), true);
+    QCOMPARE(registry.snapshot()->devices()[2].serial, QString{"a"});
+}
+
+void tst_DeviceRegistry::removePublishes()
+{
+    DeviceRegistry registry;
+    DeviceRecord &record = registry.plugIn(usbDevice("first", 1, 2));
+    record.info.serial = "first";
+    registry.setPublished(&record, true);
+    const quint64 version = registry.snapshot()->version();
+
+    registry.remove("first");
+    QVERIFY(!registry.find("first"));
+    QVERIFY(!registry.findByAddress(UsbAddress{1, 2}));
+    QCOMPARE(registry.snapshot()->version(), version + 1);
+    QVERIFY(registry.snapshot()->devices().empty());
+
+    // Removing a device that is not published does not publish a snapshot
+    registry.plugIn(usbDevice("second", 1, 3));
+    registry.remove("second");
+    QCOMPARE(registry.snapshot()->version(), version + 1);
+}
+
+QTEST_APPLESS_MAIN(tst_DeviceRegistry)
+
+#include "tst_deviceregistry.moc"
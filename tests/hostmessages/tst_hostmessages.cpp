@@ -0,0 +1,182 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Debug Bridge.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+#include "../qdb/hostmessages.h"
+
+#include <QtCore/qbuffer.h>
+#include <QtCore/qcborarray.h>
+#include <QtCore/qjsonarray.h>
+#include <QtTest>
+
+Q_DECLARE_METATYPE(HostMessageFraming)
+
+class tst_HostMessages : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void roundTrip();
+    void roundTrip_data();
+    void partialMessage();
+    void partialMessage_data();
+    void negotiation();
+    void framingChanged();
+    void cborKeepsIntegers();
+    void requestId();
+};
+
+void tst_HostMessages::roundTrip()
+{
+    QFETCH(HostMessageFraming, framing);
+
+    QCborMap first = initializeResponse(ResponseType::NewDevice);
+    QCborMap device;
+    device[QStringLiteral("serial")] = QStringLiteral("1234");
+    device[QStringLiteral("ipAddress")] = QStringLiteral("172.31.0.2");
+    first[QStringLiteral("device")] = device;
+    QCborMap second = initializeResponse(ResponseType::Messages);
+    second[QStringLiteral("messages")] = QCborArray{QCborMap{{QStringLiteral("type"), 1},
+                                                             {QStringLiteral("text"), QStringLiteral("message")}}};
+
+    QByteArray data = serialiseMessage(first, framing);
+    data.append(serialiseMessage(second, framing));
+    QBuffer buffer{&data};
+    QVERIFY(buffer.open(QIODevice::ReadOnly));
+
+    QJsonObject message;
+    QVERIFY(readMessage(&buffer, framing, &message));
+    QCOMPARE(message, first.toJsonObject());
+    QVERIFY(readMessage(&buffer, framing, &message));
+    QCOMPARE(message, second.toJsonObject());
+    QVERIFY(!readMessage(&buffer, framing, &message));
+}
+
+void tst_HostMessages::roundTrip_data()
+{
+    QTest::addColumn<HostMessageFraming>("framing");
+
+    QTest::newRow("json") << HostMessageFraming::JsonLines;
+    QTest::newRow("cbor") << HostMessageFraming::Cbor;
+}
+
+void tst_HostMessages::partialMessage()
+{
+    QFETCH(HostMessageFraming, framing);
+
+    const QCborMap response = initializeResponse(ResponseType::DisconnectedDevice);
+    const QByteArray full = serialiseMessage(response, framing);
+
+    QByteArray partial = full.left(full.size() - 1);
+    QBuffer partialBuffer{&partial};
+    QVERIFY(partialBuffer.open(QIODevice::ReadOnly));
+    QJsonObject message;
+    QVERIFY(!readMessage(&partialBuffer, framing, &message));
+    // Nothing may be consumed from an incomplete message
+    QCOMPARE(partialBuffer.pos(), 0);
+
+    QByteArray complete = full;
+    QBuffer completeBuffer{&complete};
+    QVERIFY(completeBuffer.open(QIODevice::ReadOnly));
+    QVERIFY(readMessage(&completeBuffer, framing, &message));
+    QCOMPARE(message, response.toJsonObject());
+}
+
+void tst_HostMessages::partialMessage_data()
+{
+    roundTrip_data();
+}
+
+void tst_HostMessages::negotiation()
+{
+    QJsonObject arguments;
+    QCOMPARE(requestedFraming(arguments), HostMessageFraming::JsonLines);
+
+    setRequestedFraming(arguments, HostMessageFraming::Cbor);
+    const QByteArray request = createRequest(RequestType::WatchDevices, arguments);
+    QVERIFY(request.endsWith('\n'));
+    const QJsonObject parsed = QJsonDocument::fromJson(request).object();
+    QCOMPARE(requestType(parsed), RequestType::WatchDevices);
+    QVERIFY(checkHostMessageVersion(parsed));
+    QCOMPARE(requestedFraming(parsed), HostMessageFraming::Cbor);
+    // Servers that do not know the framing still accept the request
+    QCOMPARE(parsed["_version"].toInt(), 1);
+}
+
+void tst_HostMessages::framingChanged()
+{
+    // The confirmation is a JSON line followed by CBOR frames
+    QByteArray data = framingChangedResponse(HostMessageFraming::Cbor);
+    QVERIFY(data.endsWith('\n'));
+    data.append(serialiseMessage(initializeResponse(ResponseType::Devices), HostMessageFraming::Cbor));
+    QBuffer buffer{&data};
+    QVERIFY(buffer.open(QIODevice::ReadOnly));
+
+    HostMessageFraming framing = HostMessageFraming::JsonLines;
+    QJsonObject message;
+    QVERIFY(readMessage(&buffer, framing, &message));
+    QCOMPARE(responseType(message), ResponseType::FramingChanged);
+    framing = requestedFraming(message);
+    QCOMPARE(framing, HostMessageFraming::Cbor);
+    QVERIFY(readMessage(&buffer, framing, &message));
+    QCOMPARE(responseType(message), ResponseType::Devices);
+}
+
+void tst_HostMessages::cborKeepsIntegers()
+{
+    QCborMap response = initializeResponse(ResponseType::Statistics);
+    response[QStringLiteral("sent")] = Q_INT64_C(9007199254740993);
+    const QByteArray frame = serialiseMessage(response, HostMessageFraming::Cbor);
+
+    const QCborMap decoded = QCborValue::fromCbor(frame.mid(sizeof(quint32))).toMap();
+    QCOMPARE(responseType(decoded), ResponseType::Statistics);
+    QVERIFY(decoded[QStringLiteral("sent")].isInteger());
+    QCOMPARE(decoded[QStringLiteral("sent")].toInteger(), Q_INT64_C(9007199254740993));
+}
+
+void tst_HostMessages::requestId()
+{
+    QJsonObject arguments;
+    arguments["id"] = 42;
+    arguments["keep-alive"] = true;
+    const QJsonObject request = QJsonDocument::fromJson(createRequest(RequestType::Devices, arguments)).object();
+    QCOMPARE(::requestId(request), QJsonValue{42});
+    QVERIFY(requestsKeepAlive(request));
+
+    QCborMap response = initializeResponse(ResponseType::Devices);
+    setRequestId(response, ::requestId(request));
+    QCOMPARE(response[QStringLiteral("id")].toInteger(), Q_INT64_C(42));
+
+    // Responses to requests without an id carry no id either
+    setRequestId(response, ::requestId(QJsonObject{}));
+    QVERIFY(!response.contains(QStringLiteral("id")));
+    QVERIFY(!requestsKeepAlive(QJsonObject{}));
+}
+
+QTEST_APPLESS_MAIN(tst_HostMessages)
+
+#include "tst_hostmessages.moc"
@@ -0,0 +1,172 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Debug Bridge.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+#include "qdb/server/logwriter.h"
+
+#include <QtCore/qfile.h>
+#include <QtCore/qfileinfo.h>
+#include <QtCore/qtemporarydir.h>
+#include <QtCore/qthread.h>
+#include <QtTest>
+
+#include <memory>
+#include <vector>
+
+namespace {
+
+QList<QByteArray> readLines(const QString &fileName)
+{
+    QFile file{fileName};
+    if (!file.open(QIODevice::ReadOnly))
+        return QList<QByteArray>{};
+    QList<QByteArray> lines = file.readAll().split('\n');
+    if (!lines.isEmpty() && lines.last().isEmpty())
+        lines.removeLast();
+    return lines;
+}
+
+} // anonymous namespace
+
+class tst_LogWriter : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void writesLinesInOrder();
+    void writesLinesOfAllThreads();
+    void dropsLinesOverBudget();
+    void rotatesFullFile();
+};
+
+void tst_LogWriter::writesLinesInOrder()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString fileName = dir.filePath("qdb.log");
+
+    LogWriter writer{fileName};
+    QVERIFY(writer.start());
+    for (int i = 0; i < 1000; ++i)
+        writer.enqueue(QByteArray::number(i) + '\n');
+    writer.stop();
+
+    const QList<QByteArray> lines = readLines(fileName);
+    QCOMPARE(lines.size(), 1001);
+    QVERIFY(lines[0].startsWith("-- Starting QDB host server log"));
+    for (int i = 0; i < 1000; ++i)
+        QCOMPARE(lines[i + 1], QByteArray::number(i));
+}
+
+void tst_LogWriter::writesLinesOfAllThreads()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString fileName = dir.filePath("qdb.log");
+    const int threadCount = 4;
+    const int linesPerThread = 5000;
+
+    LogWriter writer{fileName};
+    QVERIFY(writer.start());
+    std::vector<std::unique_ptr<QThread>> threads;
+    for (int t = 0; t < threadCount; ++t) {
+        threads.emplace_back(QThread::create([&writer, t]() {
+            for (int i = 0; i < linesPerThread; ++i)
+                writer.enqueue(QByteArray::number(t) + ' ' + QByteArray::number(i) + '\n');
+        }));
+        threads.back()->start();
+    }
+    for (const auto &thread : threads)
+        QVERIFY(thread->wait(10000));
+    writer.stop();
+
+    // Batches may interleave the threads, but keep the order of each
+    const QList<QByteArray> lines = readLines(fileName);
+    QCOMPARE(lines.size(), 1 + threadCount * linesPerThread);
+    std::vector<int> next(threadCount, 0);
+    for (int i = 1; i < lines.size(); ++i) {
+        const QList<QByteArray> fields = lines[i].split(' ');
+        QCOMPARE(fields.size(), 2);
+        const int t = fields[0].toInt();
+        QVERIFY(t >= 0 && t < threadCount);
+        QCOMPARE(fields[1].toInt(), next[t]++);
+    }
+}
+
+void tst_LogWriter::dropsLinesOverBudget()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString fileName = dir.filePath("qdb.log");
+
+    // Nothing is written before starting, so the queue fills up to its
+    // budget of 8 MiB
+    LogWriter writer{fileName};
+    const QByteArray line = QByteArray(1024 * 1024 - 1, 'x') + '\n';
+    for (int i = 0; i < 10; ++i)
+        writer.enqueue(line);
+    QVERIFY(writer.start());
+    writer.stop();
+
+    const QList<QByteArray> lines = readLines(fileName);
+    QCOMPARE(lines.size(), 10);
+    QVERIFY(lines[0].startsWith("-- Starting"));
+    QCOMPARE(lines[1], QByteArray{"-- Dropped 2 log messages --"});
+    for (int i = 2; i < lines.size(); ++i)
+        QCOMPARE(lines[i].size(), line.size() - 1);
+}
+
+void tst_LogWriter::rotatesFullFile()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString fileName = dir.filePath("qdb.log");
+    const QByteArray line = QByteArray(99, 'x') + '\n';
+
+    // Queued before starting, so that the lines go out in full batches of
+    // 64 KiB, each of which fills the file
+    LogWriter writer{fileName};
+    writer.setMaxFileSize(1000);
+    for (int i = 0; i < 4000; ++i)
+        writer.enqueue(line);
+    QVERIFY(writer.start());
+    writer.stop();
+
+    // Three rotated files are kept, each filled up to the limit
+    for (int i = 1; i <= 3; ++i) {
+        const QString rotatedName = QString{"%1.%2"}.arg(fileName).arg(i);
+        QVERIFY2(QFile::exists(rotatedName), qPrintable(rotatedName));
+        QVERIFY(QFileInfo{rotatedName}.size() >= 1000);
+        QVERIFY(readLines(rotatedName).first().startsWith("-- Continuing"));
+    }
+    QVERIFY(!QFile::exists(fileName + ".4"));
+    QVERIFY(readLines(fileName).first().startsWith("-- Continuing"));
+}
+
+QTEST_GUILESS_MAIN(tst_LogWriter)
+
+#include "tst_logwriter.moc"
@@ -57,6 +57,8 @@ void testData()
     QTest::newRow("write") << QdbMessage::Write << 255u << 254u << QByteArray("\x01\x02\x03") << 3;
     QTest::newRow("close") << QdbMessage::Write << 0u << 1u << QByteArray("1234") << 4;
     QTest::newRow("ok") << QdbMessage::Ok << 3u << 5u << QByteArray("\x0A\x0B\x0C\x0D") << 4;
+    QTest::newRow("ping") << QdbMessage::Ping << 0u << 0u << QByteArray("\x01\x02\x03\x04\x05\x06\x07\x08") << 8;
+    QTest::newRow("pong") << QdbMessage::Pong << 0u << 0u << QByteArray("\x01\x02\x03\x04\x05\x06\x07\x08") << 8;
 }
 
 void tst_QdbMessage::construction_data()
@@ -0,0 +1,124 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Debug Bridge.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+#include "../qdb/server/rttestimator.h"
+
+#include <QtTest>
+
+class tst_RttEstimator : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void noSamples();
+    void summary();
+    void rollingWindow();
+    void timeout();
+    void reset();
+};
+
+void tst_RttEstimator::noSamples()
+{
+    RttEstimator estimator;
+    const RoundTripTimes times = estimator.roundTripTimes();
+    QCOMPARE(times.samples, quint64{0});
+    QCOMPARE(times.minimum, qint64{0});
+    QCOMPARE(times.p99, qint64{0});
+    QCOMPARE(estimator.timeout(), qint64{0});
+}
+
+void tst_RttEstimator::summary()
+{
+    RttEstimator estimator;
+    for (qint64 i = 100; i >= 1; --i)
+        estimator.addSample(i * 10);
+
+    const RoundTripTimes times = estimator.roundTripTimes();
+    QCOMPARE(times.samples, quint64{100});
+    QCOMPARE(times.minimum, qint64{10});
+    QCOMPARE(times.average, qint64{505});
+    QCOMPARE(times.p99, qint64{990});
+
+    // With few samples the 99th percentile is the maximum
+    RttEstimator few;
+    few.addSample(300);
+    few.addSample(100);
+    QCOMPARE(few.roundTripTimes().p99, qint64{300});
+}
+
+void tst_RttEstimator::rollingWindow()
+{
+    RttEstimator estimator;
+    // An early slow sample falls out of the window
+    estimator.addSample(1000000);
+    for (int i = 0; i < RttEstimator::windowSize; ++i)
+        estimator.addSample(200);
+
+    const RoundTripTimes times = estimator.roundTripTimes();
+    QCOMPARE(times.samples, quint64{RttEstimator::windowSize + 1});
+    QCOMPARE(times.minimum, qint64{200});
+    QCOMPARE(times.average, qint64{200});
+    QCOMPARE(times.p99, qint64{200});
+}
+
+void tst_RttEstimator::timeout()
+{
+    RttEstimator estimator;
+    estimator.addSample(1000);
+    // The first sample sets the variation to half of it
+    QCOMPARE(estimator.timeout(), qint64{3000});
+
+    for (int i = 0; i < 100; ++i)
+        estimator.addSample(1000);
+    // A steady link converges to the round trip time itself
+    QVERIFY(estimator.timeout() < 1100);
+    QVERIFY(estimator.timeout() >= 1000);
+}
+
+void tst_RttEstimator::reset()
+{
+    RttEstimator estimator;
+    for (int i = 0; i < 10; ++i)
+        estimator.addSample(5000);
+    estimator.reset();
+
+    QCOMPARE(estimator.roundTripTimes().samples, quint64{0});
+    QCOMPARE(estimator.timeout(), qint64{0});
+
+    // The next sample starts the estimate over
+    estimator.addSample(1000);
+    const RoundTripTimes times = estimator.roundTripTimes();
+    QCOMPARE(times.samples, quint64{1});
+    QCOMPARE(times.minimum, qint64{1000});
+    QCOMPARE(times.p99, qint64{1000});
+    QCOMPARE(estimator.timeout(), qint64{3000});
+}
+
+QTEST_APPLESS_MAIN(tst_RttEstimator)
+
+#include "tst_rttestimator.moc"
@@ -0,0 +1,239 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Debug Bridge.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+#include "libqdb/make_unique.h"
+#include "libqdb/protocol/protocol.h"
+#include "libqdb/protocol/qdbmessage.h"
+#include "libqdb/protocol/qdbtransport.h"
+#include "libqdb/protocol/services.h"
+#include "qdb/server/connection.h"
+#include "qdb/server/streamproxyservice.h"
+#include "tests/devicefarm/loopbackdevice.h"
+
+#include <QtCore/qpointer.h>
+#include <QtNetwork/qlocalserver.h>
+#include <QtNetwork/qlocalsocket.h>
+#include <QtTest/QtTest>
+
+#include <memory>
+
+namespace {
+
+const StreamId deviceStreamId = 7;
+// Payload of the stream packet in each Write, which fits into one message
+const int packetSize = 16000;
+
+// Wraps the data into a stream packet like the device does
+QByteArray streamPacket(const QByteArray &data)
+{
+    QByteArray buffer;
+    QDataStream stream{&buffer, QIODevice::WriteOnly};
+    stream << static_cast<uint32_t>(data.size());
+    return buffer + data;
+}
+
+} // anonymous namespace
+
+// Runs a StreamProxyService over a real Connection, with the test playing the
+// device at the other end of a LoopbackDevice
+class tst_StreamProxy : public QObject
+{
+    Q_OBJECT
+private slots:
+    void init();
+    void cleanup();
+
+    void opensStream();
+    void acknowledgesWritesWithoutClient();
+    void deliversDataToClient();
+    void holdsBackWritesForSlowClient();
+
+private:
+    bool openStream();
+    void sendFromDevice(const QByteArray &data);
+    bool writeFromDevice(const QByteArray &data);
+    bool takeMessage(QdbMessage::CommandType command);
+    bool waitForMessage(QdbMessage::CommandType command);
+    QLocalSocket *connectClient(QLocalSocket *client);
+
+    std::unique_ptr<QdbTransport> m_device;
+    std::shared_ptr<Connection> m_connection;
+    QPointer<StreamProxyService> m_service;
+    QList<QdbMessage> m_fromHost;
+    StreamId m_hostStreamId;
+    std::unique_ptr<QLocalServer> m_server;
+};
+
+void tst_StreamProxy::init()
+{
+    auto link = LoopbackDevice::createLink();
+    m_device = make_unique<QdbTransport>(link.second);
+    connect(m_device.get(), &QdbTransport::messageAvailable, this, [this]() {
+        m_fromHost.append(m_device->receive());
+    });
+    QVERIFY(m_device->open());
+
+    m_connection = std::make_shared<Connection>(new QdbTransport{link.first});
+    m_connection->start();
+    QVERIFY(waitForMessage(QdbMessage::Connect));
+
+    QByteArray payload;
+    QDataStream stream{&payload, QIODevice::WriteOnly};
+    stream << qdbProtocolVersion << static_cast<uint32_t>(1) << static_cast<uint32_t>(0)
+           << static_cast<uint32_t>(0);
+    QVERIFY(m_device->send(QdbMessage{QdbMessage::Connect, 0, 0, payload}));
+    QTRY_COMPARE(m_connection->state(), ConnectionState::Connected);
+
+    m_service = new StreamProxyService{m_connection, EchoTag, "client", TrafficClass{}, 1};
+    m_hostStreamId = 0;
+}
+
+void tst_StreamProxy::cleanup()
+{
+    delete m_service;
+    m_server.reset();
+    m_connection.reset();
+    m_device.reset();
+    m_fromHost.clear();
+}
+
+void tst_StreamProxy::opensStream()
+{
+    QSignalSpy spy{m_service, &StreamProxyService::failed};
+    QVERIFY(openStream());
+    QCOMPARE(spy.count(), 0);
+    QCOMPARE(m_connection->statistics().size(), static_cast<size_t>(1));
+}
+
+void tst_StreamProxy::acknowledgesWritesWithoutClient()
+{
+    QVERIFY(openStream());
+
+    // Each Write is acknowledged before the next one is sent, like the device does
+    for (int i = 0; i < 10; ++i)
+        QVERIFY(writeFromDevice(QByteArray{packetSize, 'x'}));
+    QVERIFY(!takeMessage(QdbMessage::Close));
+}
+
+void tst_StreamProxy::deliversDataToClient()
+{
+    QVERIFY(openStream());
+    QVERIFY(writeFromDevice("early"));
+
+    QLocalSocket client;
+    QLocalSocket *socket = connectClient(&client);
+    QVERIFY(socket);
+    m_service->attachSocket(socket);
+    QVERIFY(writeFromDevice("late"));
+
+    QByteArray received;
+    QTRY_VERIFY((received += client.readAll()) == "earlylate");
+}
+
+void tst_StreamProxy::holdsBackWritesForSlowClient()
+{
+    QVERIFY(openStream());
+
+    // Nobody reads the data yet, so the Write that fills the buffer up to
+    // 256 KiB is not acknowledged
+    const int packets = 256 * 1024 / packetSize + 1;
+    for (int i = 0; i < packets - 1; ++i)
+        QVERIFY(writeFromDevice(QByteArray{packetSize, 'x'}));
+    sendFromDevice(QByteArray{packetSize, 'x'});
+    QVERIFY(!QTest::qWaitFor([this]() { return takeMessage(QdbMessage::Ok); }, 200));
+
+    QLocalSocket client;
+    QLocalSocket *socket = connectClient(&client);
+    QVERIFY(socket);
+    m_service->attachSocket(socket);
+
+    qint64 received = 0;
+    QTRY_COMPARE((received += client.readAll().size()), static_cast<qint64>(packets) * packetSize);
+    QVERIFY(waitForMessage(QdbMessage::Ok));
+    QVERIFY(!takeMessage(QdbMessage::Close));
+}
+
+bool tst_StreamProxy::openStream()
+{
+    QSignalSpy spy{m_service, &StreamProxyService::opened};
+    m_service->initialize();
+    if (!QTest::qWaitFor([this]() { return !m_fromHost.isEmpty(); }))
+        return false;
+    const QdbMessage open = m_fromHost.takeFirst();
+    if (open.command() != QdbMessage::Open || open.data() != tagBuffer(EchoTag))
+        return false;
+
+    m_hostStreamId = open.hostStream();
+    return m_device->send(QdbMessage{QdbMessage::Ok, m_hostStreamId, deviceStreamId})
+            && QTest::qWaitFor([&spy]() { return spy.count() == 1; });
+}
+
+void tst_StreamProxy::sendFromDevice(const QByteArray &data)
+{
+    m_device->send(QdbMessage{QdbMessage::Write, m_hostStreamId, deviceStreamId,
+                              streamPacket(data)});
+}
+
+bool tst_StreamProxy::writeFromDevice(const QByteArray &data)
+{
+    sendFromDevice(data);
+    return waitForMessage(QdbMessage::Ok);
+}
+
+bool tst_StreamProxy::takeMessage(QdbMessage::CommandType command)
+{
+    for (int i = 0; i < m_fromHost.size(); ++i) {
+        if (m_fromHost[i].command() == command) {
+            m_fromHost.removeAt(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool tst_StreamProxy::waitForMessage(QdbMessage::CommandType command)
+{
+    return QTest::qWaitFor([this, command]() { return takeMessage(command); });
+}
+
+QLocalSocket *tst_StreamProxy::connectClient(QLocalSocket *client)
+{
+    m_server = make_unique<QLocalServer>();
+    const QString name = QStringLiteral("tst_streamproxy-%1").arg(QCoreApplication::applicationPid());
+    QLocalServer::removeServer(name);
+    if (!m_server->listen(name))
+        return nullptr;
+
+    client->connectToServer(name);
+    if (!m_server->waitForNewConnection(5000))
+        return nullptr;
+    return m_server->nextPendingConnection();
+}
+
+QTEST_GUILESS_MAIN(tst_StreamProxy)
+#include "tst_streamproxy.moc"
@@ -27,11 +27,15 @@
 **
 ****************************************************************************/
 #include "../qdb/server/subnet.h"
+#include "../qdb/server/subnetcache.h"
 
+#include <QtCore/qfile.h>
 #include <QtCore/qstring.h>
+#include <QtCore/qtemporarydir.h>
 #include <QtTest>
 
 using Subnets = std::vector<Subnet>;
+using Ranges = std::vector<SubnetRange>;
 
 class tst_Subnet : public QObject
 {
@@ -45,6 +49,17 @@ private slots:
     void reserveOne();
     void reserveOne_data();
     void reserveSome();
+    void parseRange();
+    void parseRange_data();
+    void reserveWholeRange();
+    void reserveUnusedSkipsUsed();
+    void reserveOutsideRanges();
+    void overlappingRanges();
+    void addressIntervals();
+    void publishedUsedSubnets();
+    void reservePreferred();
+    void cacheSurvivesReload();
+    void cacheIgnoresInvalidFile();
 };
 
 void tst_Subnet::freeSubnets()
@@ -160,6 +175,198 @@ void tst_Subnet::reserveSome()
     QCOMPARE(pool->candidates().size(), amountOfCandidates);
 }
 
+void tst_Subnet::parseRange()
+{
+    QFETCH(QString, text);
+    QFETCH(bool, valid);
+    QFETCH(SubnetRange, expected);
+
+    SubnetRange range{};
+    QCOMPARE(parseSubnetRange(text, &range), valid);
+    if (valid)
+        QCOMPARE(range, expected);
+}
+
+void tst_Subnet::parseRange_data()
+{
+    QTest::addColumn<QString>("text");
+    QTest::addColumn<bool>("valid");
+    QTest::addColumn<SubnetRange>("expected");
+
+    QTest::newRow("/16") << "172.16.0.0/16" << true << SubnetRange{QHostAddress{"172.16.0.0"}, 16};
+    QTest::newRow("/30") << "10.0.0.4/30" << true << SubnetRange{QHostAddress{"10.0.0.4"}, 30};
+    QTest::newRow("unmasked") << "10.1.2.3/24" << true << SubnetRange{QHostAddress{"10.1.2.0"}, 24};
+    QTest::newRow("no prefix") << "10.0.0.0" << false << SubnetRange{};
+    QTest::newRow("too small") << "10.0.0.0/31" << false << SubnetRange{};
+    QTest::newRow("too large") << "10.0.0.0/4" << false << SubnetRange{};
+    QTest::newRow("IPv6") << "fd00::/64" << false << SubnetRange{};
+    QTest::newRow("garbage") << "subnet/x" << false << SubnetRange{};
+}
+
+void tst_Subnet::reserveWholeRange()
+{
+    SubnetPool pool{Ranges{{QHostAddress{"10.0.0.0"}, 22}}};
+    QCOMPARE(pool.candidates().size(), size_t{256});
+
+    std::vector<SubnetReservation> reservations;
+    for (int i = 0; i < 256; ++i) {
+        reservations.push_back(pool.reserveUnused(Subnets{}));
+        QVERIFY(reservations.back());
+        const quint32 expected = QHostAddress{"10.0.0.1"}.toIPv4Address() + i * 4;
+        QCOMPARE(reservations.back()->subnet(), (Subnet{QHostAddress{expected}, 30}));
+    }
+    QVERIFY(!pool.reserveUnused(Subnets{}));
+    QVERIFY(pool.candidates().empty());
+
+    const Subnet freed = reservations[100]->subnet();
+    reservations[100].reset();
+    const auto reservation = pool.reserveUnused(Subnets{});
+    QVERIFY(reservation);
+    QCOMPARE(reservation->subnet(), freed);
+}
+
+void tst_Subnet::reserveUnusedSkipsUsed()
+{
+    SubnetPool pool{Ranges{{QHostAddress{"10.0.0.0"}, 24}}};
+    const Subnets used{{QHostAddress{"10.0.0.1"}, 26},
+                       {QHostAddress{"10.0.0.70"}, 32},
+                       {QHostAddress{"fd00::1"}, 64}};
+
+    const auto first = pool.reserveUnused(used);
+    QVERIFY(first);
+    QCOMPARE(first->subnet(), (Subnet{QHostAddress{"10.0.0.65"}, 30}));
+    const auto second = pool.reserveUnused(used);
+    QVERIFY(second);
+    QCOMPARE(second->subnet(), (Subnet{QHostAddress{"10.0.0.73"}, 30}));
+
+    QVERIFY(!pool.reserveUnused(Subnets{{QHostAddress{"10.0.0.0"}, 8}}));
+}
+
+void tst_Subnet::reserveOutsideRanges()
+{
+    SubnetPool pool{Ranges{{QHostAddress{"10.0.0.0"}, 24}}};
+    const Subnet subnet{QHostAddress{"192.168.1.1"}, 24};
+    {
+        const auto reservation = pool.reserve(subnet);
+        QVERIFY(reservation);
+        QVERIFY(!pool.reserve(subnet));
+        QVERIFY(!pool.setRanges(Ranges{{QHostAddress{"10.1.0.0"}, 24}}));
+    }
+    QVERIFY(pool.reserve(subnet));
+    QCOMPARE(pool.candidates().size(), size_t{64});
+}
+
+void tst_Subnet::overlappingRanges()
+{
+    SubnetPool pool{Ranges{}};
+    QVERIFY(!pool.setRanges(Ranges{{QHostAddress{"10.0.0.0"}, 16}, {QHostAddress{"10.0.4.0"}, 24}}));
+    QVERIFY(pool.setRanges(Ranges{{QHostAddress{"10.0.0.0"}, 24}, {QHostAddress{"10.0.1.0"}, 24}}));
+    QCOMPARE(pool.candidates().size(), size_t{128});
+}
+
+void tst_Subnet::addressIntervals()
+{
+    const AddressIntervals intervals{Subnets{{QHostAddress{"10.0.0.1"}, 24},
+                                             {QHostAddress{"10.0.1.1"}, 24},
+                                             {QHostAddress{"10.0.0.128"}, 25},
+                                             {QHostAddress{"192.168.1.10"}, -1},
+                                             {QHostAddress{"fd00::1"}, 64}}};
+    const auto address = [](const char *text) {
+        return QHostAddress{QString::fromLatin1(text)}.toIPv4Address();
+    };
+
+    quint32 end = 0;
+    QVERIFY(intervals.overlaps(address("10.0.0.4"), address("10.0.0.7"), &end));
+    // Adjacent subnets are merged into one interval
+    QCOMPARE(end, address("10.0.1.255"));
+    QVERIFY(intervals.overlaps(address("9.255.255.252"), address("10.0.0.0"), &end));
+    QVERIFY(!intervals.overlaps(address("10.0.2.0"), address("10.0.2.3"), &end));
+    QVERIFY(intervals.overlaps(address("192.168.1.8"), address("192.168.1.11"), &end));
+    QCOMPARE(end, address("192.168.1.10"));
+    QVERIFY(!intervals.overlaps(address("192.168.1.12"), address("192.168.1.15"), &end));
+    QVERIFY(!intervals.overlaps(address("1.0.0.0"), address("1.0.0.3"), &end));
+}
+
+void tst_Subnet::publishedUsedSubnets()
+{
+    SubnetPool pool{Ranges{{QHostAddress{"10.0.0.0"}, 24}}};
+    QVERIFY(!pool.usedSubnets());
+
+    pool.setUsedSubnets(Subnets{{QHostAddress{"10.0.0.1"}, 30}});
+    const auto used = pool.usedSubnets();
+    QVERIFY(used);
+    const auto reservation = pool.reserveUnused(*used);
+    QVERIFY(reservation);
+    QCOMPARE(reservation->subnet(), (Subnet{QHostAddress{"10.0.0.5"}, 30}));
+
+    pool.clearUsedSubnets();
+    QVERIFY(!pool.usedSubnets());
+}
+
+void tst_Subnet::reservePreferred()
+{
+    SubnetPool pool{Ranges{{QHostAddress{"10.0.0.0"}, 24}}};
+    const Subnet preferred{QHostAddress{"10.0.0.9"}, 30};
+
+    const auto reservation = pool.reserveIfUnused(preferred, AddressIntervals{Subnets{}});
+    QVERIFY(reservation);
+    QCOMPARE(reservation->subnet(), preferred);
+    // Already reserved
+    QVERIFY(!pool.reserveIfUnused(preferred, AddressIntervals{Subnets{}}));
+    // Used by the host
+    QVERIFY(!pool.reserveIfUnused(Subnet{QHostAddress{"10.0.0.13"}, 30},
+                                  AddressIntervals{Subnets{{QHostAddress{"10.0.0.14"}, 32}}}));
+    // Outside of the ranges
+    QVERIFY(!pool.reserveIfUnused(Subnet{QHostAddress{"10.0.1.1"}, 30}, AddressIntervals{Subnets{}}));
+}
+
+void tst_Subnet::cacheSurvivesReload()
+{
+    QTemporaryDir directory;
+    QVERIFY(directory.isValid());
+    const QString path = directory.filePath("cache/subnets.json");
+    const Subnet first{QHostAddress{"172.16.58.1"}, 30};
+    const Subnet second{QHostAddress{"172.16.58.5"}, 30};
+
+    {
+        SubnetCache cache;
+        QVERIFY(cache.load(path));
+        QCOMPARE(cache.lookup("first").second, false);
+        cache.remember("first", first);
+        cache.remember("second", second);
+        cache.remember("gone", second);
+        cache.forget("gone");
+    }
+
+    SubnetCache cache;
+    QVERIFY(cache.load(path));
+    QVERIFY(cache.lookup("first") == std::make_pair(first, true));
+    QVERIFY(cache.lookup("second") == std::make_pair(second, true));
+    QCOMPARE(cache.lookup("gone").second, false);
+}
+
+void tst_Subnet::cacheIgnoresInvalidFile()
+{
+    QTemporaryDir directory;
+    QVERIFY(directory.isValid());
+    const QString path = directory.filePath("subnets.json");
+    {
+        QFile file{path};
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write("{\"version\": 1, \"devices\": {\"serial\": {\"subnet\": \"nonsense\"}}");
+    }
+
+    SubnetCache cache;
+    QVERIFY(!cache.load(path));
+    QCOMPARE(cache.lookup("serial").second, false);
+
+    // The broken file is replaced on the next change
+    cache.remember("serial", Subnet{QHostAddress{"10.0.0.1"}, 30});
+    SubnetCache reloaded;
+    QVERIFY(reloaded.load(path));
+    QCOMPARE(reloaded.lookup("serial").second, true);
+}
+
 QTEST_APPLESS_MAIN(tst_Subnet)
 
 #include "tst_subnet.moc"
@@ -0,0 +1,76 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Debug Bridge.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+#include "libqdb/tracering.h"
+
+#include <QtCore/qtemporarydir.h>
+#include <QtTest>
+
+class tst_TraceRing : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void recordAndRead();
+};
+
+void tst_TraceRing::recordAndRead()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString fileName = dir.filePath("test.trace");
+
+    // Nothing is recorded nor does anything break without a ring
+    TraceRing::record(TraceEvent::MessageSent, this, 1, 2, 3, 4);
+
+    QVERIFY(TraceRing::open(fileName));
+    QVERIFY(TraceRing::isOpen());
+    TraceRing::record(TraceEvent::MessageSent, this, 1, 2, 3, 4);
+    TraceRing::record(TraceEvent::StateChanged, this, 2, 3);
+
+    std::vector<TraceRecord> records;
+    QString errorString;
+    QVERIFY2(TraceRing::read(fileName, &records, &errorString), qPrintable(errorString));
+    QCOMPARE(records.size(), size_t{3});
+
+    QCOMPARE(records[0].event, static_cast<quint32>(TraceEvent::Started));
+    QCOMPARE(records[0].arguments[0], static_cast<quint32>(QCoreApplication::applicationPid()));
+
+    QCOMPARE(records[1].event, static_cast<quint32>(TraceEvent::MessageSent));
+    QCOMPARE(records[1].source, static_cast<quint64>(reinterpret_cast<quintptr>(this)));
+    QCOMPARE(records[1].arguments[0], 1u);
+    QCOMPARE(records[1].arguments[3], 4u);
+
+    QCOMPARE(records[2].event, static_cast<quint32>(TraceEvent::StateChanged));
+    QVERIFY(records[1].sequence < records[2].sequence);
+    QVERIFY(records[1].timestamp <= records[2].timestamp);
+}
+
+QTEST_GUILESS_MAIN(tst_TraceRing)
+
+#include "tst_tracering.moc"
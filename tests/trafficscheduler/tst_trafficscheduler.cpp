@@ -0,0 +1,279 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Debug Bridge.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+#include "libqdb/protocol/protocol.h"
+#include "qdb/server/trafficscheduler.h"
+
+#include <QtTest>
+
+namespace {
+
+QdbMessage writeMessage(StreamId id, int size)
+{
+    return QdbMessage{QdbMessage::Write, id, id, QByteArray(size, 'x')};
+}
+
+// Bytes sent per stream while taking count messages from the scheduler
+QHash<StreamId, qint64> drain(TrafficScheduler &scheduler, int count)
+{
+    QHash<StreamId, qint64> sent;
+    QdbMessage message;
+    int retryAfter = 0;
+    for (int i = 0; i < count && scheduler.dequeue(&message, &retryAfter); ++i)
+        sent[message.hostStream()] += message.data().size();
+    return sent;
+}
+
+} // anonymous namespace
+
+class tst_TrafficScheduler : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void streamKeepsOrder();
+    void emptyScheduler();
+    void clientsShareEqually();
+    void clientWeights();
+    void streamsOfClientTakeTurns();
+    void streamWeights();
+    void rateIsPerClient();
+    void newRateLimitedClientHasBurst();
+    void lowerRateClampsTokens();
+    void removeStream();
+    void moveStreamToOtherClient();
+};
+
+void tst_TrafficScheduler::streamKeepsOrder()
+{
+    TrafficScheduler scheduler;
+    for (int i = 1; i <= 5; ++i)
+        scheduler.enqueue(writeMessage(1, i));
+
+    QdbMessage message;
+    int retryAfter = 0;
+    for (int i = 1; i <= 5; ++i) {
+        QVERIFY(scheduler.dequeue(&message, &retryAfter));
+        QCOMPARE(message.data().size(), i);
+    }
+    QVERIFY(scheduler.isEmpty());
+}
+
+void tst_TrafficScheduler::emptyScheduler()
+{
+    TrafficScheduler scheduler;
+    QVERIFY(scheduler.isEmpty());
+
+    QdbMessage message;
+    int retryAfter = 0;
+    QVERIFY(!scheduler.dequeue(&message, &retryAfter));
+    QCOMPARE(retryAfter, -1);
+}
+
+void tst_TrafficScheduler::clientsShareEqually()
+{
+    // A client does not get more bandwidth by opening more streams
+    TrafficScheduler scheduler;
+    for (StreamId id = 1; id <= 4; ++id)
+        scheduler.setTrafficClass(id, "many", TrafficClass{});
+    scheduler.setTrafficClass(5, "single", TrafficClass{});
+
+    for (int i = 0; i < 50; ++i) {
+        for (StreamId id = 1; id <= 5; ++id)
+            scheduler.enqueue(writeMessage(id, qdbMaxPayloadSize));
+    }
+
+    const auto sent = drain(scheduler, 100);
+    const qint64 many = sent[1] + sent[2] + sent[3] + sent[4];
+    QVERIFY(qAbs(many - sent[5]) <= qdbMaxPayloadSize);
+}
+
+void tst_TrafficScheduler::clientWeights()
+{
+    TrafficScheduler scheduler;
+    TrafficClass heavy;
+    heavy.weight = 3;
+    scheduler.setTrafficClass(1, "heavy", heavy);
+    scheduler.setTrafficClass(2, "heavy", heavy);
+    scheduler.setTrafficClass(3, "light", TrafficClass{});
+
+    for (int i = 0; i < 100; ++i) {
+        for (StreamId id = 1; id <= 3; ++id)
+            scheduler.enqueue(writeMessage(id, qdbMaxPayloadSize));
+    }
+
+    const auto sent = drain(scheduler, 80);
+    const qint64 heavyBytes = sent[1] + sent[2];
+    QVERIFY(qAbs(heavyBytes - 3 * sent[3]) <= 3 * qdbMaxPayloadSize);
+}
+
+void tst_TrafficScheduler::streamsOfClientTakeTurns()
+{
+    TrafficScheduler scheduler;
+    scheduler.setTrafficClass(1, "client", TrafficClass{});
+    scheduler.setTrafficClass(2, "client", TrafficClass{});
+    for (int i = 0; i < 3; ++i) {
+        scheduler.enqueue(writeMessage(1, qdbMaxPayloadSize));
+        scheduler.enqueue(writeMessage(2, qdbMaxPayloadSize));
+    }
+
+    QList<StreamId> order;
+    QdbMessage message;
+    int retryAfter = 0;
+    while (scheduler.dequeue(&message, &retryAfter))
+        order.append(message.hostStream());
+    QCOMPARE(order, (QList<StreamId>{1, 2, 1, 2, 1, 2}));
+}
+
+void tst_TrafficScheduler::streamWeights()
+{
+    // Streams share the bandwidth of their client by their own weights
+    TrafficScheduler scheduler;
+    scheduler.setTrafficClass(1, "client", TrafficClass{});
+    scheduler.setTrafficClass(2, "client", TrafficClass{});
+    scheduler.setStreamWeight(1, 3);
+    scheduler.setTrafficClass(3, "other", TrafficClass{});
+
+    for (int i = 0; i < 100; ++i) {
+        for (StreamId id = 1; id <= 3; ++id)
+            scheduler.enqueue(writeMessage(id, qdbMaxPayloadSize));
+    }
+
+    const auto sent = drain(scheduler, 80);
+    QVERIFY(qAbs(sent[1] - 3 * sent[2]) <= 3 * qdbMaxPayloadSize);
+    // The weights of the streams do not change the share of the client
+    QVERIFY(qAbs(sent[1] + sent[2] - sent[3]) <= qdbMaxPayloadSize);
+
+    const auto statistics = scheduler.statistics();
+    QCOMPARE(statistics[0].streamWeight, quint32{3});
+    QCOMPARE(statistics[1].streamWeight, quint32{1});
+}
+
+void tst_TrafficScheduler::rateIsPerClient()
+{
+    const qint64 rate = 1000; // bytes per second
+    const int size = 100;
+    QElapsedTimer timer;
+    timer.start();
+
+    TrafficScheduler scheduler;
+    TrafficClass limited;
+    limited.bytesPerSecond = rate;
+    for (StreamId id = 1; id <= 3; ++id) {
+        scheduler.setTrafficClass(id, "limited", limited);
+        for (int i = 0; i < 200; ++i)
+            scheduler.enqueue(writeMessage(id, size));
+    }
+
+    QTest::qWait(500);
+    const auto sent = drain(scheduler, 600);
+    const qint64 total = sent[1] + sent[2] + sent[3];
+    // The three streams share the bucket of their client, which starts with
+    // a burst of one full message
+    QVERIFY(total >= qdbMessageSize - size);
+    QVERIFY2(total <= qdbMessageSize + timer.elapsed() * rate / 1000 + size,
+             qPrintable(QString{"sent %1 bytes in %2 ms"}.arg(total).arg(timer.elapsed())));
+
+    QdbMessage message;
+    int retryAfter = 0;
+    QVERIFY(!scheduler.dequeue(&message, &retryAfter));
+    QVERIFY(retryAfter > 0);
+}
+
+void tst_TrafficScheduler::newRateLimitedClientHasBurst()
+{
+    TrafficScheduler scheduler;
+    TrafficClass limited;
+    limited.bytesPerSecond = 1;
+    scheduler.setTrafficClass(1, "client", limited);
+    for (int i = 0; i < 4; ++i)
+        scheduler.enqueue(writeMessage(1, qdbMessageSize / 2));
+
+    // A full message is sent right away, not after hours at this rate
+    const auto sent = drain(scheduler, 4);
+    QCOMPARE(sent[1], qint64{qdbMessageSize});
+}
+
+void tst_TrafficScheduler::lowerRateClampsTokens()
+{
+    TrafficScheduler scheduler;
+    TrafficClass fast;
+    fast.bytesPerSecond = 10 * qdbMessageSize;
+    scheduler.setTrafficClass(1, "client", fast);
+    for (int i = 0; i < 8; ++i)
+        scheduler.enqueue(writeMessage(1, qdbMessageSize / 2));
+
+    // Gathers tokens for several messages at the fast rate
+    QTest::qWait(300);
+    TrafficClass slow;
+    slow.bytesPerSecond = 1;
+    scheduler.setClientTrafficClass("client", slow);
+
+    // Only a burst of the slow rate is left, which is a full message
+    const auto sent = drain(scheduler, 8);
+    QCOMPARE(sent[1], qint64{qdbMessageSize});
+}
+
+void tst_TrafficScheduler::removeStream()
+{
+    TrafficScheduler scheduler;
+    scheduler.setTrafficClass(1, "client", TrafficClass{});
+    scheduler.setTrafficClass(2, "client", TrafficClass{});
+    scheduler.enqueue(writeMessage(1, 10));
+    scheduler.enqueue(writeMessage(2, 10));
+
+    scheduler.removeStream(1);
+    const auto sent = drain(scheduler, 10);
+    QCOMPARE(sent.value(1), qint64{0});
+    QCOMPARE(sent.value(2), qint64{10});
+    QVERIFY(scheduler.isEmpty());
+
+    scheduler.removeStream(2);
+    QVERIFY(scheduler.statistics().empty());
+}
+
+void tst_TrafficScheduler::moveStreamToOtherClient()
+{
+    TrafficScheduler scheduler;
+    scheduler.enqueue(writeMessage(1, 10));
+    scheduler.setTrafficClass(1, "client", TrafficClass{});
+
+    const auto statistics = scheduler.statistics();
+    QCOMPARE(statistics.size(), size_t{1});
+    QCOMPARE(statistics[0].client, QString{"client"});
+    QCOMPARE(statistics[0].bytesQueued, qint64{10});
+
+    // Queued messages follow the stream to its client
+    const auto sent = drain(scheduler, 10);
+    QCOMPARE(sent.value(1), qint64{10});
+    QVERIFY(scheduler.isEmpty());
+}
+
+QTEST_GUILESS_MAIN(tst_TrafficScheduler)
+
+#include "tst_trafficscheduler.moc"
@@ -0,0 +1,75 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Debug Bridge.
+**
+** $QT_BEGIN_LICENSE:GPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 or (at your option) any later version
+** approved by the KDE Free Qt Foundation. The licenses are as published by
+** the Free Software Foundation and appearing in the file LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+#include "libqdb/workerthreadpool.h"
+
+#include <QtCore/qpointer.h>
+#include <QtCore/qthread.h>
+#include <QtTest/QtTest>
+
+#include <memory>
+
+class tst_WorkerThreadPool : public QObject
+{
+    Q_OBJECT
+private slots:
+    void sharesThreadsOverLimit();
+    void deletesObjectsOnDestruction();
+};
+
+void tst_WorkerThreadPool::sharesThreadsOverLimit()
+{
+    WorkerThreadPool pool{"Worker", 2};
+    QThread *first = pool.acquire();
+    QThread *second = pool.acquire();
+    QVERIFY(first != second);
+    QCOMPARE(pool.threadCount(), 2);
+
+    pool.release(first);
+    QCOMPARE(pool.acquire(), first);
+    QCOMPARE(pool.threadCount(), 2);
+}
+
+void tst_WorkerThreadPool::deletesObjectsOnDestruction()
+{
+    auto pool = std::unique_ptr<WorkerThreadPool>(new WorkerThreadPool{"Worker", 1});
+    QPointer<QObject> object = new QObject;
+    object->moveToThread(pool->acquire());
+
+    // Closed just before shutdown, like the streams of qdbd
+    QObject *raw = object.data();
+    QMetaObject::invokeMethod(raw, [raw]() {
+        raw->deleteLater();
+    }, Qt::QueuedConnection);
+    pool.reset();
+
+    QVERIFY(object.isNull());
+}
+
+QTEST_GUILESS_MAIN(tst_WorkerThreadPool)
+#include "tst_workerthreadpool.moc"